@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "stats.h"
+
+/* Definitions of global data structure */
+
+__thread struct Arena type_arena = { NULL, 0 }; //each thread compiles with arenas of its own
+__thread struct Arena ir_arena = { NULL, 0 };
+
+/* Operations on arenas */
+
+//allocate arg:size bytes from arg:arena, the memory is not initialized
+//return the pointer of allocated memory
+void* arena_alloc(struct Arena* arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    struct ArenaBlock* block = arena->head;
+    if (block == NULL || block->size - block->used < size) {
+        size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(struct ArenaBlock) + block_size);
+        if (block == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        block->size = block_size;
+        block->used = 0;
+
+        if (arena->head != NULL && size > ARENA_BLOCK_SIZE) {
+            //keep the current block for later small allocations
+            block->next = arena->head->next;
+            arena->head->next = block;
+        }
+        else {
+            block->next = arena->head;
+            arena->head = block;
+        }
+    }
+
+    void* res = block->data + block->used;
+    block->used += size;
+    arena->total += size;
+    STAT_ADD(COUNT_BYTES, size);
+    return res;
+}
+
+//make a copy of arg:src in arg:arena
+char* arena_strdup(struct Arena* arena, const char* src) {
+    size_t len = strlen(src) + 1;
+    char* dst = arena_alloc(arena, len);
+    memcpy(dst, src, len);
+    return dst;
+}
+
+//forget all memory allocated from arg:arena, its newest block is kept for the allocations of the next compile
+void arena_reset(struct Arena* arena) {
+    if (arena->head == NULL)
+        return;
+
+    struct ArenaBlock* block = arena->head->next;
+    while (block != NULL) {
+        struct ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena->head->next = NULL;
+    arena->head->used = 0;
+    arena->total = 0;
+}
+
+//release all memory allocated from arg:arena
+void arena_release(struct Arena* arena) {
+    struct ArenaBlock* block = arena->head;
+    while (block != NULL) {
+        struct ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena->head = NULL;
+    arena->total = 0;
+}
@@ -0,0 +1,30 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN 8
+
+struct ArenaBlock { // Definition of memory blocks owned by an arena
+    struct ArenaBlock* next;
+    size_t size;                        //usable bytes in data
+    size_t used;                        //allocated bytes in data
+    char data[];
+};
+
+struct Arena { // Definition of region allocators, all memory is released at once
+    struct ArenaBlock* head;            //the newest block
+    size_t total;                       //bytes allocated from the arena
+};
+
+/* arenas of compilation phases */
+extern __thread struct Arena type_arena; //symbols, types and fields of semantic parse
+extern __thread struct Arena ir_arena; //intermediate code
+
+void* arena_alloc(struct Arena* arena, size_t size);
+char* arena_strdup(struct Arena* arena, const char* src);
+void arena_reset(struct Arena* arena);
+void arena_release(struct Arena* arena);
+
+#endif
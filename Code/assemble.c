@@ -1,58 +1,120 @@
 #include "ircode.h"
 #include "sparse.h"
 #include "assemble.h"
+#include "arena.h"
+#include "pool.h"
 
 /* Definitions of global variants*/
 
-static FILE* ass_fp = NULL; //file pointer of assemble output
-static bool* codeblock_array = NULL; //block-split flags array of ir code list
+static __thread struct OutBuf ass_out; //buffered assemble output of the thread
 
 static const union MIPSRegs reg_set = //description of MIPS32 register set
 { "$0", "$1", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3", "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7", "$t8",
   "$t9", "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra" };
 
-static struct VarDesc var_list = { "HEAD", NULL, NULL, 0, NULL }; //the linked list of variant description
-static struct VarDesc* reg_desc[REG_NUM]; //the array of occupation info of regs
+static const char* relop_instr[] = { "beq", "bne", "bgt", "blt", "bge", "ble" }; //branch instructions, indexed by RELOP_TYPE
 
 /* Assemble Functions */
 
 void assemble(char* filename) {
-    //setup
-    ass_fp = fopen(filename, "w");
+    assemble_begin(filename);
+    assemble_code();
+    assemble_end();
+}
+
+//open arg:filename and write the data and built-in functions which precede the code
+void assemble_begin(char* filename) {
+    if (!out_open(&ass_out, filename)) {
+        perror(filename);
+        exit(1);
+    }
     assemble_init();
+}
+
+//pool job assembling the function of context arg:index in arg:contexts
+static void assemble_job(int index, void* contexts) {
+    struct AsmContext* ctx = (struct AsmContext*)contexts + index;
+    code_base = ctx->base;
+    assemble_func(ctx);
+}
+
+//assemble the current ir code list, which may be one function of the program
+//functions are assembled in parallel into their own buffers, which are written in source order
+void assemble_code() {
+    if (code_num() == 0) { panic("Cannot split blocks in empty ir code list!"); }
+
+    int func_num = 0;
+    struct CodeRange* funcs = split_code(&func_num);
+    struct AsmContext* contexts = calloc(func_num, sizeof(struct AsmContext));
+    if (contexts == NULL)
+        panic("Out of memory");
+    for (int i = 0; i < func_num; ++i) {
+        contexts[i].code = funcs[i];
+        contexts[i].base = code_base;
+    }
+
+    pool_run(pool_jobs, func_num, assemble_job, contexts);
+
+    for (int i = 0; i < func_num; ++i)
+        assemble_append(&contexts[i]);
+    free(contexts);
+    free(funcs);
+}
+
+//write the text assembled in arg:ctx to the assemble output and close its buffer
+void assemble_append(struct AsmContext* ctx) {
+    out_mem(&ass_out, ctx->out.data, ctx->out.len);
+    out_close(&ctx->out);
+}
+
+//append arg:len bytes of text at arg:text, assembled before, to the assemble output
+void assemble_text(const char* text, size_t len) {
+    out_mem(&ass_out, text, len);
+}
+
+//assemble the codes of arg:ctx into its buffer, nothing outside the context is written
+void assemble_func(struct AsmContext* ctx) {
+    struct StatMark func_mark, split_mark;
+    stats_begin(&func_mark, true);
+    out_open_mem(&ctx->out);
+    clear_regs(ctx);
+    //split basic blocks
+    stats_begin(&split_mark, true);
+    split_blocks(ctx);
+    stats_end(&split_mark, PHASE_SPLIT);
 
     int block_begin = 0;
     int block_end = 0;
     int block_len = 0;
-    int code_end = code_num();
-    struct CodeListItem* block_ptr = begin_code();
+    int code_end = ctx->code.length;
+    struct CodeListItem* block_ptr = ctx->code.begin;
     while (block_end != code_end) {
         block_end = block_begin + 1;
         block_len = block_end - block_begin;
-        while (block_end < code_end && codeblock_array[block_end] != true) block_end++;
+        while (block_end < code_end && ctx->codeblock_array[block_end] != true) block_end++;
 
         //preprocess for the basic block
         struct CodeListItem* ptr = block_ptr;
         for (int i = block_begin; i < block_end; ++i) {
             //resolve data structure
             if (ptr->opt != OT_LABEL && ptr->opt != OT_GOTO) {
-                if (strlen(ptr->right) != 0) {
-                    struct VarDesc* var = search_var(ptr->right);
+                if (ptr->right.kind != OPD_NONE) {
+                    struct VarDesc* var = search_var(ctx, &ptr->right);
                     if (var == NULL) {
                         //create VarDesc for var
-                        var = create_var(ptr->right, block_len, );
+                        var = create_var(ctx, &ptr->right, block_len, 0);
                     }
-                    assert(var->used);
+                    DIAG_ASSERT(var->used);
                     var->used[i] = true;
                 }
 
-                if (strlen(ptr->left) != 0) {
-                    struct VarDesc* var = search_var(ptr->left);
+                if (ptr->left.kind != OPD_NONE) {
+                    struct VarDesc* var = search_var(ctx, &ptr->left);
                     if (var == NULL) {
                         //create VarDesc for var
-                        var = create_var(ptr->left, block_len, );
+                        var = create_var(ctx, &ptr->left, block_len, 0);
                     }
-                    assert(var->used);
+                    DIAG_ASSERT(var->used);
                     var->used[i] = true;
                 }
             }
@@ -64,8 +126,8 @@ void assemble(char* filename) {
         ptr = block_ptr;
         for (int i = block_begin; i < block_end; ++i) {
             //transform code
-            assert(ptr);
-            instr_transform(ptr, i, ass_fp);
+            DIAG_ASSERT(ptr);
+            instr_transform(ctx, ptr, i);
 
             ptr = next_code(ptr);
         }
@@ -76,20 +138,45 @@ void assemble(char* filename) {
         /* TODO: clear regs and var_list */
     }
 
-    //clean
-    fflush(ass_fp);
-    fclose(ass_fp);
-    ass_fp = NULL;
+    //clean, the descriptions refer to variants of this function only
+    ctx->codeblock_array = NULL;
+    ctx->var_list.next = NULL;
+    arena_release(&ctx->arena);
+    stats_func(&func_mark, ctx->code.begin->opt == OT_FUNC ? ctx->code.begin->left.name : "(global)");
+}
+
+//flush and close the assemble output
+void assemble_end() {
+    out_close(&ass_out);
+}
+
+//assemble the current ir code list into memory, arg:out takes over the text, which is released by out_close
+void assemble_mem(struct OutBuf* out) {
+    out_open_mem(&ass_out);
+    assemble_init();
+    if (code_num() > 0)
+        assemble_code();
+    *out = ass_out;
+    out_open_mem(&ass_out);
+}
+
+//assemble the current ir code list into arg:out without the data and built-in functions, which the link step writes once
+void assemble_unit(struct OutBuf* out) {
+    out_open_mem(&ass_out);
+    if (code_num() > 0)
+        assemble_code();
+    *out = ass_out;
+    out_open_mem(&ass_out);
 }
 
 //initialization before assembling begins
 void assemble_init() {
     //initialize global data in assemble output
-    fprintf(ass_fp, ".data\n");
-    fprintf(ass_fp, "_prompt: .asciiz \"Enter an integer:\"");
-    fprintf(ass_fp, "_ret: .asciiz \"\\n\"");
+    out_str(&ass_out, ".data\n");
+    out_str(&ass_out, "_prompt: .asciiz \"Enter an integer:\"");
+    out_str(&ass_out, "_ret: .asciiz \"\\n\"");
     //add read() and write() functions
-    fprintf(ass_fp, "\nread:\n \
+    out_str(&ass_out, "\nread:\n \
                   li $v0, 4\n \
                   la $a0, _prompt\n \
                   syscall\n \
@@ -97,7 +184,7 @@ void assemble_init() {
                   syscall\n \
                   jr $ra\n");
 
-    fprintf(ass_fp, "\nwrite:\n \
+    out_str(&ass_out, "\nwrite:\n \
                 li $v0, 1\n \
                 syscall\n \
                 li $v0, 4\n \
@@ -105,136 +192,129 @@ void assemble_init() {
                 syscall\n \
                 move $v0, $0\n \
                 jr $ra\n");
-
-    //split basic blocks
-    split_blocks();
-
-    //clear flags of registers
-    clear_regs();
 }
 
-//split the ir code list to basic blocks
-void split_blocks() {
-    int len = code_num();
+//split the codes of arg:ctx to basic blocks
+void split_blocks(struct AsmContext* ctx) {
+    int len = ctx->code.length;
     if (len == 0) { panic("Cannot split blocks in empty ir code list!"); }
 
-    if (codeblock_array != NULL) free(codeblock_array);
-    codeblock_array = malloc(len);
-    memset(codeblock_array, 0, len);
+    ctx->codeblock_array = arena_alloc(&ctx->arena, len);
+    memset(ctx->codeblock_array, 0, len);
 
-    struct CodeListItem* ptr = begin_code();
-    int counter = 0;
-    codeblock_array[0] = true;
-    while (ptr != NULL) {
+    struct CodeListItem* ptr = ctx->code.begin;
+    ctx->codeblock_array[0] = true;
+    for (int counter = 0; counter < len; ++counter) {
         if (ptr->opt == OT_LABEL) {
-            codeblock_array[counter] = true;
+            ctx->codeblock_array[counter] = true;
         }
         else if ((ptr->opt == OT_RELOP || ptr->opt == OT_GOTO) && counter + 1 < len) {
-            codeblock_array[counter + 1] = true;
+            ctx->codeblock_array[counter + 1] = true;
         }
         else if (ptr->opt == OT_CALL) {
-            codeblock_array[counter] = true;
-            if (counter + 1 < len) codeblock_array[counter + 1] = true;
+            ctx->codeblock_array[counter] = true;
+            if (counter + 1 < len) ctx->codeblock_array[counter + 1] = true;
         }
 
         ptr = next_code(ptr);
-        counter++;
     }
 }
 
 //transform an intermediate instruction to an assemble instruction
-void instr_transform(struct CodeListItem* ptr, int pos, FILE* output) {
+void instr_transform(struct AsmContext* ctx, struct CodeListItem* ptr, int pos) {
+    struct OutBuf* output = &ctx->out;
     switch (ptr->opt)
     {
         case OT_LABEL: {
-            fprintf(output, "  %s: \n", ptr->left);
+            out_code(output, "  %l: \n", ptr);
             break;
         }
         case OT_FUNC: {
-            fprintf(output, "\n%s: \n", ptr->left);
+            out_code(output, "\n%l: \n", ptr);
             break;
         }
         case OT_ASSIGN: {
-            int reg_x = get_reg(ptr->left, pos, ALLOCATE_REG, output);
-            if (is_imm(ptr->right)) {
-                fprintf(output, "  li %s, %s \n", reg_set.reg[reg_x], ptr->right);
+            int reg_x = get_reg(ctx, &ptr->left, pos, ALLOCATE_REG);
+            if (is_imm(&ptr->right)) {
+                out_str(output, "  li ");
+                out_str(output, reg_set.reg[reg_x]);
+                out_str(output, ", ");
+                out_int(output, ptr->right.value);
+                out_str(output, " \n");
             }
             else {
-                int reg_y = get_reg(ptr->right, pos, ENSURE_REG, output);
-                fprintf(output, "  move %s, %s \n", reg_set.reg[reg_x], reg_set.reg[reg_y]);
+                int reg_y = get_reg(ctx, &ptr->right, pos, ENSURE_REG);
+                out_str(output, "  move ");
+                out_str(output, reg_set.reg[reg_x]);
+                out_str(output, ", ");
+                out_str(output, reg_set.reg[reg_y]);
+                out_str(output, " \n");
             }
             break;
         }
         /* TODO: to be finished*/
         case OT_ADD: {
-            fprintf(output, "  %s := %s + %s \n", ptr->dst, ptr->left, ptr->right);
+            out_code(output, "  %d := %l + %r \n", ptr);
             break;
         }
         case OT_SUB: {
-            fprintf(output, "  %s := %s - %s \n", ptr->dst, ptr->left, ptr->right);
+            out_code(output, "  %d := %l - %r \n", ptr);
             break;
         }
         case OT_MUL: {
-            fprintf(output, "  %s := %s * %s \n", ptr->dst, ptr->left, ptr->right);
+            out_code(output, "  %d := %l * %r \n", ptr);
             break;
         }
         case OT_DIV: {
-            fprintf(output, "  %s := %s / %s \n", ptr->dst, ptr->left, ptr->right);
+            out_code(output, "  %d := %l / %r \n", ptr);
             break;
         }
         case OT_GOTO: {
-            fprintf(output, "  j %s \n", ptr->left);
+            out_code(output, "  j %l \n", ptr);
             break;
         }
         case OT_RELOP: {
-            int reg_x = get_reg(ptr->left, pos, ALLOCATE_REG, output);
-            int reg_y = get_reg(ptr->right, pos, ALLOCATE_REG, output);
-            if (strcmp(ptr->extra, "==") == 0)
-                fprintf(output, "  beq %s, %s, %s \n", reg_set.reg[reg_x], reg_set.reg[reg_y], ptr->dst);
-            else if (strcmp(ptr->extra, "!=") == 0)
-                fprintf(output, "  bne %s, %s, %s \n", reg_set.reg[reg_x], reg_set.reg[reg_y], ptr->dst);
-            else if (strcmp(ptr->extra, ">") == 0)
-                fprintf(output, "  bgt %s, %s, %s \n", reg_set.reg[reg_x], reg_set.reg[reg_y], ptr->dst);
-            else if (strcmp(ptr->extra, "<") == 0)
-                fprintf(output, "  blt %s, %s, %s \n", reg_set.reg[reg_x], reg_set.reg[reg_y], ptr->dst);
-            else if (strcmp(ptr->extra, ">=") == 0)
-                fprintf(output, "  bge %s, %s, %s \n", reg_set.reg[reg_x], reg_set.reg[reg_y], ptr->dst);
-            else if (strcmp(ptr->extra, "<=") == 0)
-                fprintf(output, "  ble %s, %s, %s \n", reg_set.reg[reg_x], reg_set.reg[reg_y], ptr->dst);
-            else
-                assert(0);
+            int reg_x = get_reg(ctx, &ptr->left, pos, ALLOCATE_REG);
+            int reg_y = get_reg(ctx, &ptr->right, pos, ALLOCATE_REG);
+            out_str(output, "  ");
+            out_str(output, relop_instr[ptr->relop]);
+            out_char(output, ' ');
+            out_str(output, reg_set.reg[reg_x]);
+            out_str(output, ", ");
+            out_str(output, reg_set.reg[reg_y]);
+            out_code(output, ", %d \n", ptr);
             break;
         }
         case OT_RET: {
-            fprintf(output, "  RETURN %s \n", ptr->left);
+            out_code(output, "  RETURN %l \n", ptr);
             break;
         }
         case OT_DEC: {
-            fprintf(output, "  DEC %s %s \n", ptr->left, ptr->right);
+            out_code(output, "  DEC %l %r \n", ptr);
             break;
         }
         case OT_ARG: {
-            fprintf(output, "  ARG %s \n", ptr->left);
+            out_code(output, "  ARG %l \n", ptr);
             break;
         }
         case OT_CALL: {
-            fprintf(output, "%s := CALL %s \n", ptr->left, ptr->right);
+            out_code(output, "%l := CALL %r \n", ptr);
             break;
         }
         // case OT_PARAM: {
-        //     fprintf(output, "PARAM %s \n", ptr->left);
+        //     out_code(output, "PARAM %l \n", ptr);
         //     break;
         // }
         case OT_READ: {
-            fprintf(output, "READ %s \n", ptr->left);
+            out_code(output, "READ %l \n", ptr);
             break;
         }
         case OT_WRITE: {
-            fprintf(output, "WRITE %s \n", ptr->left);
+            out_code(output, "WRITE %l \n", ptr);
             break;
         }
         default:
-            assert(0);
+            DIAG_ASSERT(0);
             break;
     }
 }
@@ -243,48 +323,65 @@ void instr_transform(struct CodeListItem* ptr, int pos, FILE* output) {
 
 //allocate an register for arg:var, arg:flag denotes the used method
 //return the string of allocated register
-int get_reg(char* var, int pos, bool flag, FILE* output) {
+int get_reg(struct AsmContext* ctx, const struct Operand* var, int pos, bool flag) {
+    struct OutBuf* output = &ctx->out;
     int res = -1;
     if (flag == ENSURE_REG) {
         //corresponding to ensure(var)
-        if (var[0] == '*') {// require dereference
+        if (var->modifier == OM_DEREF) {// require dereference
             /* TODO: to be confirmed */
-            var++;
-            if ((res = search_in_reg(var)) == -1) {
-                res = get_reg(var, pos, ALLOCATE_REG, output);
-                fprintf(output, "lw %s, %s \n", reg_set.reg[res], var);
-                reg_desc[res] = search_var(var);
+            struct Operand base = *var;
+            base.modifier = OM_NONE;
+            if ((res = search_in_reg(ctx, &base)) == -1) {
+                res = get_reg(ctx, &base, pos, ALLOCATE_REG);
+                STAT_COUNT(COUNT_LOAD);
+                out_str(output, "lw ");
+                out_str(output, reg_set.reg[res]);
+                out_str(output, ", ");
+                out_operand(output, &base);
+                out_str(output, " \n");
+                ctx->reg_desc[res] = search_var(ctx, &base);
             }
 
             //allocate a temporary reg
             int temp = -1;
-            if ((temp = search_empty_reg()) == -1) {
-                temp = search_best_reg(pos);
-                spill_reg(temp, output);
+            if ((temp = search_empty_reg(ctx)) == -1) {
+                temp = search_best_reg(ctx, pos);
+                spill_reg(ctx, temp);
             }
-            fprintf(output, "lw %s, 0(%s) \n", reg_set.reg[temp], reg_set.reg[res]);
+            STAT_COUNT(COUNT_LOAD);
+            out_str(output, "lw ");
+            out_str(output, reg_set.reg[temp]);
+            out_str(output, ", 0(");
+            out_str(output, reg_set.reg[res]);
+            out_str(output, ") \n");
             res = temp;
         }
-        else if (var[0] == '&') {// require reference
+        else if (var->modifier == OM_ADDR) {// require reference
             /* TODO: to be finished */
         }
         else {// normal
-            if ((res = search_in_reg(var)) == -1) {
-                res = get_reg(var, pos, ALLOCATE_REG, output);
-                fprintf(output, "lw %s, %s \n", reg_set.reg[res], var);
-                reg_desc[res] = search_var(var);
+            if ((res = search_in_reg(ctx, var)) == -1) {
+                res = get_reg(ctx, var, pos, ALLOCATE_REG);
+                STAT_COUNT(COUNT_LOAD);
+                out_str(output, "lw ");
+                out_str(output, reg_set.reg[res]);
+                out_str(output, ", ");
+                out_operand(output, var);
+                out_str(output, " \n");
+                ctx->reg_desc[res] = search_var(ctx, var);
             }
         }
     }
     else {
         //corresponding to allocate(var)
-        if (var[0] == '*') {// require dereference
+        if (var->modifier == OM_DEREF) {// require dereference
             /* TODO: to be finished */
         }
         else {// normal
-            if ((res = search_empty_reg()) == -1) {
-                res = search_best_reg(pos);
-                spill_reg(res, output);
+            if ((res = search_empty_reg(ctx)) == -1) {
+                res = search_best_reg(ctx, pos);
+                spill_reg(ctx, res);
             }
         }
     }
@@ -293,9 +390,9 @@ int get_reg(char* var, int pos, bool flag, FILE* output) {
 
 //search an empty register
 //return the index of empty register if found, otherwise -1
-int search_empty_reg() {
+int search_empty_reg(struct AsmContext* ctx) {
     for (int i = AVA_REG; i < AVA_REG + AVA_REG_NUM; ++i) {
-        if (reg_desc[i] == NULL) {
+        if (ctx->reg_desc[i] == NULL) {
             return i;
         }
     }
@@ -305,9 +402,9 @@ int search_empty_reg() {
 
 //search the register arg:id existing in
 //return the index of target register if found, otherwise -1
-int search_in_reg(char* id) {
+int search_in_reg(struct AsmContext* ctx, const struct Operand* id) {
     for (int i = AVA_REG; i < AVA_REG + AVA_REG_NUM; ++i) {
-        if (reg_desc[i] != NULL && strcmp(reg_desc[i]->id, id) == 0) {
+        if (ctx->reg_desc[i] != NULL && same_var(&ctx->reg_desc[i]->id, id)) {
             return i;
         }
     }
@@ -317,17 +414,17 @@ int search_in_reg(char* id) {
 
 //search the best register in the context of arg:pos
 //return the index of best register
-int search_best_reg(int pos) {
+int search_best_reg(struct AsmContext* ctx, int pos) {
     int max = -1;
     int maxReg = -1;
     for (int i = AVA_REG; i < AVA_REG + AVA_REG_NUM; ++i) {
-        if (reg_desc[i] == NULL) {
+        if (ctx->reg_desc[i] == NULL) {
             return i;
         }
-        else if (reg_desc[i] != NULL) {
+        else if (ctx->reg_desc[i] != NULL) {
             int offset = 0x7fffffff;
-            for (int j = reg_desc[i]->block_len - 1; j >= 0; --j) {
-                if (reg_desc[i]->used[j] && pos <= j) {
+            for (int j = ctx->reg_desc[i]->block_len - 1; j >= 0; --j) {
+                if (ctx->reg_desc[i]->used[j] && pos <= j) {
                     offset = j - pos;
                     break;
                 }
@@ -343,27 +440,29 @@ int search_best_reg(int pos) {
         }
     }
 
-    assert(maxReg != -1);
+    DIAG_ASSERT(maxReg != -1);
     return maxReg;
 }
 
 //reset the flags array of registers
-void clear_regs() {
+void clear_regs(struct AsmContext* ctx) {
     /* TODO: spill regs */
-    memset(reg_desc, 0, REG_NUM * sizeof(struct VarDesc*));
+    memset(ctx->reg_desc, 0, REG_NUM * sizeof(struct VarDesc*));
 }
 
 //spill the value in register into memory
-void spill_reg(int index, FILE* output) {
-    //
+void spill_reg(struct AsmContext* ctx, int index) {
+    (void)ctx;
+    (void)index;
+    STAT_COUNT(COUNT_SPILL);
 }
 
 /* Operations on VarDesc list*/
 
-struct VarDesc* search_var(char* id) {
-    struct VarDesc* ptr = var_list.next;
+struct VarDesc* search_var(struct AsmContext* ctx, const struct Operand* id) {
+    struct VarDesc* ptr = ctx->var_list.next;
     while (ptr != NULL) {
-        if (strcmp(ptr->id, id) == 0) {
+        if (same_var(&ptr->id, id)) {
             return ptr;
         }
 
@@ -373,16 +472,17 @@ struct VarDesc* search_var(char* id) {
     return ptr;
 }
 
-struct VarDesc* create_var(char* id, int block_len, int mem_offset) {
-    struct VarDesc* ptr = &var_list;
+struct VarDesc* create_var(struct AsmContext* ctx, const struct Operand* id, int block_len, int mem_offset) {
+    struct VarDesc* ptr = &ctx->var_list;
     while (ptr->next != NULL) {
         ptr = ptr->next;
     }
 
-    struct VarDesc* new_var = malloc(sizeof(struct VarDesc));
-    copy_str(&new_var->id, id);
+    struct VarDesc* new_var = arena_alloc(&ctx->arena, sizeof(struct VarDesc));
+    new_var->id = *id;
+    new_var->id.modifier = OM_NONE;
     new_var->reg = NULL;
-    new_var->used = malloc(block_len);
+    new_var->used = arena_alloc(&ctx->arena, block_len);
     memset(new_var->used, 0, block_len);
     new_var->block_len = block_len;
     new_var->mem_offset = mem_offset;
@@ -396,9 +496,15 @@ struct VarDesc* create_var(char* id, int block_len, int mem_offset) {
 
 //judge whether the operand is immediate number
 //return true if operand is immediate number, otherwise return false
-bool is_imm(char* operand) {
-    if (operand[0] == '#')
+bool is_imm(const struct Operand* operand) {
+    if (operand->kind == OPD_IMM)
         return true;
     else
         return false;
+}
+
+//judge whether two operands denote the same variant, ignoring their modifiers
+//return true if they are the same, otherwise return false
+bool same_var(const struct Operand* a, const struct Operand* b) {
+    return a->kind == b->kind && a->id == b->id;
 }
\ No newline at end of file
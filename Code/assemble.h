@@ -5,6 +5,8 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <memory.h>
+#include "ircode.h"
+#include "arena.h"
 
 #define ENSURE_REG true
 #define ALLOCATE_REG false
@@ -39,7 +41,7 @@ union MIPSRegs { /* !!! the order of regs has been tuned */
 };
 
 struct VarDesc {
-    char* id;
+    struct Operand id;
     char* reg;
     bool* used;
     int block_len;
@@ -47,21 +49,40 @@ struct VarDesc {
     struct VarDesc* next;
 };
 
+struct AsmContext { // Definition of the state of assembling one function, the contexts of functions are independent
+    struct CodeRange code;              //codes of the function
+    struct OutBuf out;                  //assemble text of the function, kept in memory
+    bool* codeblock_array;              //block-split flags of the codes
+    struct VarDesc var_list;            //head of the linked list of variant descriptions
+    struct VarDesc* reg_desc[REG_NUM];  //occupation info of regs
+    struct Arena arena;                 //descriptions of the function
+    const struct CodeBase* base;        //code_base which the function is written under, passed to the thread assembling it
+};
+
 void assemble(char* filename);
+void assemble_begin(char* filename);
+void assemble_code();
+void assemble_end();
+void assemble_mem(struct OutBuf* out);
+void assemble_unit(struct OutBuf* out);
 void assemble_init();
-void split_blocks();
-void instr_transform(struct CodeListItem* ptr, int pos, FILE* output);
+void assemble_func(struct AsmContext* ctx);
+void assemble_append(struct AsmContext* ctx);
+void assemble_text(const char* text, size_t len);
+void split_blocks(struct AsmContext* ctx);
+void instr_transform(struct AsmContext* ctx, struct CodeListItem* ptr, int pos);
 
-int get_reg(char* var, int pos, bool flag, FILE* output);
-int search_empty_reg();
-int search_in_reg(char* id);
-int search_best_reg(int pos);
-void clear_regs();
-void spill_reg(int index, FILE* output);
+int get_reg(struct AsmContext* ctx, const struct Operand* var, int pos, bool flag);
+int search_empty_reg(struct AsmContext* ctx);
+int search_in_reg(struct AsmContext* ctx, const struct Operand* id);
+int search_best_reg(struct AsmContext* ctx, int pos);
+void clear_regs(struct AsmContext* ctx);
+void spill_reg(struct AsmContext* ctx, int index);
 
-struct VarDesc* search_var(char* id);
-struct VarDesc* create_var(char* id, int block_len, int mem_offset);
+struct VarDesc* search_var(struct AsmContext* ctx, const struct Operand* id);
+struct VarDesc* create_var(struct AsmContext* ctx, const struct Operand* id, int block_len, int mem_offset);
 
-bool is_imm(char* operand);
+bool is_imm(const struct Operand* operand);
+bool same_var(const struct Operand* a, const struct Operand* b);
 
 #endif
\ No newline at end of file
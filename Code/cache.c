@@ -0,0 +1,332 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "cache.h"
+
+/* Definitions of the compile cache */
+
+#define CACHE_VERSION "cmm " __DATE__ " " __TIME__ //version of the compiler hashed into the keys, each build of the parser has a cache of its own
+#define CACHE_HEADER 16                 //bytes of the status and the three lengths leading an entry
+#define CACHE_STALE 3600                //seconds after which a temporary file is taken as left by a writer which died
+
+#define CACHE_STATS 5                   //lines of the statistics file
+#define CACHE_BYTES 4                   //line of the running total of the bytes of entries, which is no counter of lookups
+
+static const char* const stat_names[CACHE_STATS] = { "hits", "misses", "stores", "evictions", "bytes" };
+
+struct CacheFile {                      //entry found in a cache directory
+    char name[SHA256_SIZE * 2 + 1];
+    struct timespec used;               //time of the last store or hit
+    off_t size;
+};
+
+static void cache_path(const char* dir, const char* name, char path[CACHE_PATH_SIZE]) {
+    snprintf(path, CACHE_PATH_SIZE, "%s/%s", dir, name);
+}
+
+static bool write_all(int fd, const void* data, size_t len) {
+    const char* p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+//read the whole regular file at arg:fd into a heap buffer ended by NUL, its length is stored in arg:len
+static char* read_all(int fd, size_t* len) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        return NULL;
+    char* data = malloc(st.st_size + 1);
+    if (data == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    *len = 0;
+    while (*len < (size_t)st.st_size) {
+        ssize_t n = read(fd, data + *len, st.st_size - *len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        *len += n;
+    }
+    data[*len] = '\0';
+    return data;
+}
+
+//return true if arg:name is a key, other files of the directory are no entries
+static bool is_key(const char* name) {
+    size_t len = strspn(name, "0123456789abcdef");
+    return len == SHA256_SIZE * 2 && name[len] == '\0';
+}
+
+static int older_file(const void* a, const void* b) {
+    struct timespec x = ((const struct CacheFile*)a)->used, y = ((const struct CacheFile*)b)->used;
+    if (x.tv_sec != y.tv_sec)
+        return x.tv_sec < y.tv_sec ? -1 : 1;
+    return x.tv_nsec < y.tv_nsec ? -1 : x.tv_nsec > y.tv_nsec;
+}
+
+//list the entries of arg:dir into a heap array, their number and bytes are stored in arg:num and arg:total
+//temporary files left by writers which died are removed on the way
+static struct CacheFile* list_entries(const char* dir, int* num, long long* total) {
+    DIR* d = opendir(dir);
+    struct CacheFile* files = NULL;
+    int cap = 0;
+    *num = 0;
+    *total = 0;
+    if (d == NULL)
+        return NULL;
+
+    char path[CACHE_PATH_SIZE];
+    struct dirent* item;
+    struct stat st;
+    time_t now = time(NULL);
+    while ((item = readdir(d)) != NULL) {
+        bool temp = strncmp(item->d_name, ".tmp-", 5) == 0;
+        if (!temp && !is_key(item->d_name))
+            continue;
+        cache_path(dir, item->d_name, path);
+        if (stat(path, &st) != 0)
+            continue;                   // evicted by another process
+        if (temp) {
+            if (now - st.st_mtime > CACHE_STALE)
+                unlink(path);
+            continue;
+        }
+
+        if (*num == cap) {
+            cap = cap ? cap * 2 : 64;
+            if ((files = realloc(files, cap * sizeof(struct CacheFile))) == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                exit(1);
+            }
+        }
+        strcpy(files[*num].name, item->d_name);
+        files[*num].used = st.st_mtim;
+        files[*num].size = st.st_size;
+        *total += st.st_size;
+        ++*num;
+    }
+    closedir(d);
+    return files;
+}
+
+//remove the least recently used entries of arg:cache until it is within its limit, return the bytes of the entries left
+//the statistics file is locked by the caller, so one process at a time scans the directory
+static long long evict(struct Cache* cache) {
+    int num;
+    long long total;
+    struct CacheFile* files = list_entries(cache->dir, &num, &total);
+    if (total > cache->limit) {
+        char path[CACHE_PATH_SIZE];
+        qsort(files, num, sizeof(struct CacheFile), older_file);
+        for (int i = 0; i < num && total > cache->limit; ++i) {
+            cache_path(cache->dir, files[i].name, path);
+            total -= files[i].size;
+            if (unlink(path) == 0)      // another process may have evicted it already
+                ++cache->evictions;
+        }
+    }
+    free(files);
+    return total;
+}
+
+//read the statistics file at arg:fd into arg:counts, missing counters are 0
+//a missing total of bytes is -1, as in a directory written before it was kept
+static void read_stats(int fd, long long counts[CACHE_STATS]) {
+    char name[32];
+    long long value;
+    size_t len = 0;
+    char* text = read_all(fd, &len);
+    memset(counts, 0, CACHE_STATS * sizeof(long long));
+    counts[CACHE_BYTES] = -1;
+    for (char* p = text; p != NULL && *p != '\0'; p = strchr(p, '\n') != NULL ? strchr(p, '\n') + 1 : "") {
+        if (sscanf(p, "%31s %lld", name, &value) != 2)
+            continue;
+        for (int k = 0; k < CACHE_STATS; ++k)
+            if (strcmp(name, stat_names[k]) == 0)
+                counts[k] = value;
+    }
+    free(text);
+}
+
+//lock the statistics file at arg:fd for reading or writing until it is closed
+static bool lock_stats(int fd, short type) {
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    while (fcntl(fd, F_SETLKW, &lock) != 0)
+        if (errno != EINTR)
+            return false;
+    return true;
+}
+
+/* Interfaces */
+
+//open the cache directory arg:dir, creating it if it does not exist, which keeps arg:limit bytes of entries
+//return false if it is no directory, errno tells why
+bool cache_open(struct Cache* cache, const char* dir, long long limit) {
+    struct stat st;
+    memset(cache, 0, sizeof(struct Cache));
+    cache->dir = dir;
+    cache->limit = limit;
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST)
+        return false;
+    if (stat(dir, &st) != 0)
+        return false;
+    if (!S_ISDIR(st.st_mode)) {
+        errno = ENOTDIR;
+        return false;
+    }
+    return true;
+}
+
+//set the key of arg:cache to the compile of arg:size bytes of arg:source with the output switches arg:switches
+void cache_key(struct Cache* cache, const char* switches, const char* source, size_t size) {
+    struct Sha256 ctx;
+    uint8_t digest[SHA256_SIZE];
+    sha256_init(&ctx);
+    sha256_update(&ctx, CACHE_VERSION, sizeof(CACHE_VERSION));
+    sha256_update(&ctx, switches, strlen(switches) + 1);
+    sha256_update(&ctx, source, size);
+    sha256_final(&ctx, digest);
+    sha256_hex(digest, cache->key);
+}
+
+//load the entry of the key of arg:cache into arg:entry, which is released by cache_free
+//return false on a miss, a broken entry is a miss and is replaced by the next store
+bool cache_load(struct Cache* cache, struct CacheEntry* entry) {
+    char path[CACHE_PATH_SIZE];
+    size_t len = 0;
+    cache_path(cache->dir, cache->key, path);
+    int fd = open(path, O_RDONLY);
+    entry->data = fd >= 0 ? read_all(fd, &len) : NULL;
+    if (fd >= 0)
+        close(fd);
+
+    uint32_t header[4];
+    if (entry->data == NULL || len < CACHE_HEADER) {
+        cache_free(entry);
+        ++cache->misses;
+        return false;
+    }
+    memcpy(header, entry->data, CACHE_HEADER);
+    if ((size_t)header[1] + header[2] + header[3] != len - CACHE_HEADER) {
+        cache_free(entry);
+        ++cache->misses;
+        return false;
+    }
+
+    entry->status = header[0];
+    const char* p = entry->data + CACHE_HEADER;
+    for (int k = 0; k < 3; ++k) {
+        entry->text[k] = p;
+        entry->len[k] = header[k + 1];
+        p += header[k + 1];
+    }
+    utimensat(AT_FDCWD, path, NULL, 0); // the modification time orders the entries by use
+    ++cache->hits;
+    return true;
+}
+
+//store arg:entry under the key of arg:cache, the entries beyond the limit are evicted by cache_close
+//the entry is written to a temporary file which is renamed, so readers see it whole or not at all
+//a cache which cannot be written is left alone, the compile does not depend on it
+void cache_store(struct Cache* cache, const struct CacheEntry* entry) {
+    char temp[CACHE_PATH_SIZE], path[CACHE_PATH_SIZE], name[SHA256_SIZE * 2 + 16];
+    snprintf(name, sizeof(name), ".tmp-%s-XXXXXX", cache->key);
+    cache_path(cache->dir, name, temp);
+    cache_path(cache->dir, cache->key, path);
+    int fd = mkstemp(temp);
+    if (fd < 0)
+        return;
+    struct stat st;
+    long long size = CACHE_HEADER + (long long)entry->len[0] + entry->len[1] + entry->len[2];
+    long long replaced = stat(path, &st) == 0 ? st.st_size : 0;    // a broken entry taken as a miss
+
+    uint32_t header[4] = { entry->status, entry->len[0], entry->len[1], entry->len[2] };
+    bool ok = write_all(fd, header, CACHE_HEADER);
+    for (int k = 0; k < 3; ++k)
+        ok = ok && write_all(fd, entry->text[k], entry->len[k]);
+    ok = ok && fchmod(fd, 0644) == 0;
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(temp, path) != 0) {
+        unlink(temp);
+        return;
+    }
+    ++cache->stores;
+    cache->bytes += size - replaced;
+}
+
+void cache_free(struct CacheEntry* entry) {
+    free(entry->data);
+    entry->data = NULL;
+}
+
+//add the statistics of the process to the statistics file of arg:cache, which keeps the bytes of the entries as well
+//the directory is scanned only when that total exceeds the limit, then the least recently used entries are evicted
+void cache_close(struct Cache* cache) {
+    char path[CACHE_PATH_SIZE], text[256];
+    long long counts[CACHE_STATS];
+    cache_path(cache->dir, "stats", path);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return;
+    if (lock_stats(fd, F_WRLCK)) {
+        read_stats(fd, counts);
+        long long total = counts[CACHE_BYTES] + cache->bytes;
+        if (counts[CACHE_BYTES] < 0 || total > cache->limit)
+            total = evict(cache);       // the scan also corrects the total, which misses the stores of writers which died
+        long long added[CACHE_STATS] = { cache->hits, cache->misses, cache->stores, cache->evictions };
+        counts[CACHE_BYTES] = total;
+        int len = 0;
+        for (int k = 0; k < CACHE_STATS; ++k)
+            len += snprintf(text + len, sizeof(text) - len, "%s %lld\n", stat_names[k], counts[k] + added[k]);
+        if (ftruncate(fd, 0) == 0 && lseek(fd, 0, SEEK_SET) == 0)
+            write_all(fd, text, len);
+    }
+    close(fd);
+}
+
+//print the statistics and the size of the cache directory arg:dir to stdout, return false if it cannot be read
+bool cache_print_stats(const char* dir) {
+    char path[CACHE_PATH_SIZE];
+    long long counts[CACHE_STATS] = { 0 };
+    cache_path(dir, "stats", path);
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        if (lock_stats(fd, F_RDLCK))
+            read_stats(fd, counts);
+        close(fd);
+    }
+
+    int num;
+    long long total;
+    DIR* d = opendir(dir);
+    if (d == NULL)
+        return false;
+    closedir(d);
+    free(list_entries(dir, &num, &total));
+    for (int k = 0; k < CACHE_BYTES; ++k)
+        printf("%s %lld\n", stat_names[k], counts[k]);
+    long long lookups = counts[0] + counts[1];
+    printf("hit rate %.1f%%\n", lookups > 0 ? 100.0 * counts[0] / lookups : 0.0);
+    printf("entries %d\nbytes %lld\n", num, total);
+    return true;
+}
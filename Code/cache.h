@@ -0,0 +1,40 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256.h"
+
+/* content-addressed cache of compiles, each entry is a file of the cache directory named by its key */
+/* the key hashes the compiler version, the switches changing the output and the source */
+/* entries are written to temporary files and renamed, so processes may share a directory */
+/* the statistics file keeps the bytes of the entries, the directory is scanned for eviction only beyond the limit */
+
+#define CACHE_DEFAULT_SIZE 256          //default limit of a cache directory in MiB
+#define CACHE_PATH_SIZE 4096            //bytes of the paths of files in a cache directory
+
+struct CacheEntry { // Definition of the outputs of a compile kept by the cache
+    uint32_t status;                    //exit status of the compile
+    const char* text[3];                //texts for stdout, for stderr and for the output file
+    uint32_t len[3];
+    char* data;                         //buffer of a loaded entry holding the texts, NULL for an entry being stored
+};
+
+struct Cache { // Definition of opened cache directories
+    const char* dir;
+    long long limit;                    //bytes of entries kept, the least recently used are evicted beyond
+    char key[SHA256_SIZE * 2 + 1];      //hex key of the compile looked up
+    long hits, misses, stores, evictions; //statistics of the process, added to the directory by cache_close
+    long long bytes;                    //bytes of the entries stored by the process, less the ones they replaced
+};
+
+bool cache_open(struct Cache* cache, const char* dir, long long limit);
+void cache_key(struct Cache* cache, const char* switches, const char* source, size_t size);
+bool cache_load(struct Cache* cache, struct CacheEntry* entry);
+void cache_store(struct Cache* cache, const struct CacheEntry* entry);
+void cache_free(struct CacheEntry* entry);
+void cache_close(struct Cache* cache);
+bool cache_print_stats(const char* dir);
+
+#endif
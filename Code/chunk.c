@@ -0,0 +1,102 @@
+#include "sparse.h"
+#include "outbuf.h"
+#include "pool.h"
+#include "scanner.h"
+#include "chunk.h"
+
+extern __thread NodeRef syntax_tree;
+extern __thread int syntax_errors;
+extern __thread bool quiet_syntax;
+extern int yyparse();
+
+/* Definitions of parallel parsing */
+
+struct ChunkJob { // Definition of the parse of one chunk of the source
+    struct SourceChunk source;
+    struct Tree tree;                   //pools of the thread which parsed the chunk
+    struct OutBuf log;                  //messages of the scanner, written once every chunk is parsed
+    bool failed;                        //the chunk has syntax errors, which are reported by parsing the whole source again
+};
+
+//pool job parsing the chunk of job arg:index in arg:jobs, on pools of the calling thread
+static void parse_job(int index, void* jobs) {
+    struct ChunkJob* job = (struct ChunkJob*)jobs + index;
+    int errors = syntax_errors;
+
+    init_tree();
+    out_open_mem(&job->log);
+    scan_chunk(job->source.begin, job->source.size, job->source.lineno, &job->log);
+    quiet_syntax = true;
+    job->failed = yyparse() != 0 || syntax_errors != errors;
+    quiet_syntax = false;
+    scan_chunk(NULL, 0, 1, NULL);
+
+    take_tree(syntax_tree, &job->tree);
+    syntax_tree = NULL_NODE;
+}
+
+//join the ExtDefs parsed by arg:jobs into one Program in the pools, in source order
+static NodeRef stitch_chunks(struct ChunkJob* jobs, int number) {
+    NodeRef list = open_list(NK_ExtDefList, 0);
+    int lineno = 0;
+
+    for (int i = 0; i < number; ++i) {
+        NodeRef program = graft_tree(&jobs[i].tree);
+        NodeRef chunk_list = node_child(program, 0);
+        if (i == 0)
+            lineno = node_line(program);
+        for (int k = 0; k < node_childs(chunk_list); ++k)
+            list_append(list, node_child(chunk_list, k));
+    }
+    close_list(list);
+    return create_node(NK_Program, lineno, 1, list);
+}
+
+/* Interfaces */
+
+//parse the source of arg:size bytes at arg:text in chunks of ExtDefs on arg:threads threads, into syntax_tree
+//return false if it is not split or has syntax errors, then the scanner is reset to parse it as a whole
+bool parse_chunks(const char* text, size_t size, int threads) {
+    if (threads <= 0)
+        threads = pool_threads();
+    size_t target = size / ((size_t)threads * CHUNKS_PER_THREAD);
+    if (target < CHUNK_MIN_SIZE)
+        target = CHUNK_MIN_SIZE;
+
+    int number = 0;
+    struct SourceChunk* chunks = split_source(text, size, target, &number);
+    if (number <= 1) {
+        free(chunks);
+        scan_buffer(text, size);
+        return false;
+    }
+
+    struct ChunkJob* jobs = calloc(number, sizeof(struct ChunkJob));
+    if (jobs == NULL)
+        panic("Out of memory");
+    for (int i = 0; i < number; ++i)
+        jobs[i].source = chunks[i];
+    free(chunks);
+
+    pool_run(threads, number, parse_job, jobs);
+
+    bool failed = false;
+    for (int i = 0; i < number; ++i)
+        failed = failed || jobs[i].failed;
+
+    init_tree();
+    if (!failed) {
+        syntax_tree = stitch_chunks(jobs, number);
+        for (int i = 0; i < number; ++i)
+            fwrite(jobs[i].log.data, 1, jobs[i].log.len, stdout);
+    }
+    else
+        scan_buffer(text, size);
+
+    for (int i = 0; i < number; ++i) {
+        free_tree(&jobs[i].tree);
+        out_close(&jobs[i].log);
+    }
+    free(jobs);
+    return !failed;
+}
@@ -0,0 +1,12 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CHUNK_MIN_SIZE (64 * 1024)      //bytes of source below which a chunk is not worth a job
+#define CHUNKS_PER_THREAD 8             //chunks made for each thread, so the threads stay busy until the end
+
+bool parse_chunks(const char* text, size_t size, int threads);
+
+#endif
@@ -0,0 +1,153 @@
+#ifdef CMM_CLIENT
+/* client of the compile server with the command line of parser, built alone into cmmc by "make client" */
+/* it runs parser with the same arguments when no server listens on CMM_SERVER, or when the server drops the request */
+/* the library reports diagnostics and failures otherwise than parser, so only a clean compile is taken from the server */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "server.h"
+
+struct Buffer {                         //growing byte buffer of a request
+    char* data;
+    size_t len, cap;
+};
+
+static void append(struct Buffer* buf, const void* data, size_t len) {
+    if (buf->len + len > buf->cap) {
+        while (buf->len + len > buf->cap)
+            buf->cap = buf->cap ? buf->cap * 2 : 4096;
+        buf->data = realloc(buf->data, buf->cap);
+        if (buf->data == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+}
+
+//read the whole source from arg:name, stdin if it is NULL or "-", into arg:buf
+static bool read_file(const char* name, struct Buffer* buf) {
+    int fd = STDIN_FILENO;
+    if (name != NULL && strcmp(name, "-") != 0 && (fd = open(name, O_RDONLY)) < 0)
+        return false;
+    char block[65536];
+    ssize_t n;
+    while ((n = read(fd, block, sizeof(block))) != 0) {
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return false;
+        append(buf, block, n);
+    }
+    if (fd != STDIN_FILENO)
+        close(fd);
+    return true;
+}
+
+//connect to the server at CMM_SERVER, return -1 if none listens there
+static int connect_server() {
+    const char* path = getenv("CMM_SERVER");
+    struct sockaddr_un addr;
+    if (path == NULL)
+        path = SERVER_SOCKET;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+//run the parser at CMM_PARSER, or parser on the PATH, with the arguments of cmmc
+static int run_parser(char** argv) {
+    const char* parser = getenv("CMM_PARSER");
+    argv[0] = (char*)(parser != NULL ? parser : "parser");
+    execvp(argv[0], argv);
+    perror(argv[0]);
+    return 1;
+}
+
+//run parser as run_parser does, for a request which the server dropped or whose reply may differ from parser
+//a source read from stdin is handed to parser in a temporary file
+static int retry_parser(char** argv, const char* name, const struct Buffer* source) {
+    if (name == NULL || strcmp(name, "-") == 0) {
+        FILE* file = tmpfile();
+        if (file == NULL || fwrite(source->data, 1, source->len, file) != source->len || fflush(file) != 0
+            || lseek(fileno(file), 0, SEEK_SET) != 0 || dup2(fileno(file), STDIN_FILENO) < 0) {
+            perror("cmmc");
+            return 1;
+        }
+    }
+    return run_parser(argv);
+}
+
+//write arg:len bytes at arg:data to arg:name, stdout if it is NULL
+static bool write_file(const char* name, const char* data, size_t len) {
+    int fd = name == NULL ? STDOUT_FILENO : open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || !send_all(fd, data, len)) {
+        perror(name != NULL ? name : "stdout");
+        return false;
+    }
+    return fd == STDOUT_FILENO || close(fd) == 0;
+}
+
+int main(int argc, char** argv) {
+    struct Buffer switches = { NULL, 0, 0 }, source = { NULL, 0, 0 };
+    char* files[2] = { NULL, NULL };    // source, assembly or ir output
+    int file_num = 0;
+    bool emit_ir = false;
+
+    /* the switches served by a request are sent with their arguments, parser runs any other command line */
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            enum SwitchId k = find_switch(argv[i]);
+            if (k == SWITCH_NUM || !parser_switches[k].served || (parser_switches[k].argument && i + 1 == argc))
+                return run_parser(argv);
+            emit_ir = emit_ir || k == SWITCH_IR;
+            append(&switches, argv[i], strlen(argv[i]) + 1);
+            if (parser_switches[k].argument)
+                ++i, append(&switches, argv[i], strlen(argv[i]) + 1);
+        }
+        else if (file_num < 2)
+            files[file_num++] = argv[i];
+        else
+            return run_parser(argv);
+    }
+
+    int fd = connect_server();
+    if (fd < 0)
+        return run_parser(argv);
+    if (!read_file(files[0], &source)) {
+        perror(files[0]);
+        return 1;
+    }
+
+    uint32_t status, len[3];
+    char* reply[3] = { NULL, NULL, NULL };  // stdout, stderr and output
+    bool received = send_frame(fd, switches.data, switches.len) && send_frame(fd, source.data, source.len)
+        && recv_all(fd, &status, sizeof(status));
+    for (int k = 0; k < 3 && received; ++k)
+        received = (reply[k] = recv_frame(fd, &len[k])) != NULL;
+    close(fd);
+    /* nothing is written before the whole reply, so parser writes all of it */
+    /* a compile with messages or errors is compiled again by parser, which prints, writes and exits in its own way */
+    if (!received || status != 0 || len[0] != 0 || len[1] != 0)
+        return retry_parser(argv, files[0], &source);
+
+    if ((emit_ir || files[1] != NULL) && !write_file(files[1], reply[2], len[2]))
+        return 1;
+    return 0;
+}
+
+#endif
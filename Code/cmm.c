@@ -0,0 +1,129 @@
+#include "sparse.h"
+#include "assemble.h"
+#include "ircode.h"
+#include "arena.h"
+#include "scanner.h"
+#include "pool.h"
+#include "diag.h"
+
+extern __thread NodeRef syntax_tree;
+extern __thread int syntax_errors;
+extern int yyparse();
+
+/* Definitions of the library interface */
+
+//reset the tree, attributes, symbols and scanner of the passes, the storage is kept by the thread for its next compile
+static void release_passes() {
+    syntax_tree = NULL_NODE;
+    reset_attrs();
+    arena_reset(&type_arena);
+    scan_chunk(NULL, 0, 1, NULL);
+}
+
+//hand the text of arg:out over to arg:text, NUL-terminated, and its length to arg:len
+static void take_text(struct OutBuf* out, char** text, size_t* len) {
+    out_char(out, '\0');
+    *text = out->data;
+    *len = out->len - 1;
+    out->data = NULL;
+    out_close(out);
+}
+
+//run the passes on the source arg:text of arg:size bytes, its outputs are put into arg:result if it has no errors
+//return false if the source has errors, an internal failure jumps to diag_recover instead
+static bool compile_text(char* text, size_t size, const struct CmmOptions* options, struct CmmResult* result) {
+    init_tree();
+    scan_buffer(text, size);
+    bool ok = yyparse() == 0 && syntax_errors == 0 && diag_log->errors == 0;
+    if (ok) {
+        semantic_parse(syntax_tree);
+        ok = diag_log->errors == 0;
+    }
+    if (ok) {
+        translate_semantic(syntax_tree);
+        ok = diag_log->errors == 0;
+    }
+    release_passes();
+
+    if (ok) {
+        struct OutBuf out;
+        if (options->emit_ir) {
+            out_open_mem(&out);
+            export_code(&out);
+            take_text(&out, &result->ir, &result->ir_len);
+        }
+        if (!options->emit_ir || !options->skip_assembly) {
+            assemble_mem(&out);
+            take_text(&out, &result->assembly, &result->assembly_len);
+        }
+    }
+    return ok;
+}
+
+//compile arg:size bytes of C-- source at arg:source into the buffers of arg:result, on the calling thread and arg:options->threads
+//nothing is printed, the messages of the passes are kept in arg:result->diags
+//an internal failure of the compiler is kept as a CMM_INTERNAL diagnostic, the process goes on
+//return false if the source has errors, the compiler failed or memory ran out, then no assembly is produced
+//the ir code is kept if the failure is in the assembler
+bool cmm_compile(const char* source, size_t size, const struct CmmOptions* options, struct CmmResult* result) {
+    static const struct CmmOptions defaults = { false, 1, false };
+    if (options == NULL)
+        options = &defaults;
+    memset(result, 0, sizeof(struct CmmResult));
+
+    char* text = malloc(size + 2);      // the scanner may look at the two bytes behind the last token, which are NULs as in main.c
+    if (text == NULL)
+        return false;
+    memcpy(text, source, size);
+    text[size] = text[size + 1] = '\0';
+
+    struct DiagLog log = { NULL, 0, 0, 0 };
+    int jobs = pool_jobs;
+    jmp_buf recover;
+    bool ok = false;
+    diag_log = &log;
+    pool_jobs = options->threads;
+    intern_thread();
+    syntax_errors = 0;
+
+    if (setjmp(recover) == 0) {
+        diag_recover = &recover;
+        ok = compile_text(text, size, options, result);
+    }
+    else {
+        /* the passes were left halfway, their storage is reset as after a compile with errors */
+        /* result->ir is only set once the ir code is whole, so a failure of the assembler leaves it to the caller */
+        release_passes();
+        diag_add(CMM_INTERNAL, 0, 0, "%s", diag_failure);
+    }
+    diag_recover = NULL;
+    reset_code();
+    reset_intern();                     // nothing of the result points into the names of the compile
+    free(text);
+
+    diag_log = NULL;
+    pool_jobs = jobs;
+    result->diags = log.items;
+    result->diag_num = log.num;
+    return ok;
+}
+
+//release the buffers of arg:result filled by cmm_compile
+void cmm_free(struct CmmResult* result) {
+    for (int i = 0; i < result->diag_num; ++i)
+        free(result->diags[i].message);
+    free(result->diags);
+    free(result->assembly);
+    free(result->ir);
+    memset(result, 0, sizeof(struct CmmResult));
+}
+
+//release the storage which the calling thread keeps for its next compile
+void cmm_release() {
+    clear_tree();
+    clear_attrs();
+    clear_code();
+    arena_release(&type_arena);
+    if (intern_pool != NULL)            // the pool of the process is left to the program
+        clear_intern();
+}
@@ -0,0 +1,47 @@
+#ifndef CMM_H
+#define CMM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* library interface compiling C-- sources in memory, built into libcmm.a by "make lib" */
+/* the state of a compile is kept by the calling thread, so threads may compile at once */
+/* the storage of a compile is kept for the next one on the thread, until cmm_release */
+/* the library is linked with -lfl and -lpthread, each thread interns the names of its compiles into a pool of its own */
+
+enum CmmDiagKind { // kinds of diagnostics
+    CMM_NOTE,                           //message of the scanner which is no error, as a skipped string
+    CMM_LEXICAL,                        //error type A
+    CMM_SYNTAX,                         //error type B, the message is the one of the parser
+    CMM_SEMANTIC,                       //error of semantic analysis, numbered by type
+    CMM_TRANSLATE,                      //program which cannot be translated to ir code
+    CMM_INTERNAL                        //failed check of the compiler itself, the compile is abandoned
+};
+
+struct CmmDiagnostic { // Definition of the messages of a compile, which are printed by the parser program
+    enum CmmDiagKind kind;
+    int type;                           //[CMM_SEMANTIC]:error type, others:0
+    int lineno;                         //line of the source, 0 if the message is about the whole program
+    char* message;                      //text without the "Error type" prefix
+};
+
+struct CmmOptions {
+    bool emit_ir;                       //keep the ir code in CmmResult.ir as well
+    int threads;                        //threads checking and assembling the functions, 0 for one per online processor
+    bool skip_assembly;                 //with emit_ir, stop after the ir code, CmmResult.assembly is left NULL
+};
+
+struct CmmResult { // Definition of the outputs of a compile, released by cmm_free
+    char* assembly;                     //NUL-terminated MIPS assembly, NULL if the source has errors or the assembly is skipped
+    size_t assembly_len;
+    char* ir;                           //NUL-terminated ir code if CmmOptions.emit_ir, kept when only the assembler fails, otherwise NULL
+    size_t ir_len;
+    struct CmmDiagnostic* diags;        //diagnostics in the order they are reported, semantic errors in line order
+    int diag_num;
+};
+
+bool cmm_compile(const char* source, size_t size, const struct CmmOptions* options, struct CmmResult* result);
+void cmm_free(struct CmmResult* result);
+void cmm_release();
+
+#endif
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "diag.h"
+
+__thread struct DiagLog* diag_log = NULL;
+__thread jmp_buf* diag_recover = NULL;
+__thread char diag_failure[DIAG_FAILURE_SIZE];
+
+/* Operations on diagnostics */
+
+//keep a diagnostic of arg:kind in diag_log, its message is formatted by arg:format as printf
+void diag_add(enum CmmDiagKind kind, int type, int lineno, const char* format, ...) {
+    va_list ap;
+    va_start(ap, format);
+    int len = vsnprintf(NULL, 0, format, ap);
+    va_end(ap);
+
+    char* message = malloc(len + 1);
+    if (diag_log->num >= diag_log->cap) {
+        diag_log->cap = diag_log->cap ? diag_log->cap * 2 : 16;
+        diag_log->items = realloc(diag_log->items, diag_log->cap * sizeof(struct CmmDiagnostic));
+    }
+    if (message == NULL || diag_log->items == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    va_start(ap, format);
+    vsnprintf(message, len + 1, format, ap);
+    va_end(ap);
+
+    diag_log->items[diag_log->num++] = (struct CmmDiagnostic){ kind, type, lineno, message };
+    if (kind != CMM_NOTE)
+        ++diag_log->errors;
+}
+
+//report an internal failure formatted by arg:format as printf, the message is kept in diag_failure
+//a library compile jumps back to diag_recover and fails with it, nothing is allocated on the way
+//otherwise the message is printed to stderr and the process aborts, as a failed assert does
+void diag_fail(const char* format, ...) {
+    va_list ap;
+    va_start(ap, format);
+    vsnprintf(diag_failure, DIAG_FAILURE_SIZE, format, ap);
+    va_end(ap);
+    if (diag_recover != NULL)
+        longjmp(*diag_recover, 1);
+    fprintf(stderr, "%s\n", diag_failure);
+    abort();
+}
+
+//write arg:num diagnostics at arg:diags as parser prints them, syntax errors to arg:err and the others to arg:out
+void diag_print(const struct CmmDiagnostic* diags, int num, struct OutBuf* out, struct OutBuf* err) {
+    for (int i = 0; i < num; ++i) {
+        char head[64] = "";
+        if (diags[i].kind == CMM_LEXICAL)
+            snprintf(head, sizeof(head), "Error type A at Line %d: ", diags[i].lineno);
+        else if (diags[i].kind == CMM_SEMANTIC)
+            snprintf(head, sizeof(head), "Error type %d at Line %d: ", diags[i].type, diags[i].lineno);
+        else if (diags[i].kind == CMM_INTERNAL)
+            strcpy(head, "Internal error: ");
+
+        struct OutBuf* to = diags[i].kind == CMM_SYNTAX || diags[i].kind == CMM_INTERNAL ? err : out;
+        out_str(to, head);
+        out_str(to, diags[i].message);
+        out_str(to, diags[i].kind == CMM_NOTE || diags[i].kind == CMM_TRANSLATE ? " \n" : "\n");
+    }
+}
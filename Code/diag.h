@@ -0,0 +1,27 @@
+#ifndef DIAG_H
+#define DIAG_H
+
+#include <setjmp.h>
+#include "cmm.h"
+#include "outbuf.h"
+
+#define DIAG_FAILURE_SIZE 256           //bytes of the message of an internal failure
+
+//check arg:cond, which holds unless the compiler itself is wrong, see diag_fail
+#define DIAG_ASSERT(cond) ((cond) ? (void)0 : diag_fail("%s:%d: assertion `%s' failed", __FILE__, __LINE__, #cond))
+
+struct DiagLog { // Definition of the diagnostics of a library compile, which are kept instead of printed
+    struct CmmDiagnostic* items;
+    int num, cap;
+    int errors;                         //number of items which are not CMM_NOTE
+};
+
+extern __thread struct DiagLog* diag_log; //diagnostics of the thread are kept here if it is not NULL
+extern __thread jmp_buf* diag_recover;  //recovery point of the library compile on the thread, NULL to abort on internal failures
+extern __thread char diag_failure[DIAG_FAILURE_SIZE]; //message of the last internal failure of the thread
+
+void diag_add(enum CmmDiagKind kind, int type, int lineno, const char* format, ...);
+void diag_fail(const char* format, ...);
+void diag_print(const struct CmmDiagnostic* diags, int num, struct OutBuf* out, struct OutBuf* err);
+
+#endif
@@ -0,0 +1,349 @@
+#define _POSIX_C_SOURCE 200809L
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "sparse.h"
+#include "ircode.h"
+#include "assemble.h"
+#include "sha256.h"
+#include "incr.h"
+
+/* Definitions of incremental compiles */
+
+#define INCR_VERSION "cmm " __DATE__ " " __TIME__ //version of the compiler hashed into the fingerprints
+#define INCR_MAGIC "CMMFDB1\n"          //first bytes of a database, followed by its entries
+#define INCR_HEADER (SHA256_SIZE + 16)  //bytes of the fingerprint and the four numbers leading an entry
+#define NO_TEXT UINT32_MAX              //length of the assembly of a function which was not assembled
+
+struct FuncEntry { // Definition of the outputs of one function kept in the database
+    uint8_t key[SHA256_SIZE];           //fingerprint of the function
+    uint32_t tmp_used;                  //number of temporaries and labels of the function
+    uint32_t label_used;
+    uint32_t ir_len;
+    uint32_t asm_len;                   //NO_TEXT if the function was not assembled
+    const char* ir;                     //texts written relative to the bases of the function, see relocate_code
+    const char* asm_text;
+    char* buffer;                       //heap buffer of the texts of an entry made by this compile, NULL for a loaded one
+};
+
+struct FuncDB { // Definition of databases of functions
+    struct FuncEntry* items;
+    int num, cap;
+    char* data;                         //the loaded file which the texts of its entries point to
+};
+
+struct FuncScan {                       //symbols met in the tree of a function
+    struct Symbol** symbols;            //variants and functions referred to or declared, in tree order
+    int num, cap;
+    int var_base;                       //least number of the variants declared by the function, INT_MAX if none is
+};
+
+static void hash_str(struct Sha256* ctx, const char* str) {
+    if (str == NULL)
+        str = "";
+    sha256_update(ctx, str, strlen(str) + 1);
+}
+
+//feed the signature of arg:type to arg:ctx, a struct with the names, offsets and types of its fields
+static void hash_type(struct Sha256* ctx, const struct Type* type) {
+    int32_t head[3] = { -1, 0, 0 };
+    if (type != NULL) {
+        head[0] = type->kind;
+        head[1] = type->kind == BASIC ? type->basic : type->kind == ARRAY ? type->array.size : 0;
+        head[2] = type->size;
+    }
+    sha256_update(ctx, head, sizeof(head));
+
+    if (type != NULL && type->kind == ARRAY)
+        hash_type(ctx, type->array.elem_type);
+    else if (type != NULL && type->kind == STRUCTURE) {
+        hash_str(ctx, type->struct_id);
+        for (const struct FieldList* field = type->structure; field != NULL; field = field->next) {
+            hash_str(ctx, field->id);
+            sha256_update(ctx, &field->offset, sizeof(field->offset));
+            hash_type(ctx, field->type);
+        }
+        sha256_update(ctx, "", 1);
+    }
+}
+
+//feed arg:symbol to arg:ctx, with its number if it is a variant declared before arg:var_base
+static void hash_symbol(struct Sha256* ctx, const struct Symbol* symbol, int var_base) {
+    int32_t head[2] = { symbol->kind, symbol->kind == VAR && symbol->var_num < var_base ? symbol->var_num : -1 };
+    hash_str(ctx, symbol->id);
+    sha256_update(ctx, head, sizeof(head));
+    if (symbol->kind == PROC) {
+        hash_type(ctx, symbol->proc_type.ret_type);
+        for (int i = 0; i < MAX_ARGS; ++i)
+            hash_type(ctx, symbol->proc_type.argtype_list[i]);
+    }
+    else
+        hash_type(ctx, symbol->type);
+}
+
+//feed the tokens of arg:vertex to arg:ctx and collect the symbols of its analysed nodes into arg:scan
+static void scan_tree(struct Sha256* ctx, NodeRef vertex, struct FuncScan* scan) {
+    enum NodeKind kind = node_kind(vertex);
+    uint8_t head[2] = { kind, kind == NK_TYPE || kind == NK_RELOP ? node_sub(vertex) : 0 };
+    sha256_update(ctx, head, sizeof(head));
+    if (node_is_token(vertex)) {
+        if (kind == NK_ID || kind == NK_INT || kind == NK_FLOAT)
+            hash_str(ctx, node_text(vertex));
+        return;
+    }
+
+    if ((kind == NK_Exp || kind == NK_VarDec) && ast_nodes[vertex].attr != 0) {
+        struct Symbol* symbol = node_attr(vertex).symbol;
+        if (symbol != NULL) {
+            if (scan->num == scan->cap) {
+                scan->cap = scan->cap ? scan->cap * 2 : 64;
+                scan->symbols = realloc(scan->symbols, scan->cap * sizeof(struct Symbol*));
+                if (scan->symbols == NULL)
+                    panic("Out of memory");
+            }
+            scan->symbols[scan->num++] = symbol;
+            if (kind == NK_VarDec && symbol->kind == VAR && symbol->var_num < scan->var_base)
+                scan->var_base = symbol->var_num;
+        }
+    }
+    for (int i = 0; i < node_childs(vertex); ++i)
+        scan_tree(ctx, node_child(vertex, i), scan);
+}
+
+//compute the fingerprint of the function ExtDef arg:vertex into arg:key, and the first variant it declares into arg:scan
+//the variants declared by the function are numbered relative to it, so only the numbers of the others are hashed
+static void fingerprint(NodeRef vertex, struct FuncScan* scan, uint8_t key[SHA256_SIZE]) {
+    struct Sha256 ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, INCR_VERSION, sizeof(INCR_VERSION));
+    scan->num = 0;
+    scan->var_base = INT_MAX;
+    scan_tree(&ctx, vertex, scan);
+    for (int i = 0; i < scan->num; ++i)
+        hash_symbol(&ctx, scan->symbols[i], scan->var_base);
+    sha256_final(&ctx, key);
+}
+
+static bool is_function(NodeRef vertex) {
+    return CHECK_ID(node_child(vertex, 1), NK_FunDec) && CHECK_ID(node_child(vertex, 2), NK_CompSt);
+}
+
+/* Operations on databases */
+
+static void push_entry(struct FuncDB* db, const struct FuncEntry* entry) {
+    if (db->num == db->cap) {
+        db->cap = db->cap ? db->cap * 2 : 64;
+        db->items = realloc(db->items, db->cap * sizeof(struct FuncEntry));
+        if (db->items == NULL)
+            panic("Out of memory");
+    }
+    db->items[db->num++] = *entry;
+}
+
+static int compare_entry(const void* a, const void* b) {
+    return memcmp(((const struct FuncEntry*)a)->key, ((const struct FuncEntry*)b)->key, SHA256_SIZE);
+}
+
+//load the database at arg:path into arg:db sorted by fingerprint, a missing or broken file leaves it empty from there on
+static void load_db(const char* path, struct FuncDB* db) {
+    struct stat st;
+    memset(db, 0, sizeof(struct FuncDB));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)strlen(INCR_MAGIC)) {
+        close(fd);
+        return;
+    }
+
+    size_t size = st.st_size, len = 0;
+    ssize_t n;
+    db->data = malloc(size);
+    if (db->data == NULL)
+        panic("Out of memory");
+    while (len < size && (n = read(fd, db->data + len, size - len)) > 0)
+        len += n;
+    close(fd);
+    if (len < size || memcmp(db->data, INCR_MAGIC, strlen(INCR_MAGIC)) != 0)
+        return;
+
+    const char* p = db->data + strlen(INCR_MAGIC);
+    const char* end = db->data + size;
+    while (end - p >= INCR_HEADER) {
+        struct FuncEntry entry;
+        uint32_t numbers[4];
+        memcpy(entry.key, p, SHA256_SIZE);
+        memcpy(numbers, p + SHA256_SIZE, sizeof(numbers));
+        entry.tmp_used = numbers[0];
+        entry.label_used = numbers[1];
+        entry.ir_len = numbers[2];
+        entry.asm_len = numbers[3];
+        uint64_t text_len = (uint64_t)entry.ir_len + (entry.asm_len == NO_TEXT ? 0 : entry.asm_len);
+        if ((uint64_t)(end - p - INCR_HEADER) < text_len)
+            break;
+        entry.ir = p + INCR_HEADER;
+        entry.asm_text = entry.ir + entry.ir_len;
+        entry.buffer = NULL;
+        push_entry(db, &entry);
+        p += INCR_HEADER + text_len;
+    }
+    qsort(db->items, db->num, sizeof(struct FuncEntry), compare_entry);
+}
+
+static const struct FuncEntry* find_entry(const struct FuncDB* db, const uint8_t key[SHA256_SIZE]) {
+    struct FuncEntry probe;
+    memcpy(probe.key, key, SHA256_SIZE);
+    return db->num > 0 ? bsearch(&probe, db->items, db->num, sizeof(struct FuncEntry), compare_entry) : NULL;
+}
+
+static bool write_all(int fd, const void* data, size_t len) {
+    const char* p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+//write arg:db to arg:path through a temporary file, so an interrupted compile leaves the old database
+//a database which cannot be written only makes the next compile slower
+static void save_db(const char* path, const struct FuncDB* db) {
+    char* temp = malloc(strlen(path) + 8);
+    if (temp == NULL)
+        panic("Out of memory");
+    sprintf(temp, "%s.XXXXXX", path);
+    int fd = mkstemp(temp);
+    if (fd < 0) {
+        free(temp);
+        return;
+    }
+
+    bool ok = write_all(fd, INCR_MAGIC, strlen(INCR_MAGIC));
+    for (int i = 0; ok && i < db->num; ++i) {
+        const struct FuncEntry* entry = &db->items[i];
+        uint32_t numbers[4] = { entry->tmp_used, entry->label_used, entry->ir_len, entry->asm_len };
+        ok = write_all(fd, entry->key, SHA256_SIZE) && write_all(fd, numbers, sizeof(numbers))
+            && write_all(fd, entry->ir, entry->ir_len)
+            && (entry->asm_len == NO_TEXT || write_all(fd, entry->asm_text, entry->asm_len));
+    }
+    ok = ok && fchmod(fd, 0644) == 0;
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(temp, path) != 0)
+        unlink(temp);
+    free(temp);
+}
+
+static void free_db(struct FuncDB* db) {
+    for (int i = 0; i < db->num; ++i)
+        free(db->items[i].buffer);
+    free(db->items);
+    free(db->data);
+}
+
+/* Operations on functions */
+
+//translate the function ExtDef arg:vertex, and assemble it if arg:need_asm, into the relocatable texts of arg:entry
+//its operands are numbered from arg:base, the ir code list is left empty
+static void build_entry(NodeRef vertex, const struct CodeBase* base, bool need_asm, struct FuncEntry* entry) {
+    struct OutBuf ir;
+    struct AsmContext ctx;
+    translate_ExtDef(vertex);
+    entry->tmp_used = tmp_count - base->tmp;
+    entry->label_used = label_count - base->label;
+
+    code_base = base;
+    out_open_mem(&ir);
+    export_code(&ir);
+    if (need_asm) {
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.code.begin = begin_code();
+        ctx.code.length = code_num();
+        assemble_func(&ctx);
+    }
+    code_base = NULL;
+    reset_code();
+
+    entry->ir_len = ir.len;
+    entry->asm_len = need_asm ? ctx.out.len : NO_TEXT;
+    entry->buffer = malloc(ir.len + (need_asm ? ctx.out.len : 0) + 1);
+    if (entry->buffer == NULL)
+        panic("Out of memory");
+    memcpy(entry->buffer, ir.data, ir.len);
+    if (need_asm) {
+        memcpy(entry->buffer + ir.len, ctx.out.data, ctx.out.len);
+        out_close(&ctx.out);
+    }
+    out_close(&ir);
+    entry->ir = entry->buffer;
+    entry->asm_text = entry->buffer + ir.len;
+}
+
+/* Interfaces */
+
+//translate and write the analysed program arg:root as translate_semantic and the parser do, through the database at arg:db_path
+//the ir code is written to arg:filename if arg:emit_ir, otherwise it is assembled into arg:filename if it is not NULL
+//functions found in the database are renumbered into the output instead of being translated and assembled
+//return false without doing anything if the program has errors, cannot be translated or has no function
+bool compile_incremental(NodeRef root, const char* db_path, char* filename, bool emit_ir) {
+    NodeRef list = node_child(root, 0);
+    int func_num = 0;
+    for (int i = 0; i < node_childs(list); ++i)
+        func_num += is_function(node_child(list, i));
+    if (func_num == 0 || semantic_errors() > 0 || !legal_to_output())
+        return false;
+
+    struct FuncDB old, next = { NULL, 0, 0, NULL };
+    struct FuncScan scan = { NULL, 0, 0, INT_MAX };
+    struct OutBuf output, text;
+    bool need_asm = !emit_ir && filename != NULL;
+    load_db(db_path, &old);
+    if (emit_ir && !out_open(&output, filename)) {
+        perror(filename);
+        exit(1);
+    }
+    else if (need_asm)
+        assemble_begin(filename);
+    out_open_mem(&text);
+
+    translate_init();
+    for (int i = 0; i < node_childs(list); ++i) {
+        NodeRef vertex = node_child(list, i);
+        if (!is_function(vertex))
+            continue;
+
+        struct FuncEntry entry;
+        fingerprint(vertex, &scan, entry.key);
+        struct CodeBase base = { scan.var_base, tmp_count, label_count };
+        const struct FuncEntry* found = find_entry(&old, entry.key);
+        if (found != NULL && (!need_asm || found->asm_len != NO_TEXT))
+            entry = *found;
+        else
+            build_entry(vertex, &base, need_asm, &entry);
+        tmp_count = base.tmp + entry.tmp_used;
+        label_count = base.label + entry.label_used;
+        push_entry(&next, &entry);
+
+        if (emit_ir)
+            relocate_code(&output, entry.ir, entry.ir_len, &base);
+        else if (need_asm) {
+            text.len = 0;
+            relocate_code(&text, entry.asm_text, entry.asm_len, &base);
+            assemble_text(text.data, text.len);
+        }
+    }
+
+    if (emit_ir)
+        out_close(&output);
+    else if (need_asm)
+        assemble_end();
+    out_close(&text);
+    save_db(db_path, &next);
+    free_db(&next);
+    free_db(&old);
+    free(scan.symbols);
+    return true;
+}
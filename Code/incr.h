@@ -0,0 +1,15 @@
+#ifndef INCR_H
+#define INCR_H
+
+#include <stdbool.h>
+#include "node.h"
+
+/* function-granular incremental compiles, the ir code and assembly of each function are kept in a sidecar database */
+/* a function is translated and assembled only if its fingerprint changed, the others are spliced in renumbered */
+/* the fingerprint hashes the tokens of the function and the signatures of the symbols it refers to */
+
+#define INCR_SUFFIX ".fdb"              //the database of a source is the file named by the source and this suffix
+
+bool compile_incremental(NodeRef root, const char* db_path, char* filename, bool emit_ir);
+
+#endif
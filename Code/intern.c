@@ -0,0 +1,180 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include "sparse.h"
+
+/* string interning pool */
+
+struct InternShard { // Definition of the parts of the pool, a string is kept by the shard selected by its hash
+    pthread_mutex_t lock;               //held while the shard is changed
+    struct InternStr** chunks[INTERN_MAX_CHUNKS]; //strings indexed by id >> INTERN_SHARD_BITS, in chunks which are never moved
+    uint32_t str_num, chunk_num;
+    uint32_t* table;                    //open addressing table of (index + 1), 0 for an empty slot
+    uint32_t table_cap;
+    struct Arena arena;                 //texts of the strings
+};
+
+struct InternPool { // Definition of a pool of strings, the one of the process or one of a thread made by intern_thread
+    struct InternShard shards[INTERN_SHARDS];
+};
+
+__thread struct InternPool* intern_pool = NULL;
+
+static struct InternPool process_pool;  //pool of the threads whose intern_pool is NULL
+static pthread_once_t intern_once = PTHREAD_ONCE_INIT;
+static __thread struct InternPool* own_pool = NULL; //pool made by intern_thread on the thread
+
+#define INTERN_HEADER(text) ((struct InternStr*)((text) - offsetof(struct InternStr, str)))
+#define INTERN_CHUNK_SIZE (1u << INTERN_CHUNK_BITS)
+#define INTERN_POOL() (intern_pool != NULL ? intern_pool : &process_pool)
+#define INTERN_SHARD(id) (&INTERN_POOL()->shards[(id) & (INTERN_SHARDS - 1)])
+#define INTERN_SLOT(shard, index) (shard)->chunks[(index) >> INTERN_CHUNK_BITS][(index) & (INTERN_CHUNK_SIZE - 1)]
+
+// BKDR Hash Function used for interned strings
+static unsigned int str_hash(const char* str, int len) {
+    unsigned int val = 5381;
+    for (int i = 0; i < len; ++i) {
+        val += (val << 5) + str[i];
+    }
+
+    return (val & 0x7fffffff);
+}
+
+static void init_shards(struct InternPool* pool) {
+    for (int i = 0; i < INTERN_SHARDS; ++i)
+        pthread_mutex_init(&pool->shards[i].lock, NULL);
+}
+
+static void init_process_pool() {
+    init_shards(&process_pool);
+}
+
+// double the slots of the table of arg:shard and rehash its strings with their stored hash values
+// the low bits of a hash select the shard, so the table is addressed by the rest
+static void grow_table(struct InternShard* shard) {
+    uint32_t mask;
+
+    free(shard->table);
+    shard->table_cap = shard->table_cap ? shard->table_cap * 2 : INTERN_INIT_SIZE;
+    shard->table = calloc(shard->table_cap, sizeof(uint32_t));
+    if (shard->table == NULL)
+        panic("Out of memory");
+
+    mask = shard->table_cap - 1;
+    for (uint32_t index = 0; index < shard->str_num; ++index) {
+        uint32_t pos = (INTERN_SLOT(shard, index)->hash >> INTERN_SHARD_BITS) & mask;
+        while (shard->table[pos] != 0)
+            pos = (pos + 1) & mask;
+        shard->table[pos] = index + 1;
+    }
+}
+
+//return the id of the interned copy of arg:len chars at arg:str, interning it if it is new
+//the id keeps the shard in its low bits and the index in the shard above them
+uint32_t intern_id(const char* str, int len) {
+    unsigned int h = str_hash(str, len);
+    uint32_t shard_id = h & (INTERN_SHARDS - 1);
+    struct InternShard* shard = &INTERN_POOL()->shards[shard_id];
+
+    if (intern_pool == NULL)
+        pthread_once(&intern_once, init_process_pool);
+    pthread_mutex_lock(&shard->lock);
+    if ((shard->str_num + 1) * 2 > shard->table_cap)    // keep the load factor under 1/2
+        grow_table(shard);
+
+    uint32_t mask = shard->table_cap - 1;
+    uint32_t pos = (h >> INTERN_SHARD_BITS) & mask;
+    while (shard->table[pos] != 0) {
+        uint32_t index = shard->table[pos] - 1;
+        struct InternStr* s = INTERN_SLOT(shard, index);
+        if (s->hash == h && s->len == (unsigned int)len && memcmp(s->str, str, len) == 0) {
+            pthread_mutex_unlock(&shard->lock);
+            return index << INTERN_SHARD_BITS | shard_id;
+        }
+        pos = (pos + 1) & mask;
+    }
+
+    if (shard->str_num == shard->chunk_num * INTERN_CHUNK_SIZE) {
+        if (shard->chunk_num == INTERN_MAX_CHUNKS)
+            panic("Too many strings");
+        shard->chunks[shard->chunk_num] = malloc(INTERN_CHUNK_SIZE * sizeof(struct InternStr*));
+        if (shard->chunks[shard->chunk_num] == NULL)
+            panic("Out of memory");
+        shard->chunk_num++;
+    }
+    struct InternStr* s = arena_alloc(&shard->arena, sizeof(struct InternStr) + len + 1);
+    s->hash = h;
+    s->len = len;
+    memcpy(s->str, str, len);
+    s->str[len] = '\0';
+
+    uint32_t index = shard->str_num++;
+    INTERN_SLOT(shard, index) = s;
+    shard->table[pos] = index + 1;
+    pthread_mutex_unlock(&shard->lock);
+    return index << INTERN_SHARD_BITS | shard_id;
+}
+
+//return the interned string with id arg:id
+char* intern_at(uint32_t id) {
+    return INTERN_SLOT(INTERN_SHARD(id), id >> INTERN_SHARD_BITS)->str;
+}
+
+//return the interned copy of arg:len chars at arg:str
+char* intern(const char* str, int len) {
+    return intern_at(intern_id(str, len));
+}
+
+//return the interned copy of NUL-terminated arg:str
+char* intern_str(const char* str) {
+    return intern(str, strlen(str));
+}
+
+//return the hash value of arg:str, which must be interned
+unsigned int intern_hash(const char* str) {
+    return INTERN_HEADER(str)->hash;
+}
+
+//make the calling thread intern into a pool of its own instead of the pool of the process
+//threads of pool_run take the pool of their caller, so the names of one compile are shared by its workers
+void intern_thread() {
+    if (own_pool == NULL) {
+        if ((own_pool = calloc(1, sizeof(struct InternPool))) == NULL)
+            panic("Out of memory");
+        init_shards(own_pool);
+    }
+    intern_pool = own_pool;
+}
+
+//forget all strings of the pool of the thread, keeping its storage for the next ones
+//every pointer and id returned before becomes invalid
+void reset_intern() {
+    for (int i = 0; i < INTERN_SHARDS; ++i) {
+        struct InternShard* shard = &INTERN_POOL()->shards[i];
+        if (shard->table != NULL)
+            memset(shard->table, 0, shard->table_cap * sizeof(uint32_t));
+        shard->str_num = 0;
+        arena_reset(&shard->arena);
+    }
+}
+
+//free all strings of the pool of the thread, every pointer and id returned before becomes invalid
+//a pool made by intern_thread is freed as well, and the thread goes back to the pool of the process
+void clear_intern() {
+    for (int i = 0; i < INTERN_SHARDS; ++i) {
+        struct InternShard* shard = &INTERN_POOL()->shards[i];
+        for (uint32_t k = 0; k < shard->chunk_num; ++k) {
+            free(shard->chunks[k]);
+            shard->chunks[k] = NULL;
+        }
+        free(shard->table);
+        shard->table = NULL;
+        shard->str_num = shard->chunk_num = shard->table_cap = 0;
+        arena_release(&shard->arena);
+    }
+    if (intern_pool != NULL && intern_pool == own_pool) {
+        for (int i = 0; i < INTERN_SHARDS; ++i)
+            pthread_mutex_destroy(&own_pool->shards[i].lock);
+        free(own_pool);
+        own_pool = intern_pool = NULL;
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define INTERN_INIT_SIZE 256            //initial number of slots of the table of a shard, a power of 2
+#define INTERN_SHARD_BITS 4             //the pool is split into 1 << INTERN_SHARD_BITS shards locked separately
+#define INTERN_SHARDS (1 << INTERN_SHARD_BITS)
+#define INTERN_CHUNK_BITS 14            //strings indexed by one chunk of the id index of a shard are 1 << INTERN_CHUNK_BITS
+#define INTERN_MAX_CHUNKS (1 << 14)     //chunks of the id index of a shard, which is never moved
+
+struct InternStr { // Definition of interned strings, the text follows the header
+    unsigned int hash;                  //hash value of the text
+    unsigned int len;                   //length of the text
+    char str[];                         //NUL-terminated text
+};
+
+/* interned strings are stored once and compared by pointer, they must never be modified */
+/* each shard of the pool is changed under its own lock, an id handed to another thread can be read by intern_at without it */
+/* threads share the pool of the process, unless intern_thread gives one its own pool which reset_intern and clear_intern can drop */
+
+struct InternPool;
+extern __thread struct InternPool* intern_pool;    //pool of the thread, NULL for the pool of the process
+
+uint32_t intern_id(const char* str, int len);
+char* intern_at(uint32_t id);
+char* intern(const char* str, int len);
+char* intern_str(const char* str);
+unsigned int intern_hash(const char* str);
+void intern_thread();
+void reset_intern();
+void clear_intern();
+
+#endif
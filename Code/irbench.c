@@ -0,0 +1,91 @@
+#ifdef CMM_IRBENCH
+/* microbenchmark of the ir code list, built alone into irbench by "make bench-ir" */
+/* it adds, removes and replaces millions of items through the chunks and the free list of ircode.c */
+/* and compares rm_code with the removal of the old list, which walked from ir_head to its target */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ircode.h"
+
+#define BENCH_ITEMS 4000000             //items added by each round
+#define BENCH_WALKS 100                 //removals timed with the walk of the old list
+
+static double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void report(const char* name, long ops, double seconds) {
+    printf("%-28s %10ld ops %9.3f ms %8.2f ns/op\n", name, ops, seconds * 1e3, seconds * 1e9 / ops);
+}
+
+//add BENCH_ITEMS items to the empty list, keeping them in arg:items
+static void add_items(struct CodeListItem** items) {
+    struct Operand opd = { OPD_TMP, OM_NONE, { 1 } };
+    for (long i = 0; i < BENCH_ITEMS; ++i) {
+        opd.id = (int)i;
+        items[i] = add_code(OT_ASSIGN, &opd, &opd, NULL, 0);
+    }
+}
+
+//remove arg:target as the old rm_code did, finding it by a walk from the first item
+static struct CodeListItem* walk_remove(struct CodeListItem* target) {
+    struct CodeListItem* ptr = begin_code();
+    while (ptr != NULL && ptr != target)
+        ptr = next_code(ptr);
+    return ptr != NULL ? rm_code(ptr) : NULL;
+}
+
+int main() {
+    struct CodeListItem** items = malloc(BENCH_ITEMS * sizeof(struct CodeListItem*));
+    if (items == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    struct Operand opd = { OPD_IMM, OM_NONE, { 0 } };
+
+    double begin = now();
+    add_items(items);
+    report("add_code from chunks", BENCH_ITEMS, now() - begin);
+
+    begin = now();
+    for (long i = 0; i < BENCH_ITEMS; i += 2)
+        replace_code(items[i], OT_ADD, &opd, &opd, &opd, 0);
+    report("replace_code", BENCH_ITEMS / 2, now() - begin);
+
+    begin = now();
+    for (long i = 1; i < BENCH_ITEMS; i += 2)
+        rm_code(items[i]);
+    report("rm_code every other item", BENCH_ITEMS / 2, now() - begin);
+
+    begin = now();
+    for (long i = 0; i < BENCH_ITEMS / 2; ++i)
+        items[2 * i + 1] = add_code(OT_ASSIGN, &opd, NULL, &opd, 0);
+    report("add_code from the free list", BENCH_ITEMS / 2, now() - begin);
+
+    //the old list walked half of the list on average to remove an item
+    begin = now();
+    for (long i = 0; i < BENCH_WALKS; ++i)
+        walk_remove(items[(BENCH_ITEMS / 2 + i * 2) % BENCH_ITEMS]);
+    report("remove by walk (old rm_code)", BENCH_WALKS, now() - begin);
+
+    begin = now();
+    clear_code();
+    report("clear_code", 1, now() - begin);
+
+    begin = now();
+    for (int round = 0; round < 3; ++round) {
+        add_items(items);
+        for (long i = 0; i < BENCH_ITEMS; ++i)
+            rm_code(items[i]);
+        clear_code();
+    }
+    report("add, rm_code and clear x3", 6L * BENCH_ITEMS, now() - begin);
+
+    free(items);
+    return 0;
+}
+#endif
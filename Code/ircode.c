@@ -6,47 +6,74 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include "ircode.h"
+#include "arena.h"
+#include "stats.h"
+#include "diag.h"
 
-/* Definitions of global data structure */
+/* Definitions of global data structure, the code list is built by each thread */
 
-static struct CodeListItem ir_head = { NULL, OT_FLAG, NULL, NULL, NULL, NULL, NULL }; //The head Node of intermediate code list
-static unsigned length = 0; //Length of ir code list led by ir_head
+static __thread struct CodeListItem ir_head = { NULL, OT_FLAG }; //The head Node of intermediate code list
+static __thread unsigned length = 0; //Length of ir code list led by ir_head
+
+static __thread struct CodeChunk* chunk_list = NULL; //chunks which items of ir code list are allocated from, the newest first
+static __thread unsigned chunk_used = CODE_CHUNK_SIZE; //number of used items in the newest chunk
+static __thread struct CodeListItem* free_items = NULL; //removed items waiting for reuse, linked by next
+
+__thread const struct CodeBase* code_base = NULL;
+
+static const char* relop_names[] = { "==", "!=", ">", "<", ">=", "<=" }; //text of relational operators, indexed by RELOP_TYPE
 
 /* Assistant tool functions in local file */
 
-//make a deep copy of arg:src to arg:dst
-void copy_str(char** dst, const char* src) {
-    *dst = malloc(strlen(src) + 1);
-    strcpy(*dst, src);
+//fill in the operands of arg:target, a NULL operand is stored as OPD_NONE
+void fill_item(struct CodeListItem* target, const struct Operand* left, const struct Operand* right, const struct Operand* dst) {
+    static const struct Operand none = { OPD_NONE };
+
+    target->left = (left != NULL) ? *left : none;
+    target->right = (right != NULL) ? *right : none;
+    target->dst = (dst != NULL) ? *dst : none;
 }
 
-//clear the heap space occupied by arg:target's members
-void clear_item(struct CodeListItem* target) {
-    free(target->left);
-    free(target->right);
-    free(target->dst);
-    free(target->extra);
+//get an unused item from the free list or the newest chunk
+struct CodeListItem* alloc_item() {
+    struct CodeListItem* item;
+    if (free_items != NULL) {
+        item = free_items;
+        free_items = item->next;
+    }
+    else {
+        if (chunk_used == CODE_CHUNK_SIZE) {
+            struct CodeChunk* chunk = arena_alloc(&ir_arena, sizeof(struct CodeChunk));
+            chunk->next = chunk_list;
+            chunk_list = chunk;
+            chunk_used = 0;
+        }
+        item = &chunk_list->items[chunk_used++];
+    }
+
+    memset(item, 0, CODE_LIST_ITEM_SIZE);
+    return item;
+}
 
-    target->left = NULL;
-    target->right = NULL;
-    target->dst = NULL;
-    target->extra = NULL;
+//put arg:item into the free list, a freed item has no last item
+void free_item(struct CodeListItem* item) {
+    item->last = NULL;
+    item->next = free_items;
+    free_items = item;
 }
 
 /* Operations on intermediate code list */
 
 //add a new item to ir code list
 //return the pointer of the new item
-struct CodeListItem* add_code(enum OPERATOR_TYPE opt, char* left, char* right, char* dst, char* extra) {
-    struct CodeListItem* new_item = malloc(CODE_LIST_ITEM_SIZE);
-    memset(new_item, 0, CODE_LIST_ITEM_SIZE);
+struct CodeListItem* add_code(enum OPERATOR_TYPE opt, const struct Operand* left, const struct Operand* right, const struct Operand* dst, enum RELOP_TYPE relop) {
+    struct CodeListItem* new_item = alloc_item();
+    STAT_COUNT(COUNT_ADD_CODE);
 
     //use arguments to fill in the new item
     new_item->opt = opt;
-    if (dst != NULL) copy_str(&new_item->dst, dst);
-    if (left != NULL) copy_str(&new_item->left, left);
-    if (right != NULL) copy_str(&new_item->right, right);
-    if (extra != NULL) copy_str(&new_item->extra, extra);
+    new_item->relop = relop;
+    fill_item(new_item, left, right, dst);
 
     if (length == 0) {
         ir_head.next = new_item;
@@ -66,41 +93,29 @@ struct CodeListItem* add_code(enum OPERATOR_TYPE opt, char* left, char* right, c
     return new_item;
 }
 
-//find the item that arg:target points to and remove it
+//unlink the item that arg:target points to and recycle it
 //return the pointer of next item if the operation is done, otherwise return NULL
 struct CodeListItem* rm_code(struct CodeListItem* target) {
-    if (length == 0 || target == NULL) return NULL;
+    if (length == 0 || target == NULL || target->opt == OT_FLAG || target->last == NULL) return NULL;
 
-    struct CodeListItem* ptr = ir_head.next;
-    while (ptr->opt != OT_FLAG) {
-        if (ptr == target) {
-            struct CodeListItem* last = ptr->last;
-            struct CodeListItem* next = ptr->next;
-            last->next = next;
-            next->last = last;
-
-            clear_item(target);
-            free(target);
-            length--;
-            return next;
-        }
-        ptr = ptr->next;
-    }
+    struct CodeListItem* last = target->last;
+    struct CodeListItem* next = target->next;
+    last->next = next;
+    next->last = last;
 
-    return NULL;
+    free_item(target);
+    length--;
+    return next;
 }
 
 //find the item that arg:target points to and replace it
 //return the pointer of replaced item if the operation is done, otherwise return NULL
-struct CodeListItem* replace_code(struct CodeListItem* target, enum OPERATOR_TYPE opt, char* left, char* right, char* dst, char* extra) {
+struct CodeListItem* replace_code(struct CodeListItem* target, enum OPERATOR_TYPE opt, const struct Operand* left, const struct Operand* right, const struct Operand* dst, enum RELOP_TYPE relop) {
     if (length == 0 || target == NULL) return NULL;
 
-    clear_item(target);
     target->opt = opt;
-    if (dst != NULL) copy_str(&target->dst, dst);
-    if (left != NULL) copy_str(&target->left, left);
-    if (right != NULL) copy_str(&target->right, right);
-    if (extra != NULL) copy_str(&target->extra, extra);
+    target->relop = relop;
+    fill_item(target, left, right, dst);
 
     return target;
 }
@@ -127,6 +142,14 @@ struct CodeListItem* next_code(struct CodeListItem* target) {
     }
 }
 
+//get the first item of ir code list
+//return NULL if length = 0, otherwise return the ptr of first item
+struct CodeListItem* begin_code() {
+    if (length == 0) return NULL;
+
+    return ir_head.next;
+}
+
 //get the final item of ir code list
 //return NULL if length = 0, otherwise return the ptr of final item
 struct CodeListItem* end_code() {
@@ -135,84 +158,227 @@ struct CodeListItem* end_code() {
     return ir_head.last;
 }
 
-//export the ir code list to file denoted by arg:output
-void export_code( FILE* output) {
-    if (length == 0) return;
+//get the number of items in ir code list
+int code_num() {
+    return length;
+}
 
-    struct CodeListItem* ptr = ir_head.next;
-    while (ptr->opt != OT_FLAG) {
-        
-        switch (ptr->opt)
-        {
-            case OT_LABEL: {
-                fprintf(output, "LABEL %s : \n", ptr->left);
-                break;
-            }
-            case OT_FUNC: {
-                fprintf(output, "FUNCTION %s : \n", ptr->left);
-                break;
-            }
-            case OT_ASSIGN: {
-                fprintf(output, "%s := %s \n", ptr->left, ptr->right);
-                break;
-            }
-            case OT_ADD: {
-                fprintf(output, "%s := %s + %s \n", ptr->dst, ptr->left, ptr->right);
-                break;
-            }
-            case OT_SUB: {
-                fprintf(output, "%s := %s - %s \n", ptr->dst, ptr->left, ptr->right);
-                break;
-            }
-            case OT_MUL: {
-                fprintf(output, "%s := %s * %s \n", ptr->dst, ptr->left, ptr->right);
-                break;
-            }
-            case OT_DIV: {
-                fprintf(output, "%s := %s / %s \n", ptr->dst, ptr->left, ptr->right);
-                break;
-            }
-            case OT_GOTO: {
-                fprintf(output, "GOTO %s \n", ptr->left);
-                break;
-            }
-            case OT_RELOP: {
-                fprintf(output, "IF %s %s %s GOTO %s \n", ptr->left, ptr->extra, ptr->right, ptr->dst);
-                break;
-            }
-            case OT_RET: {
-                fprintf(output, "RETURN %s \n", ptr->left);
-                break;
-            }
-            case OT_DEC: {
-                fprintf(output, "DEC %s %s \n", ptr->left, ptr->right);
-                break;
-            }
-            case OT_ARG: {
-                fprintf(output, "ARG %s \n", ptr->left);
-                break;
-            }
-            case OT_CALL: {
-                fprintf(output, "%s := CALL %s \n", ptr->left, ptr->right);
-                break;
-            }
-            case OT_PARAM: {
-                fprintf(output, "PARAM %s \n", ptr->left);
-                break;
-            }
-            case OT_READ: {
-                fprintf(output, "READ %s \n", ptr->left);
-                break;
-            }
-            case OT_WRITE: {
-                fprintf(output, "WRITE %s \n", ptr->left);
-                break;
+//split ir code list before each OT_FUNC, arg:number is set to the number of runs
+//return the runs in order of the list, which are allocated by malloc
+struct CodeRange* split_code(int* number) {
+    int cap = 0, num = 0;
+    struct CodeRange* res = NULL;
+
+    for (struct CodeListItem* ptr = begin_code(); ptr != NULL; ptr = next_code(ptr)) {
+        if (num == 0 || ptr->opt == OT_FUNC) {
+            if (num == cap) {
+                cap = cap ? cap * 2 : 16;
+                res = realloc(res, cap * sizeof(struct CodeRange));
+                if (res == NULL) {
+                    fprintf(stderr, "Out of memory\n");
+                    exit(1);
+                }
             }
+            res[num].begin = ptr;
+            res[num].length = 0;
+            num++;
+        }
+        res[num - 1].length++;
+    }
+
+    *number = num;
+    return res;
+}
+
+//move the items of ir code list into a new list, leaving the current one empty
+//return the new list, which is released by free_code
+struct CodeList* take_code() {
+    struct CodeList* res = malloc(sizeof(struct CodeList));
+    if (res == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    res->head = ir_head;
+    res->length = length;
+    res->arena = ir_arena;
+    if (length != 0) {
+        res->head.next->last = &res->head;
+        res->head.last->next = &res->head;
+    }
+
+    //the items are owned by the new list now
+    ir_arena.head = NULL;
+    ir_arena.total = 0;
+    chunk_list = NULL;
+    chunk_used = CODE_CHUNK_SIZE;
+    free_items = NULL;
+    ir_head.last = NULL;
+    ir_head.next = NULL;
+    length = 0;
+    return res;
+}
+
+//return the run of all items of arg:list
+struct CodeRange code_range(const struct CodeList* list) {
+    struct CodeRange res = { list->length ? list->head.next : NULL, list->length };
+    return res;
+}
+
+//release arg:list taken by take_code
+void free_code(struct CodeList* list) {
+    arena_release(&list->arena);
+    free(list);
+}
+
+//release all items of ir code list at once, together with the rest of ir_arena
+void clear_code() {
+    arena_release(&ir_arena);
+    reset_code();
+}
+
+//forget all items of ir code list, the memory of ir_arena is kept for the codes added later
+void reset_code() {
+    arena_reset(&ir_arena);
+    chunk_list = NULL;
+    chunk_used = CODE_CHUNK_SIZE;
+    free_items = NULL;
+
+    ir_head.last = NULL;
+    ir_head.next = NULL;
+    length = 0;
+}
+
+/* Operations on operands */
+
+//compare two operands, return true if they have the same text
+bool same_operand(const struct Operand* a, const struct Operand* b) {
+    if (a->kind != b->kind || a->modifier != b->modifier) return false;
+
+    if (a->kind == OPD_FLOAT || a->kind == OPD_FUNC)
+        return a->name == b->name;             // names are interned
+    else
+        return a->id == b->id;
+}
+
+//write arg:id with arg:prefix to arg:out, or as relocation arg:mark relative to arg:base while code_base is set
+static void out_id(struct OutBuf* out, const char* prefix, char mark, int id, int base) {
+    if (code_base == NULL || id < base) {
+        out_str(out, prefix);
+        out_int(out, id);
+        return;
+    }
+    out_char(out, CODE_RELOC);
+    out_char(out, mark);
+    out_int(out, id - base);
+    out_char(out, CODE_RELOC_END);
+}
+
+//write the text of arg:opd to arg:out
+void out_operand(struct OutBuf* out, const struct Operand* opd) {
+    if (opd->kind == OPD_FLOAT || opd->kind == OPD_FUNC) {
+        out_str(out, opd->name);        // names are written without modifiers
+        return;
+    }
+
+    if (opd->modifier == OM_DEREF) out_char(out, '*');
+    else if (opd->modifier == OM_ADDR) out_char(out, '&');
+
+    switch (opd->kind)
+    {
+        case OPD_NONE: break;
+        case OPD_TMP: out_id(out, "t", 't', opd->id, code_base ? code_base->tmp : 0); break;
+        case OPD_VAR: out_id(out, "v", 'v', opd->id, code_base ? code_base->var : 0); break;
+        case OPD_IMM: out_char(out, '#'); out_int(out, opd->value); break;
+        case OPD_SIZE: out_int(out, opd->value); break;
+        case OPD_LABEL: out_id(out, "label", 'l', opd->id, code_base ? code_base->label : 0); break;
+        default:
+            DIAG_ASSERT(0);
+            break;
+    }
+}
+
+//write arg:code to arg:out by arg:format, in which %l, %r and %d stand for the left, right and dst operands, %o for the relop
+void out_code(struct OutBuf* out, const char* format, const struct CodeListItem* code) {
+    const char* text = format;
+    for (const char* ptr = format; *ptr != '\0'; ++ptr) {
+        if (*ptr != '%')
+            continue;
+
+        out_mem(out, text, ptr - text);
+        switch (*++ptr)
+        {
+            case 'l': out_operand(out, &code->left); break;
+            case 'r': out_operand(out, &code->right); break;
+            case 'd': out_operand(out, &code->dst); break;
+            case 'o': out_str(out, relop_names[code->relop]); break;
             default:
-                assert(0);
+                DIAG_ASSERT(0);
                 break;
         }
+        text = ptr + 1;
+    }
+    out_str(out, text);
+}
 
-        ptr = ptr->next;
+//get the text of relational operator arg:relop
+const char* relop_str(enum RELOP_TYPE relop) {
+    return relop_names[relop];
+}
+
+//export the ir code list to arg:output
+void export_code(struct OutBuf* output) {
+    struct CodeRange range = { length ? ir_head.next : NULL, length };
+    export_range(output, range);
+}
+
+//export the codes of arg:range to arg:output
+void export_range(struct OutBuf* output, struct CodeRange range) {
+    static const char* formats[OT_FLAG] = { //text of ir code, indexed by OPERATOR_TYPE
+        [OT_LABEL] = "LABEL %l : \n",
+        [OT_FUNC] = "FUNCTION %l : \n",
+        [OT_ASSIGN] = "%l := %r \n",
+        [OT_ADD] = "%d := %l + %r \n",
+        [OT_SUB] = "%d := %l - %r \n",
+        [OT_MUL] = "%d := %l * %r \n",
+        [OT_DIV] = "%d := %l / %r \n",
+        [OT_GOTO] = "GOTO %l \n",
+        [OT_RELOP] = "IF %l %o %r GOTO %d \n",
+        [OT_RET] = "RETURN %l \n",
+        [OT_DEC] = "DEC %l %r \n",
+        [OT_ARG] = "ARG %l \n",
+        [OT_CALL] = "%l := CALL %r \n",
+        [OT_PARAM] = "PARAM %l \n",
+        [OT_READ] = "READ %l \n",
+        [OT_WRITE] = "WRITE %l \n"
+    };
+    struct CodeListItem* ptr = range.begin;
+    for (int i = 0; i < range.length; ++i, ptr = ptr->next) {
+        DIAG_ASSERT(ptr->opt < OT_FLAG);
+        out_code(output, formats[ptr->opt], ptr);
+    }
+}
+
+//write arg:len bytes of code at arg:text, written while code_base was set, to arg:out with the operands numbered from arg:base
+void relocate_code(struct OutBuf* out, const char* text, size_t len, const struct CodeBase* base) {
+    const char* end = text + len;
+    while (text < end) {
+        const char* mark = memchr(text, CODE_RELOC, end - text);
+        if (mark == NULL || end - mark < 2) {
+            out_mem(out, text, end - text);
+            return;
+        }
+        out_mem(out, text, mark - text);
+
+        int id = 0;
+        for (text = mark + 2; text < end && *text != CODE_RELOC_END; ++text)
+            id = id * 10 + (*text - '0');
+        ++text;
+        switch (mark[1])
+        {
+            case 't': out_char(out, 't'); out_int(out, base->tmp + id); break;
+            case 'v': out_char(out, 'v'); out_int(out, base->var + id); break;
+            default: out_str(out, "label"); out_int(out, base->label + id); break;
+        }
     }
-}
\ No newline at end of file
+}
@@ -1,7 +1,16 @@
 #ifndef IRCODE_H
 #define IRCODE_H
 
+#include <stdio.h>
+#include <stdbool.h>
+#include "node.h"
+#include "outbuf.h"
+#include "arena.h"
+
 #define CODE_LIST_ITEM_SIZE sizeof(struct CodeListItem)
+#define CODE_CHUNK_SIZE 4096
+#define CODE_RELOC '\001'               //begins a relocatable operand in the text of code, followed by t, v or l, the relative number and CODE_RELOC_END
+#define CODE_RELOC_END '\002'
 
 enum OPERATOR_TYPE { // Definitions of intermediate code operators, according to table 1 in project3.pdf
     OT_LABEL,
@@ -23,24 +32,100 @@ enum OPERATOR_TYPE { // Definitions of intermediate code operators, according to
     OT_FLAG
 };
 
+enum OPERAND_TYPE { // Definitions of operand kinds of intermediate code
+    OPD_NONE,   // no operand
+    OPD_TMP,    // temporary variant, printed as t<id>
+    OPD_VAR,    // variant, printed as v<id>
+    OPD_IMM,    // integer immediate number, printed as #<value>
+    OPD_FLOAT,  // float immediate number, printed as <name> which begins with '#'
+    OPD_SIZE,   // space size of DEC, printed as <value>
+    OPD_LABEL,  // label, printed as label<id>
+    OPD_FUNC    // function, printed as <name>
+};
+
+enum OPERAND_MODIFIER { // Definitions of prefixes of operands
+    OM_NONE,
+    OM_DEREF,   // *x
+    OM_ADDR     // &x
+};
+
+struct Operand { // Definition of operands of ir code
+    enum OPERAND_TYPE kind;
+    enum OPERAND_MODIFIER modifier;
+    union {
+        int id;                         //[TMP/VAR/LABEL]: number of the operand
+        int value;                      //[IMM/SIZE]: value of the operand
+        const char* name;               //[FLOAT/FUNC]: interned text of the operand
+    };
+};
+
 struct CodeListItem { // Definition of items of bidirected-cyclic ir code list
     struct CodeListItem* last;
 
     enum OPERATOR_TYPE opt;
-    char* left;
-    char* right;
-    char* dst;
-    char* extra;
+    enum RELOP_TYPE relop;
+    struct Operand left;
+    struct Operand right;
+    struct Operand dst;
 
     struct CodeListItem* next;
 };
 
-struct CodeListItem* add_code(enum OPERATOR_TYPE opt, char* left, char* right, char* dst, char* extra);
+struct CodeRange { // Definition of runs of items in ir code list, such as the codes of one function
+    struct CodeListItem* begin;         //first item of the run
+    int length;                         //number of items in the run
+};
+
+struct CodeList { // Definition of ir code lists taken out of the current one, such as the codes of one function
+    struct CodeListItem head;           //head node, as ir_head of the current list
+    int length;
+    struct Arena arena;                 //memory of the items
+};
+
+struct CodeBase { // Definition of the first numbers used by the code of a function
+    int var;                            //first variant declared by the function, the variants before it are written as they are
+    int tmp;
+    int label;
+};
+
+extern __thread const struct CodeBase* code_base; //operands are written relative to it if it is not NULL, see relocate_code
+
+struct CodeChunk { // Definition of chunks which items of ir code list are allocated from
+    struct CodeChunk* next;
+    struct CodeListItem items[CODE_CHUNK_SIZE];
+};
+
+struct CodeListItem* add_code(enum OPERATOR_TYPE opt, const struct Operand* left, const struct Operand* right, const struct Operand* dst, enum RELOP_TYPE relop);
 struct CodeListItem* rm_code(struct CodeListItem* target);
-struct CodeListItem* replace_code(struct CodeListItem* target, enum OPERATOR_TYPE opt, char* left, char* right, char* dst, char* extra);
+struct CodeListItem* replace_code(struct CodeListItem* target, enum OPERATOR_TYPE opt, const struct Operand* left, const struct Operand* right, const struct Operand* dst, enum RELOP_TYPE relop);
 struct CodeListItem* last_code(struct CodeListItem* target);
 struct CodeListItem* next_code(struct CodeListItem* target);
+struct CodeListItem* begin_code();
 struct CodeListItem* end_code();
-void export_code(FILE* output);
+int code_num();
+void clear_code();
+void reset_code();
+struct CodeRange* split_code(int* number);
+struct CodeList* take_code();
+struct CodeRange code_range(const struct CodeList* list);
+void free_code(struct CodeList* list);
+void export_code(struct OutBuf* output);
+void export_range(struct OutBuf* output, struct CodeRange range);
+void relocate_code(struct OutBuf* out, const char* text, size_t len, const struct CodeBase* base);
+
+bool same_operand(const struct Operand* a, const struct Operand* b);
+void out_operand(struct OutBuf* out, const struct Operand* opd);
+void out_code(struct OutBuf* out, const char* format, const struct CodeListItem* code);
+const char* relop_str(enum RELOP_TYPE relop);
+
+/* translation of the analysed tree into the ir code list, in translate.c */
+
+extern __thread unsigned int var_count, tmp_count, label_count; //numbers of the next variant, temporary and label
+
+void translate_init();
+void translate_semantic(NodeRef root);
+void translate_stream(NodeRef vertex);
+void translate_ExtDef(NodeRef vertex);
+bool legal_to_output();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,132 @@
+#ifdef CMM_LEXBENCH
+/* benchmark of lexing throughput, built with libcmm.a into lexbench by "make bench-lex" */
+/* the sources given are repeated into one large file, which is lexed by flex through yyrestart(yyin) as the */
+/* driver did before, by flex on the mapped file through yy_scan_buffer, and by the scanner of -fast-lex */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "node.h"
+#include "scanner.h"
+
+#define BENCH_SIZE (32 << 20)           //bytes of the generated source
+#define BENCH_ROUNDS 3                  //rounds of each path, the fastest is reported
+
+extern int yylineno;
+extern FILE* yyin;
+extern void yyrestart(FILE* file);
+extern void* yy_scan_buffer(char* base, size_t size);
+extern void yy_delete_buffer(void* buffer);
+extern int flex_yylex(void);
+
+static double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+//write the sources arg:files repeated to the temporary file arg:path until it has BENCH_SIZE bytes
+//the file does not end within 2 bytes of a page boundary, so its mapping is followed by the two NULs of yy_scan_buffer
+static size_t make_source(char* path, char** files, int num) {
+    int out = mkstemp(path);
+    size_t size = 0;
+    char block[65536];
+    if (out < 0) {
+        perror(path);
+        exit(1);
+    }
+    while (size < BENCH_SIZE) {
+        for (int i = 0; i < num; ++i) {
+            int in = open(files[i], O_RDONLY);
+            ssize_t n;
+            if (in < 0) {
+                perror(files[i]);
+                exit(1);
+            }
+            while ((n = read(in, block, sizeof(block))) > 0 && write(out, block, n) == n)
+                size += n;
+            close(in);
+            if (write(out, "\n", 1) == 1)
+                ++size;
+        }
+    }
+    long page = sysconf(_SC_PAGESIZE);
+    while (size % page == 0 || page - size % page < 2)
+        size += write(out, " ", 1) == 1;
+    close(out);
+    return size;
+}
+
+//lex the file at arg:path through arg:mode, return the number of tokens
+static long lex_file(const char* path, size_t size, int mode) {
+    long tokens = 0;
+    yylineno = 1;
+    init_tree();
+    if (mode == 0) {
+        yyin = fopen(path, "r");
+        if (yyin == NULL) {
+            perror(path);
+            exit(1);
+        }
+        yyrestart(yyin);
+        while (flex_yylex() != 0)
+            ++tokens;
+        fclose(yyin);
+    }
+    else {
+        int fd = open(path, O_RDONLY);
+        char* text = fd >= 0 ? mmap(NULL, size + 2, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        if (text == MAP_FAILED) {
+            perror(path);
+            exit(1);
+        }
+        close(fd);
+        if (mode == 1) {
+            void* buffer = yy_scan_buffer(text, size + 2);
+            while (flex_yylex() != 0)
+                ++tokens;
+            yy_delete_buffer(buffer);
+        }
+        else {
+            scan_buffer(text, size);
+            while (fast_yylex() != 0)
+                ++tokens;
+        }
+        munmap(text, size + 2);
+    }
+    clear_tree();
+    return tokens;
+}
+
+int main(int argc, char** argv) {
+    static const char* const names[3] = { "flex, yyrestart(yyin)", "flex, mmap + yy_scan_buffer", "-fast-lex, mmap" };
+    char path[] = "/tmp/lexbench-XXXXXX";
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s source...\n", argv[0]);
+        return 1;
+    }
+    size_t size = make_source(path, argv + 1, argc - 1);
+    printf("%zu bytes of source\n", size);
+
+    for (int mode = 0; mode < 3; ++mode) {
+        double best = 0;
+        long tokens = 0;
+        for (int round = 0; round < BENCH_ROUNDS; ++round) {
+            double begin = now();
+            tokens = lex_file(path, size, mode);
+            double seconds = now() - begin;
+            if (round == 0 || seconds < best)
+                best = seconds;
+        }
+        printf("%-28s %10ld tokens %9.3f ms %8.1f MB/s\n", names[mode], tokens, best * 1e3, size / best / 1e6);
+    }
+    unlink(path);
+    return 0;
+}
+#endif
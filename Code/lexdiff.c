@@ -0,0 +1,72 @@
+#ifdef CMM_LEXDIFF
+/* dump of the token stream, built with libcmm.a into lexdiff by "make lexdiff" */
+/* "lexdiff [-fast-lex] source" prints the kind, location and text of each token from the flex scanner */
+/* or the hand-written one, the target diffs both dumps of every source in ../Test */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "node.h"
+#include "syntax.tab.h"
+#include "scanner.h"
+
+extern int yylineno;
+extern void* yy_scan_buffer(char* base, size_t size);
+extern int yylex(YYSTYPE* lval, YYLTYPE* lloc);
+
+//read the whole file arg:name into a heap buffer ended by the two NULs of yy_scan_buffer
+static char* read_source(const char* name, size_t* size) {
+    size_t cap = 4096;
+    ssize_t n;
+    int fd = open(name, O_RDONLY);
+    char* buf = malloc(cap);
+    if (fd < 0 || buf == NULL) {
+        perror(name);
+        exit(1);
+    }
+    *size = 0;
+    while ((n = read(fd, buf + *size, cap - *size - 2)) > 0) {
+        *size += n;
+        if (cap - *size - 2 == 0 && (buf = realloc(buf, cap *= 2)) == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    close(fd);
+    buf[*size] = buf[*size + 1] = '\0';
+    return buf;
+}
+
+int main(int argc, char** argv) {
+    const char* name = argc == 3 && strcmp(argv[1], "-fast-lex") == 0 ? argv[2] : argc == 2 ? argv[1] : NULL;
+    if (name == NULL) {
+        fprintf(stderr, "usage: %s [-fast-lex] source\n", argv[0]);
+        return 1;
+    }
+    fast_scan = argc == 3;
+
+    size_t size;
+    char* text = read_source(name, &size);
+    yylineno = 1;
+    init_tree();
+    if (fast_scan)
+        scan_buffer(text, size);
+    else
+        yy_scan_buffer(text, size + 2);
+
+    YYSTYPE lval;
+    YYLTYPE lloc;
+    int token;
+    while ((token = yylex(&lval, &lloc)) != 0) {
+        printf("%d %d:%d-%d:%d %s line %d %s\n", token, lloc.first_line, lloc.first_column, lloc.last_line, lloc.last_column,
+            node_name(node_kind(lval)), node_line(lval), node_text(lval));
+        fflush(stdout);                 // the scanners print errors to stdout between the tokens
+    }
+    clear_tree();
+    free(text);
+    return 0;
+}
+#endif
@@ -1,31 +1,475 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include "sparse.h"
 #include "assemble.h"
 #include "ircode.h"
+#include "arena.h"
+#include "scanner.h"
+#include "pipeline.h"
+#include "chunk.h"
+#include "pool.h"
+#include "server.h"
+#include "cache.h"
+#include "diag.h"
+#include "incr.h"
+#include "unit.h"
+#include "stats.h"
 
-extern FILE* yyin;
 extern int yylineno;
-extern struct Node* syntax_tree;
+extern __thread NodeRef syntax_tree;
+extern __thread void (*extdef_hook)(NodeRef vertex, struct TreeMark mark);
 
-extern int yyrestart();
+extern void* yy_scan_buffer(char* base, size_t size);
 extern int yyparse();
-extern void translate_semantic(struct Node *root);
+
+static bool emit_ir = false;            //write the ir code instead of assembling it
+static bool stream_mode = false;        //compile each ExtDef as soon as it is parsed
+static bool pipeline_mode = false;      //compile each ExtDef on a pipeline of threads
+static bool parallel_parse = false;     //parse chunks of the source on several threads
+static char* server_path = NULL;        //serve compiles on this unix socket instead of compiling a source
+static char* cache_dir = NULL;          //look the compile up in this cache directory before running the passes
+static int cache_size = CACHE_DEFAULT_SIZE; //MiB of entries kept in the cache directory
+static bool cache_stats = false;        //print the statistics of the cache directory instead of compiling
+static bool incremental = false;        //splice in the unchanged functions kept by the last compile of the source
+static char* incremental_db = NULL;     //database of those functions, named after the source
+static bool unit_mode = false;          //write the source as a unit of a program instead of assembling it
+static bool link_mode = false;          //link units into the assembly of a program instead of compiling a source
+static char* stats_path = NULL;         //write the trace of the phases to this file and print their table to stderr
+
+static struct OutBuf ir_output;         //output of the ir code in stream mode
+static bool assembling = false;         //the assemble output is open in stream mode
+
+struct Source {                         //source text ended with two NULs, as yy_scan_buffer requires
+    char* text;
+    size_t size;                        //bytes of text without the NULs
+    bool mapped;                        //text is a private mapping of the file instead of a heap buffer
+};
+
+//read the whole arg:fd into a heap buffer, for pipes, terminals and files which cannot be mapped
+static void read_source(int fd, struct Source* src) {
+    size_t cap = 4096, len = 0;
+    ssize_t n;
+    char* buf = malloc(cap);
+
+    while (buf != NULL && (n = read(fd, buf + len, cap - len - 2)) != 0) {
+        if (n < 0) {
+            perror("read_source");
+            exit(1);
+        }
+        len += n;
+        if (cap - len - 2 == 0)
+            buf = realloc(buf, cap *= 2);
+    }
+    if (buf == NULL) {
+        perror("read_source");
+        exit(1);
+    }
+
+    buf[len] = buf[len + 1] = '\0';
+    src->text = buf;
+    src->size = len;
+    src->mapped = false;
+}
+
+//map the regular file arg:fd in place, the kernel fills the rest of its last page with the two NULs
+//the scanner writes NULs behind tokens, so the mapping is private and writable
+//fall back to read_source if the file is empty or ends on, or less than two bytes before, a page boundary
+static void load_source(int fd, struct Source* src) {
+    struct stat st;
+    long page = sysconf(_SC_PAGESIZE);
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && page > 0
+        && st.st_size % page != 0 && page - st.st_size % page >= 2) {
+        src->size = st.st_size;
+        src->text = mmap(NULL, src->size + 2, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (src->text != MAP_FAILED) {
+            posix_madvise(src->text, src->size + 2, POSIX_MADV_SEQUENTIAL);
+            src->mapped = true;
+            return;
+        }
+    }
+    read_source(fd, src);
+}
+
+static void release_source(struct Source* src) {
+    if (src->mapped)
+        munmap(src->text, src->size + 2);
+    else
+        free(src->text);
+    src->text = NULL;
+}
+
+struct Option {                         //variables set by the switches of the command line, indexed by enum SwitchId
+    bool* flag;                         //set when the switch is given
+    int* value;                         //set to the number following the switch, for switches without flag
+    char** text;                        //set to the argument following the switch, for switches without flag and value
+};
+
+//sort the command line into switches and files, two of them or any number with -link, return false if it is malformed
+static bool parse_options(int argc, char** argv, char** files) {
+    const struct Option options[SWITCH_NUM] = { // the variants are thread-local, so their addresses are taken at run time
+        [SWITCH_FAST_LEX] = { &fast_scan },         //scan with the hand-written scanner instead of flex
+        [SWITCH_IR] = { &emit_ir },                 //write the ir code to the output, stdout if it is not given
+        [SWITCH_STREAM] = { &stream_mode },         //release the tree and code of each function once it is written
+        [SWITCH_PIPELINE] = { &pipeline_mode },     //parse, check, assemble and write functions on their own threads
+        [SWITCH_PARALLEL_PARSE] = { &parallel_parse }, //parse chunks of ExtDefs in parallel with the hand-written scanner, without -stream and -pipeline
+        [SWITCH_J] = { NULL, &pool_jobs },          //number of threads parsing chunks, checking and assembling functions, one per processor by default
+        [SWITCH_SERVER] = { NULL, NULL, &server_path }, //serve the requests of cmmc on this socket with -j threads, see server.h
+        [SWITCH_CACHE] = { NULL, NULL, &cache_dir },    //reuse the outputs of earlier compiles of the same source kept in this directory, see cache.h
+        [SWITCH_CACHE_SIZE] = { NULL, &cache_size },    //MiB of the cache directory, the least recently used outputs are evicted beyond
+        [SWITCH_CACHE_STATS] = { &cache_stats },        //print the hits, misses and size of the cache directory
+        [SWITCH_INCREMENTAL] = { &incremental },        //translate and assemble only the functions changed since the last compile of the source, without -stream and -pipeline, see incr.h
+        [SWITCH_UNIT] = { &unit_mode },                 //write the summary and assembly of the source to a unit file for -link, see unit.h
+        [SWITCH_LINK] = { &link_mode },                 //check the signatures of the unit files and link them into the output
+        [SWITCH_STATS] = { NULL, NULL, &stats_path },   //time the phases and functions and count the hot paths, into a Chrome trace file and a table on stderr, see stats.h
+    };
+    int file_num = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            enum SwitchId k = find_switch(argv[i]);
+            if (k == SWITCH_NUM) {
+                fprintf(stderr, "unknown option %s\n", argv[i]);
+                return false;
+            }
+            if (options[k].flag != NULL)
+                *options[k].flag = true;
+            else if (options[k].text != NULL) {
+                if (i + 1 == argc) {
+                    fprintf(stderr, "option %s needs an argument\n", parser_switches[k].name);
+                    return false;
+                }
+                *options[k].text = argv[++i];
+            }
+            else {
+                char* end = NULL;
+                if (i + 1 == argc || (*options[k].value = strtol(argv[++i], &end, 10)) < 0 || *end != '\0') {
+                    fprintf(stderr, "option %s needs a number\n", parser_switches[k].name);
+                    return false;
+                }
+            }
+        }
+        else
+            files[file_num++] = argv[i];
+    }
+    if (!link_mode && file_num > 2)
+        return false;
+    if (link_mode && file_num < 2) {
+        fprintf(stderr, "option -link needs an output and unit files\n");
+        return false;
+    }
+    if (unit_mode && (files[1] == NULL || emit_ir || cache_dir != NULL || incremental)) {
+        fprintf(stderr, "option -unit needs a source and a unit file, without -ir, -cache and -incremental\n");
+        return false;
+    }
+    if (stats_path != NULL && (stream_mode || pipeline_mode || cache_dir != NULL || incremental || server_path != NULL || link_mode)) {
+        fprintf(stderr, "option -stats times the whole program, without -stream, -pipeline, -cache, -incremental, -server and -link\n");
+        return false;
+    }
+
+    if (incremental && (stream_mode || pipeline_mode || cache_dir != NULL || server_path != NULL || link_mode)) {
+        fprintf(stderr, "option -incremental keeps the functions of the whole program, without -stream, -pipeline, -cache, -server and -link\n");
+        return false;
+    }
+
+    if (incremental) {
+        if (files[0] == NULL || strcmp(files[0], "-") == 0) {
+            fprintf(stderr, "option -incremental needs a source file\n");
+            return false;
+        }
+        if ((incremental_db = malloc(strlen(files[0]) + strlen(INCR_SUFFIX) + 1)) == NULL)
+            panic("Out of memory");
+        strcat(strcpy(incremental_db, files[0]), INCR_SUFFIX);
+    }
+    return true;
+}
+
+//write the ir code to arg:filename, or assemble it if arg:filename is not NULL
+static void write_program(char* filename) {
+    if (emit_ir) {
+        struct OutBuf output;
+        if (!out_open(&output, filename)) {
+            perror(filename);
+            exit(1);
+        }
+        export_code(&output);
+        out_close(&output);
+    }
+    else if (filename != NULL)
+        assemble(filename);
+}
+
+//parse the whole program arg:src into a tree before analysing, translating and writing it
+static void compile_program(const struct Source* src, char* filename) {
+    struct StatMark mark;
+    stats_begin(&mark, false);
+    if (!parallel_parse || !parse_chunks(src->text, src->size, pool_jobs))
+        yyparse();
+    stats_end(&mark, PHASE_PARSE);
+    stats_begin(&mark, false);
+    semantic_parse(syntax_tree);
+    stats_end(&mark, PHASE_SEMANTIC);
+    bool written = incremental_db != NULL && compile_incremental(syntax_tree, incremental_db, filename, emit_ir);
+    stats_begin(&mark, false);
+    if (!written)
+        translate_semantic(syntax_tree);
+    stats_end(&mark, PHASE_TRANSLATE);
+    /* the syntax tree is useless after translation */
+    syntax_tree = NULL_NODE;
+    clear_attrs();
+    clear_tree();
+
+    stats_begin(&mark, false);
+    if (!written && unit_mode) {
+        if (!write_unit(filename))
+            exit(1);
+    }
+    else if (!written)
+        write_program(filename);
+    if (!written && (emit_ir || filename != NULL))  // nothing is assembled without an output file
+        stats_end(&mark, emit_ir ? PHASE_EXPORT : PHASE_ASSEMBLE);
+    clear_code();
+}
+
+//write arg:len bytes at arg:text to arg:filename, stdout if it is NULL
+static void write_text(const char* filename, const char* text, size_t len) {
+    struct OutBuf output;
+    if (!out_open(&output, filename)) {
+        perror(filename);
+        exit(1);
+    }
+    out_mem(&output, text, len);
+    out_close(&output);
+}
+
+//read the whole file at arg:fd from its start into arg:text, then close it
+static void read_back(int fd, struct Source* text) {
+    if (lseek(fd, 0, SEEK_SET) != 0) {
+        perror("read_back");
+        exit(1);
+    }
+    read_source(fd, text);
+    close(fd);
+}
+
+//run compile_program on arg:src in a child process, with stdout and stderr sent to temporary files and the output to arg:path
+//the texts for stdout, for stderr and for the output, if arg:path is not NULL, are read back into arg:texts
+//return false if the child failed, then nothing is read back
+static bool compile_captured(const struct Source* src, char* path, struct Source texts[3]) {
+    FILE* files[2] = { tmpfile(), tmpfile() };
+    if (files[0] == NULL || files[1] == NULL) {
+        perror("compile_captured");
+        exit(1);
+    }
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        dup2(fileno(files[0]), STDOUT_FILENO);
+        dup2(fileno(files[1]), STDERR_FILENO);
+        compile_program(src, path);
+        fflush(stdout);
+        fflush(stderr);
+        _exit(0);
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+        ;
+    bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    for (int k = 0; k < 2; ++k) {
+        if (ok)
+            read_back(dup(fileno(files[k])), &texts[k]);
+        fclose(files[k]);
+    }
+    int fd = ok && path != NULL ? open(path, O_RDONLY) : -1;
+    if (fd >= 0)
+        read_back(fd, &texts[2]);
+    return ok;
+}
+
+//compile arg:src through the cache directory, an entry keeps what compile_program printed and wrote for the source
+//on a miss compile_program runs in a child with its outputs captured, which are stored and then replayed as on a hit
+//if the child fails, nothing is stored and compile_program runs again in the process, to fail as it does without the cache
+//return the exit status
+static int compile_cached(const struct Source* src, char* filename) {
+    struct Cache cache;
+    struct CacheEntry entry;
+    if (!cache_open(&cache, cache_dir, (long long)cache_size << 20)) {
+        perror(cache_dir);
+        exit(1);
+    }
+    /* without an output file the program is not assembled, so its entry has no output */
+    bool output = emit_ir || filename != NULL;
+    cache_key(&cache, emit_ir ? "-ir" : output ? "" : "-check", src->text, src->size);
+
+    struct Source texts[3] = { { NULL, 0, false }, { NULL, 0, false }, { NULL, 0, false } };
+    if (!cache_load(&cache, &entry)) {
+        char path[CACHE_PATH_SIZE];
+        snprintf(path, sizeof(path), "%s/.tmp-output-XXXXXX", cache_dir);   // removed by the cache if parser dies
+        int fd = output ? mkstemp(path) : -1;
+        if (output && fd < 0) {
+            perror(path);
+            exit(1);
+        }
+        if (fd >= 0)
+            close(fd);
+        bool ok = compile_captured(src, output ? path : NULL, texts);
+        if (output)
+            unlink(path);
+        if (!ok) {
+            cache_close(&cache);
+            compile_program(src, filename);
+            return 0;
+        }
+
+        entry.status = 0;
+        for (int k = 0; k < 3; ++k) {
+            entry.text[k] = texts[k].text;
+            entry.len[k] = texts[k].size;
+        }
+        cache_store(&cache, &entry);
+    }
+
+    fwrite(entry.text[0], 1, entry.len[0], stdout);
+    fflush(stdout);
+    fwrite(entry.text[1], 1, entry.len[1], stderr);
+    if (output)
+        write_text(filename, entry.text[2], entry.len[2]);
+
+    int status = entry.status;
+    cache_free(&entry);
+    for (int k = 0; k < 3; ++k)
+        free(texts[k].text);
+    cache_close(&cache);
+    return status;
+}
+
+//analyse, translate and write arg:vertex as soon as it is reduced, its tree is released by the parser then
+static void compile_extdef(NodeRef vertex, struct TreeMark mark) {
+    (void)mark;
+    ExtDef(vertex);
+    translate_stream(vertex);
+    if (code_num() > 0) {
+        if (emit_ir)
+            export_code(&ir_output);
+        else if (assembling)
+            assemble_code();
+    }
+    clear_code();
+    reset_attrs();
+}
+
+//compile the program one ExtDef at a time, so only the tree and code of one function are kept
+static void compile_stream(char* filename) {
+    if (emit_ir) {
+        if (!out_open(&ir_output, filename)) {
+            perror(filename);
+            exit(1);
+        }
+    }
+    else if (filename != NULL) {
+        assemble_begin(filename);
+        assembling = true;
+    }
+
+    init();
+    translate_init();
+    extdef_hook = compile_extdef;
+    if (yyparse() != 0)
+        panic("Invalid program, can not be semantic parsed! May be existing syntax or lexical errors");
+    extdef_hook = NULL;
+    final_check();
+    syntax_tree = NULL_NODE;
+    clear_attrs();
+    clear_tree();
+
+    if (emit_ir)
+        out_close(&ir_output);
+    else if (assembling)
+        assemble_end();
+    assembling = false;
+}
 
 // main function for flex
 int main(int argc, char** argv) {
-    if (argc > 1) {
-        if (!(yyin = fopen(argv[1], "r"))) {
-            perror(argv[1]);
+    char* files[argc];                  // source, assembly or ir output, or the output and units with -link
+    memset(files, 0, sizeof(files));
+    if (!parse_options(argc, argv, files)) {
+        fprintf(stderr, "usage: %s [-fast-lex] [-ir] [-stream] [-pipeline] [-parallel-parse] [-j threads] [-server socket] [-cache dir [-cache-size MiB] [-cache-stats]] [-incremental] [-unit] [-stats trace] [source|- [output]]\n", argv[0]);
+        fprintf(stderr, "       %s -link output unit...\n", argv[0]);
+        return 1;
+    }
+    if (server_path != NULL)
+        return serve(server_path) ? 0 : 1;
+    if (link_mode) {
+        int unit_num = 0;
+        while (files[unit_num + 1] != NULL)
+            ++unit_num;
+        return link_units(files[0], files + 1, unit_num) ? 0 : 1;
+    }
+    if (cache_stats && cache_dir == NULL) {
+        fprintf(stderr, "option -cache-stats needs -cache\n");
+        return 1;
+    }
+    if (cache_stats) {
+        if (cache_print_stats(cache_dir))
+            return 0;
+        perror(cache_dir);
+        return 1;
+    }
+
+    int input = STDIN_FILENO;
+    if (files[0] != NULL && strcmp(files[0], "-") != 0) {
+        if ((input = open(files[0], O_RDONLY)) < 0) {
+            perror(files[0]);
             return 1;
         }
     }
-    /* start token analysis */
+    struct Source source;
+    load_source(input, &source);    // a mapping stays valid after its file is closed
+    if (input != STDIN_FILENO)
+        close(input);
+
+    stats_enabled = stats_path != NULL;
+    /* start token analysis, chunks are scanned by threads of their own, which the flex scanner does not support */
+    if (parallel_parse)
+        fast_scan = true;
+    /* a unit declares the functions defined by other units, the link step checks them */
+    if (unit_mode) {
+        unit_imports = true;
+        stream_mode = pipeline_mode = false;
+    }
     yylineno = 1;
-    yyrestart(yyin);
-    yyparse();
-    semantic_parse(syntax_tree);
-    translate_semantic(syntax_tree);
-    if (argc > 2)
-        assemble(argv[2]);
-    return 0;
+    init_tree();
+    if (fast_scan)
+        scan_buffer(source.text, source.size);
+    else
+        yy_scan_buffer(source.text, source.size + 2);
+    int status = 0;
+    if (cache_dir != NULL)                  // -stream and -pipeline do not change what is cached
+        status = compile_cached(&source, files[1]);
+    else if (pipeline_mode)
+        compile_pipeline(files[1], emit_ir);
+    else if (stream_mode)
+        compile_stream(files[1]);
+    else
+        compile_program(&source, files[1]);
+    release_source(&source);
+    if (stats_enabled && !stats_report(stats_path)) {
+        perror(stats_path);
+        return 1;
+    }
+
+    arena_release(&type_arena);
+    clear_intern();
+    return status;
 }
\ No newline at end of file
@@ -0,0 +1,288 @@
+#include "sparse.h"
+
+/* storage of the syntax tree */
+
+__thread struct Node* ast_nodes = NULL; //node pool addressed by NodeRef, slot 0 is the null node, or the tree entered by the thread
+__thread NodeRef* ast_childs = NULL; //child slots, children of one node are contiguous
+
+static __thread uint32_t node_num = 0, node_cap = 0; //each thread builds its own pools
+static __thread uint32_t child_num = 0, child_cap = 0;
+static __thread NodeRef* list_items = NULL; //items of the open lists, a list nested in another one is closed first
+static __thread uint32_t item_num = 0, item_cap = 0;
+
+static const char* node_names[NK_NUM] = { //names of node kinds, indexed by enum NodeKind
+    [NK_INT] = "INT", [NK_FLOAT] = "FLOAT", [NK_ID] = "ID", [NK_SEMI] = "SEMI", [NK_COMMA] = "COMMA",
+    [NK_ASSIGNOP] = "ASSIGNOP", [NK_RELOP] = "RELOP", [NK_PLUS] = "PLUS", [NK_MINUS] = "MINUS",
+    [NK_STAR] = "STAR", [NK_DIV] = "DIV", [NK_AND] = "AND", [NK_OR] = "OR", [NK_DOT] = "DOT",
+    [NK_NOT] = "NOT", [NK_TYPE] = "TYPE", [NK_LP] = "LP", [NK_RP] = "RP", [NK_LB] = "LB", [NK_RB] = "RB",
+    [NK_LC] = "LC", [NK_RC] = "RC", [NK_STRUCT] = "STRUCT", [NK_RETURN] = "RETURN", [NK_IF] = "IF",
+    [NK_ELSE] = "ELSE", [NK_WHILE] = "WHILE",
+    [NK_Program] = "Program", [NK_ExtDefList] = "ExtDefList", [NK_ExtDef] = "ExtDef",
+    [NK_ExtDecList] = "ExtDecList", [NK_Specifier] = "Specifier", [NK_StructSpecifier] = "StructSpecifier",
+    [NK_OptTag] = "OptTag", [NK_Tag] = "Tag", [NK_VarDec] = "VarDec", [NK_FunDec] = "FunDec",
+    [NK_VarList] = "VarList", [NK_ParamDec] = "ParamDec", [NK_CompSt] = "CompSt", [NK_StmtList] = "StmtList",
+    [NK_Stmt] = "Stmt", [NK_DefList] = "DefList", [NK_Def] = "Def", [NK_DecList] = "DecList",
+    [NK_Dec] = "Dec", [NK_Exp] = "Exp", [NK_Args] = "Args"
+};
+
+static const char* token_texts[NK_Program] = { //text of inline tokens, TYPE and RELOP are indexed by sub kind
+    [NK_SEMI] = ";", [NK_COMMA] = ",", [NK_ASSIGNOP] = "=", [NK_PLUS] = "+", [NK_MINUS] = "-",
+    [NK_STAR] = "*", [NK_DIV] = "/", [NK_AND] = "&&", [NK_OR] = "||", [NK_DOT] = ".", [NK_NOT] = "!",
+    [NK_LP] = "(", [NK_RP] = ")", [NK_LB] = "[", [NK_RB] = "]", [NK_LC] = "{", [NK_RC] = "}",
+    [NK_STRUCT] = "struct", [NK_RETURN] = "return", [NK_IF] = "if", [NK_ELSE] = "else", [NK_WHILE] = "while"
+};
+static const char* type_texts[] = { "int", "float" };
+static const char* relop_texts[] = { "==", "!=", ">", "<", ">=", "<=" };
+
+//reset the tree to hold no node
+void init_tree() {
+    node_num = 1;               // slot 0 is the null node
+    child_num = 0;
+    item_num = 0;
+    if (node_cap == 0) {
+        node_cap = 1024;
+        STAT_ADD(COUNT_BYTES, node_cap * sizeof(struct Node));
+        ast_nodes = malloc(node_cap * sizeof(struct Node));
+        if (ast_nodes == NULL)
+            panic("Out of memory");
+    }
+    memset(&ast_nodes[NULL_NODE], 0, sizeof(struct Node));
+    ast_nodes[NULL_NODE].kind = NK_NUM;
+}
+
+//free the whole tree, every NodeRef becomes invalid
+void clear_tree() {
+    free(ast_nodes);
+    free(ast_childs);
+    free(list_items);
+    ast_nodes = NULL;
+    ast_childs = NULL;
+    list_items = NULL;
+    node_num = node_cap = 0;
+    child_num = child_cap = 0;
+    item_num = item_cap = 0;
+}
+
+static void reserve_childs(uint32_t number) {
+    if (child_cap - child_num < number) {
+        uint32_t old_cap = child_cap;
+        while (child_cap - child_num < number)
+            child_cap = child_cap ? child_cap * 2 : 4096;
+        STAT_ADD(COUNT_BYTES, (child_cap - old_cap) * sizeof(NodeRef));
+        ast_childs = realloc(ast_childs, child_cap * sizeof(NodeRef));
+        if (ast_childs == NULL)
+            panic("Out of memory");
+    }
+}
+
+//return the current sizes of the pools, for release_tree
+struct TreeMark mark_tree() {
+    struct TreeMark res = { node_num, child_num };
+    return res;
+}
+
+//drop the nodes created after arg:mark, which must not be referred any more
+//the pools keep their capacity, so the peak size is bound by the largest part released at a time
+void release_tree(struct TreeMark mark) {
+    node_num = mark.node_num;
+    child_num = mark.child_num;
+}
+
+//copy the nodes created after arg:mark, which hold the subtree arg:root, into arg:tree
+//references are rebased onto the copy, whose slot 0 is the null node again
+void copy_tree(struct TreeMark mark, NodeRef root, struct Tree* tree) {
+    uint32_t number = node_num - mark.node_num;
+    uint32_t childs = child_num - mark.child_num;
+
+    tree->nodes = malloc((number + 1) * sizeof(struct Node));
+    tree->childs = malloc((childs ? childs : 1) * sizeof(NodeRef));
+    if (tree->nodes == NULL || tree->childs == NULL)
+        panic("Out of memory");
+
+    tree->nodes[NULL_NODE] = ast_nodes[NULL_NODE];
+    memcpy(&tree->nodes[1], &ast_nodes[mark.node_num], number * sizeof(struct Node));
+    for (uint32_t i = 1; i <= number; ++i) {
+        if (tree->nodes[i].kind >= NK_Program)  // tokens keep the intern id of their text
+            tree->nodes[i].first -= mark.child_num;
+    }
+    for (uint32_t i = 0; i < childs; ++i) {
+        NodeRef child = ast_childs[mark.child_num + i];
+        if (!(child & INLINE_BIT) && child != NULL_NODE) {
+            DIAG_ASSERT(child >= mark.node_num);
+            child = child - mark.node_num + 1;
+        }
+        tree->childs[i] = child;
+    }
+    tree->root = root - mark.node_num + 1;
+    tree->node_num = number + 1;
+    tree->child_num = childs;
+}
+
+//move the whole pools of the calling thread into arg:tree, leaving the thread without a tree as clear_tree
+void take_tree(NodeRef root, struct Tree* tree) {
+    tree->nodes = ast_nodes;
+    tree->childs = ast_childs;
+    tree->root = root;
+    tree->node_num = node_num;
+    tree->child_num = child_num;
+
+    free(list_items);
+    ast_nodes = NULL;
+    ast_childs = NULL;
+    list_items = NULL;
+    node_num = node_cap = 0;
+    child_num = child_cap = 0;
+    item_num = item_cap = 0;
+}
+
+//append the nodes of arg:tree to the initialized pools, references are rebased onto them
+//return the root of arg:tree in the pools
+NodeRef graft_tree(const struct Tree* tree) {
+    uint32_t number = tree->node_num - 1;
+    uint32_t node_base = node_num - 1, child_base = child_num;
+
+    if (node_cap - node_num < number) {
+        uint32_t old_cap = node_cap;
+        while (node_cap - node_num < number)
+            node_cap *= 2;
+        STAT_ADD(COUNT_BYTES, (node_cap - old_cap) * sizeof(struct Node));
+        if (node_cap > INLINE_BIT / 2)
+            panic("Too many nodes");
+        ast_nodes = realloc(ast_nodes, node_cap * sizeof(struct Node));
+        if (ast_nodes == NULL)
+            panic("Out of memory");
+    }
+    reserve_childs(tree->child_num);
+
+    memcpy(&ast_nodes[node_num], &tree->nodes[1], number * sizeof(struct Node));
+    for (uint32_t i = node_num; i < node_num + number; ++i) {
+        if (ast_nodes[i].kind >= NK_Program)    // tokens keep the intern id of their text
+            ast_nodes[i].first += child_base;
+    }
+    for (uint32_t i = 0; i < tree->child_num; ++i) {
+        NodeRef child = tree->childs[i];
+        if (!(child & INLINE_BIT) && child != NULL_NODE)
+            child += node_base;
+        ast_childs[child_base + i] = child;
+    }
+    node_num += number;
+    child_num += tree->child_num;
+    return tree->root + node_base;
+}
+
+//walk arg:tree by the node accessors of the calling thread, instead of the pools
+void enter_tree(const struct Tree* tree) {
+    ast_nodes = tree->nodes;
+    ast_childs = tree->childs;
+}
+
+void free_tree(struct Tree* tree) {
+    free(tree->nodes);
+    free(tree->childs);
+    tree->nodes = NULL;
+    tree->childs = NULL;
+}
+
+static NodeRef alloc_node(enum NodeKind kind, int lineno) {
+    if (kind < 0 || kind >= NK_NUM)
+        panic("Invalid Kind\n");
+    if (node_num == node_cap) {
+        if (node_cap >= INLINE_BIT / 2)
+            panic("Too many nodes");
+        STAT_ADD(COUNT_BYTES, node_cap * sizeof(struct Node));
+        node_cap *= 2;
+        ast_nodes = realloc(ast_nodes, node_cap * sizeof(struct Node));
+        if (ast_nodes == NULL)
+            panic("Out of memory");
+    }
+
+    struct Node* res = &ast_nodes[node_num];
+    memset(res, 0, sizeof(struct Node));
+    res->kind = kind;
+    res->lineno = lineno;
+    return node_num++;
+}
+
+//create a lexical unit, tokens without text of their own are encoded inline, the others are interned
+NodeRef create_token(enum NodeKind kind, int lineno, int sub, const char* text, int len) {
+    bool has_text = kind == NK_ID || kind == NK_INT || kind == NK_FLOAT;
+    if (!has_text && lineno <= INLINE_MAX_LINE)
+        return INLINE_BIT | (NodeRef)kind << INLINE_KIND_SHIFT | (NodeRef)sub << INLINE_SUB_SHIFT | lineno;
+
+    NodeRef res = alloc_node(kind, lineno);
+    ast_nodes[res].sub = sub;
+    ast_nodes[res].first = intern_id(text, len);
+    return res;
+}
+
+//create a grammatical unit with arg:number children following
+NodeRef create_node(enum NodeKind kind, int lineno, int number, ...) {
+    NodeRef res = alloc_node(kind, lineno);
+    reserve_childs(number);
+
+    ast_nodes[res].first = child_num;
+    ast_nodes[res].count = number;
+    va_list ap;
+    va_start(ap,number); // start behind number
+    for(int i = 0; i < number; i++){
+        ast_childs[child_num++] = va_arg(ap, NodeRef);
+    }
+    va_end(ap);
+
+    return res;
+}
+
+//create a grammatical unit of arg:kind without children, which are appended by list_append
+NodeRef open_list(enum NodeKind kind, int lineno) {
+    NodeRef res = alloc_node(kind, lineno);
+    ast_nodes[res].first = item_num;    // items of the list are kept from here until it is closed
+    return res;
+}
+
+//append arg:item to the children of the open list arg:list
+void list_append(NodeRef list, NodeRef item) {
+    if (item_num == item_cap) {
+        STAT_ADD(COUNT_BYTES, (item_cap ? item_cap : 1024) * sizeof(NodeRef));
+        item_cap = item_cap ? item_cap * 2 : 1024;
+        list_items = realloc(list_items, item_cap * sizeof(NodeRef));
+        if (list_items == NULL)
+            panic("Out of memory");
+    }
+    if (item_num == ast_nodes[list].first)  // a list starts where its first item does
+        ast_nodes[list].lineno = node_line(item);
+    list_items[item_num++] = item;
+}
+
+//move the items of the open list arg:list into contiguous child slots, nothing is appended to it later
+void close_list(NodeRef list) {
+    uint32_t mark = ast_nodes[list].first;
+    uint32_t number = item_num - mark;
+
+    reserve_childs(number);
+    memcpy(&ast_childs[child_num], &list_items[mark], number * sizeof(NodeRef));
+    ast_nodes[list].first = child_num;
+    ast_nodes[list].count = number;
+    child_num += number;
+    item_num = mark;
+}
+
+//return the interned text of token arg:vertex
+char* node_text(NodeRef vertex) {
+    enum NodeKind kind = node_kind(vertex);
+
+    if (kind == NK_ID || kind == NK_INT || kind == NK_FLOAT)
+        return intern_at(ast_nodes[vertex].first);
+    else if (kind == NK_TYPE)
+        return intern_str(type_texts[node_sub(vertex)]);
+    else if (kind == NK_RELOP)
+        return intern_str(relop_texts[node_sub(vertex)]);
+    else if (kind < NK_Program && token_texts[kind] != NULL)
+        return intern_str(token_texts[kind]);
+    else
+        return intern_str("");
+}
+
+//return the name of node kind arg:kind, as written in syntax.y
+const char* node_name(enum NodeKind kind) {
+    return node_names[kind];
+}
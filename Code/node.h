@@ -0,0 +1,166 @@
+#ifndef NODE_H
+#define NODE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* syntax tree node definitions, shared by lexical.l, syntax.y and the tree walkers */
+
+#define NULL_NODE 0                     //reference to no node, slot 0 of the node pool is never used
+#define INLINE_BIT 0x80000000u          //set in references of tokens encoded inline, which need no storage
+#define INLINE_KIND_SHIFT 26
+#define INLINE_SUB_SHIFT 23
+#define INLINE_MAX_LINE 0x7fffff        //tokens on later lines are stored in the pool
+
+typedef uint32_t NodeRef;               //index into the node pool, or an inline token
+
+enum NodeKind { // kinds of syntax tree nodes, named after the tokens and non-terminals in syntax.y
+    /* tokens */
+    NK_INT,
+    NK_FLOAT,
+    NK_ID,
+    NK_SEMI,
+    NK_COMMA,
+    NK_ASSIGNOP,
+    NK_RELOP,
+    NK_PLUS,
+    NK_MINUS,
+    NK_STAR,
+    NK_DIV,
+    NK_AND,
+    NK_OR,
+    NK_DOT,
+    NK_NOT,
+    NK_TYPE,
+    NK_LP,
+    NK_RP,
+    NK_LB,
+    NK_RB,
+    NK_LC,
+    NK_RC,
+    NK_STRUCT,
+    NK_RETURN,
+    NK_IF,
+    NK_ELSE,
+    NK_WHILE,
+    /* non-terminals */
+    NK_Program,
+    NK_ExtDefList,
+    NK_ExtDef,
+    NK_ExtDecList,
+    NK_Specifier,
+    NK_StructSpecifier,
+    NK_OptTag,
+    NK_Tag,
+    NK_VarDec,
+    NK_FunDec,
+    NK_VarList,
+    NK_ParamDec,
+    NK_CompSt,
+    NK_StmtList,
+    NK_Stmt,
+    NK_DefList,
+    NK_Def,
+    NK_DecList,
+    NK_Dec,
+    NK_Exp,
+    NK_Args,
+    NK_NUM                              //number of node kinds, not a kind itself
+};
+
+enum RELOP_TYPE { // Definitions of relational operators, sub kind of RELOP and operator of OT_RELOP
+    RT_EQ,
+    RT_NE,
+    RT_GT,
+    RT_LT,
+    RT_GE,
+    RT_LE
+};
+
+enum BASIC_KIND { // Definitions of basic types, sub kind of TYPE
+    BK_INT,
+    BK_FLOAT
+};
+
+struct Node {
+    uint8_t kind;                       //enum NodeKind of the node
+    uint8_t sub;                        //[RELOP]:RELOP_TYPE, [TYPE]:BASIC_KIND, others:undefined
+    uint32_t lineno;                    //line number
+    uint32_t first;                     //[Lexical Unit]:intern id of text, [Grammatical Unit]:index of first child slot, or of first item of an open list
+    uint32_t count;                     //[Lexical Unit]:0, [Grammatical Unit]:number of child nodes
+    uint32_t attr;                      //[Exp/VarDec]:index of semantic attributes, 0 if not analysed yet
+};
+
+struct TreeMark {                       //sizes of the pools at some point, the nodes created later can be released at once
+    uint32_t node_num;
+    uint32_t child_num;
+};
+
+struct Tree {                           //subtree copied or moved out of the pools, which another thread can walk by enter_tree or graft_tree
+    struct Node* nodes;
+    NodeRef* childs;
+    NodeRef root;
+    uint32_t node_num;                  //slots of nodes, with the null node
+    uint32_t child_num;                 //slots of childs
+};
+
+extern __thread struct Node* ast_nodes;
+extern __thread NodeRef* ast_childs;
+
+/* function declarations */
+
+void init_tree();
+void clear_tree();
+struct TreeMark mark_tree();
+void release_tree(struct TreeMark mark);
+void copy_tree(struct TreeMark mark, NodeRef root, struct Tree* tree);
+void take_tree(NodeRef root, struct Tree* tree);
+NodeRef graft_tree(const struct Tree* tree);
+void enter_tree(const struct Tree* tree);
+void free_tree(struct Tree* tree);
+NodeRef create_token(enum NodeKind kind, int lineno, int sub, const char* text, int len);
+NodeRef create_node(enum NodeKind kind, int lineno, int number, ...);
+NodeRef open_list(enum NodeKind kind, int lineno);
+void list_append(NodeRef list, NodeRef item);
+void close_list(NodeRef list);
+char* node_text(NodeRef vertex);
+const char* node_name(enum NodeKind kind);
+
+/* node accessors */
+
+//return true if arg:vertex is a lexical unit
+static inline bool node_is_token(NodeRef vertex) {
+    return (vertex & INLINE_BIT) || ast_nodes[vertex].kind < NK_Program;
+}
+
+static inline enum NodeKind node_kind(NodeRef vertex) {
+    if (vertex & INLINE_BIT)
+        return (vertex >> INLINE_KIND_SHIFT) & 0x1f;
+    return ast_nodes[vertex].kind;
+}
+
+static inline int node_sub(NodeRef vertex) {
+    if (vertex & INLINE_BIT)
+        return (vertex >> INLINE_SUB_SHIFT) & 0x7;
+    return ast_nodes[vertex].sub;
+}
+
+static inline int node_line(NodeRef vertex) {
+    if (vertex & INLINE_BIT)
+        return vertex & INLINE_MAX_LINE;
+    return ast_nodes[vertex].lineno;
+}
+
+static inline int node_childs(NodeRef vertex) {
+    return (vertex & INLINE_BIT) ? 0 : ast_nodes[vertex].count;
+}
+
+//return the child at arg:pos of arg:vertex, or NULL_NODE if there is no such child
+static inline NodeRef node_child(NodeRef vertex, int pos) {
+    if (vertex & INLINE_BIT)
+        return NULL_NODE;
+    const struct Node* node = &ast_nodes[vertex];
+    return (uint32_t)pos < node->count ? ast_childs[node->first + pos] : NULL_NODE;
+}
+
+#endif
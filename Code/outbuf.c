@@ -0,0 +1,107 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "outbuf.h"
+
+/* Operations on buffered outputs */
+
+//open arg:filename for writing through arg:out, NULL or "-" denotes stdout
+//return false if the file cannot be opened, errno tells why
+bool out_open(struct OutBuf* out, const char* filename) {
+    if (filename == NULL || strcmp(filename, "-") == 0)
+        out->fd = STDOUT_FILENO;
+    else if ((out->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+        return false;
+
+    out->len = 0;
+    out->cap = OUTBUF_SIZE;
+    out->data = malloc(out->cap);
+    if (out->data == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return true;
+}
+
+//open arg:out as an output kept in memory, its text is left in data until it is closed
+void out_open_mem(struct OutBuf* out) {
+    out->fd = -1;
+    out->len = out->cap = 0;
+    out->data = NULL;
+}
+
+//flush and close arg:out, stdout is left open
+void out_close(struct OutBuf* out) {
+    if (out->fd >= 0)
+        out_flush(out);
+    if (out->fd >= 0 && out->fd != STDOUT_FILENO)
+        close(out->fd);
+    free(out->data);
+    out->data = NULL;
+    out->fd = -1;
+}
+
+//write all arg:len bytes from arg:src to file arg:fd
+static void write_all(int fd, const char* src, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, src, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("write");
+            exit(1);
+        }
+        src += n;
+        len -= n;
+    }
+}
+
+//write the buffered bytes of arg:out to its file
+void out_flush(struct OutBuf* out) {
+    if (out->fd == STDOUT_FILENO)
+        fflush(stdout);                 // keep the order of messages printed by stdio before
+    write_all(out->fd, out->data, out->len);
+    out->len = 0;
+}
+
+//write arg:len bytes from arg:src to arg:out
+void out_mem(struct OutBuf* out, const char* src, size_t len) {
+    if (out->cap - out->len < len) {
+        if (out->fd < 0) {
+            while (out->cap - out->len < len)
+                out->cap = out->cap ? out->cap * 2 : OUTBUF_MEM_SIZE;
+            out->data = realloc(out->data, out->cap);
+            if (out->data == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                exit(1);
+            }
+        }
+        else {
+            out_flush(out);
+            if (len >= out->cap) {      // too long to be buffered
+                write_all(out->fd, src, len);
+                return;
+            }
+        }
+    }
+    memcpy(out->data + out->len, src, len);
+    out->len += len;
+}
+
+//write arg:value in decimal to arg:out, as "%d" of printf
+void out_int(struct OutBuf* out, int value) {
+    char buf[16];
+    char* ptr = buf + sizeof(buf);
+    unsigned int mag = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+
+    do {
+        *--ptr = '0' + mag % 10;
+        mag /= 10;
+    } while (mag != 0);
+    if (value < 0)
+        *--ptr = '-';
+    out_mem(out, ptr, buf + sizeof(buf) - ptr);
+}
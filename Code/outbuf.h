@@ -0,0 +1,37 @@
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define OUTBUF_SIZE (64 * 1024)
+#define OUTBUF_MEM_SIZE 4096            //initial size of an output kept in memory
+
+struct OutBuf { // Definition of buffered output files, which are written by one write() per flush
+    int fd;                             //file descriptor of the output, -1 for an output kept in memory
+    size_t len;                         //bytes waiting in data
+    size_t cap;                         //size of data, an output in memory grows it instead of flushing
+    char* data;
+};
+
+bool out_open(struct OutBuf* out, const char* filename);
+void out_open_mem(struct OutBuf* out);
+void out_close(struct OutBuf* out);
+void out_flush(struct OutBuf* out);
+void out_mem(struct OutBuf* out, const char* src, size_t len);
+void out_int(struct OutBuf* out, int value);
+
+//write NUL-terminated arg:str to arg:out
+static inline void out_str(struct OutBuf* out, const char* str) {
+    out_mem(out, str, strlen(str));
+}
+
+static inline void out_char(struct OutBuf* out, char c) {
+    if (out->len == out->cap)
+        out_mem(out, &c, 1);
+    else
+        out->data[out->len++] = c;
+}
+
+#endif
@@ -0,0 +1,236 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <time.h>
+#include "sparse.h"
+#include "assemble.h"
+#include "ircode.h"
+#include "arena.h"
+#include "ring.h"
+#include "pipeline.h"
+
+extern __thread void (*extdef_hook)(NodeRef vertex, struct TreeMark mark);
+extern int yyparse();
+
+/* Definitions of the compilation pipeline */
+
+struct Unit { // Definition of the work of one ExtDef, passed from stage to stage
+    struct Tree tree;                   //[parse -> check]:copy of the ExtDef subtree
+    struct CodeList* code;              //[check -> backend]:ir code of the ExtDef
+    struct AsmContext text;             //[backend -> writer]:ir or assemble text of the ExtDef in text.out
+};
+
+struct Stage { // Definition of the threads of the pipeline, each takes units from input and passes them to output
+    const char* name;
+    struct Unit* (*work)(struct Unit* unit); //handle arg:unit, return NULL if nothing is left to pass on
+    void (*begin)();                    //set up the thread-local state of the stage on its thread, NULL if there is none
+    void (*end)();                      //finish the thread-local state after the last unit, NULL if there is none
+    struct Ring* input;                 //NULL for the parse stage, which is driven by the parser
+    struct Ring* output;                //NULL for the last stage
+    pthread_t thread;
+    int units;                          //number of units handled
+    double wait;                        //seconds spent on an empty input or a full output
+    double elapsed;                     //seconds from the start to the end of the stage
+};
+
+enum { STAGE_PARSE, STAGE_CHECK, STAGE_BACKEND, STAGE_WRITE, STAGE_NUM };
+
+static bool pipeline_ir = false;        //the backend exports the ir code instead of assembling it
+static bool assembling = false;         //the program is assembled to output_name
+static char* output_name = NULL;
+static bool parse_failed = false;       //set before the parse stage ends, the check stage skips final_check then
+static struct OutBuf ir_output;         //output of the ir code
+static struct Ring rings[STAGE_NUM - 1]; //rings[i] links stage i to stage i + 1
+static struct Stage stages[STAGE_NUM];
+
+static double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+//pass arg:unit to the next stage of arg:stage, waiting while it is busy
+static void pass_unit(struct Stage* stage, struct Unit* unit) {
+    double begin = now();
+    ring_push(stage->output, unit);
+    stage->wait += now() - begin;
+}
+
+/* Stages */
+
+//parse stage: copy each ExtDef out of the pools before the parser releases it
+static void parse_extdef(NodeRef vertex, struct TreeMark mark) {
+    struct Unit* unit = calloc(1, sizeof(struct Unit));
+    if (unit == NULL)
+        panic("Out of memory");
+    copy_tree(mark, vertex, &unit->tree);
+    stages[STAGE_PARSE].units++;
+    pass_unit(&stages[STAGE_PARSE], unit);
+}
+
+//check stage begins with no symbols, the symbol table and ir code list are kept by its thread
+static void begin_check() {
+    init();
+    translate_init();
+}
+
+//check stage ends by checking the functions which are declared but not defined
+static void end_check() {
+    if (!parse_failed)
+        final_check();
+    clear_attrs();
+    arena_release(&type_arena);
+}
+
+//check stage: analyse and translate the ExtDef, which needs the symbols of the ExtDefs before it
+static struct Unit* check_unit(struct Unit* unit) {
+    enter_tree(&unit->tree);
+    ExtDef(unit->tree.root);
+    translate_stream(unit->tree.root);
+    reset_attrs();
+    free_tree(&unit->tree);
+
+    unit->code = take_code();
+    if (unit->code->length == 0) {
+        free_code(unit->code);
+        free(unit);
+        return NULL;
+    }
+    return unit;
+}
+
+//backend stage: write the ir code of the ExtDef, or assemble it, into memory
+static struct Unit* backend_unit(struct Unit* unit) {
+    if (pipeline_ir) {
+        out_open_mem(&unit->text.out);
+        export_range(&unit->text.out, code_range(unit->code));
+    }
+    else if (assembling) {
+        unit->text.code = code_range(unit->code);
+        assemble_func(&unit->text);
+    }
+    free_code(unit->code);
+    unit->code = NULL;
+    return unit;
+}
+
+//write stage owns the assemble output, which is kept by its thread
+static void begin_write() {
+    if (assembling)
+        assemble_begin(output_name);
+}
+
+static void end_write() {
+    if (assembling)
+        assemble_end();
+}
+
+//write stage: append the text of the ExtDef to the output in source order
+static struct Unit* write_unit(struct Unit* unit) {
+    if (pipeline_ir) {
+        out_mem(&ir_output, unit->text.out.data, unit->text.out.len);
+        out_close(&unit->text.out);
+    }
+    else if (assembling)
+        assemble_append(&unit->text);
+    free(unit);
+    return NULL;
+}
+
+//thread of the stages after parse, a NULL unit ends the program
+static void* run_stage(void* arg) {
+    struct Stage* stage = arg;
+    double start = now();
+
+    if (stage->begin != NULL)
+        stage->begin();
+    for (;;) {
+        double begin = now();
+        struct Unit* unit = ring_pop(stage->input);
+        stage->wait += now() - begin;
+        if (unit == NULL)
+            break;
+
+        stage->units++;
+        unit = stage->work(unit);
+        if (unit != NULL)
+            pass_unit(stage, unit);
+    }
+    if (stage->output != NULL)
+        pass_unit(stage, NULL);
+    if (stage->end != NULL)
+        stage->end();
+
+    stage->elapsed = now() - start;
+    return NULL;
+}
+
+//print the units, busy time and utilization of each stage to stderr
+static void report_stages() {
+    fprintf(stderr, "%-8s %8s %10s %6s\n", "stage", "units", "busy(ms)", "util");
+    for (int i = 0; i < STAGE_NUM; ++i) {
+        double busy = stages[i].elapsed - stages[i].wait;
+        if (busy < 0)
+            busy = 0;
+        fprintf(stderr, "%-8s %8d %10.1f %5.1f%%\n", stages[i].name, stages[i].units, busy * 1e3,
+            stages[i].elapsed > 0 ? busy * 100 / stages[i].elapsed : 0.0);
+    }
+}
+
+/* Interfaces */
+
+//compile the program with the parser, checker, backend and writer on their own threads
+//each ExtDef flows through bounded rings between them, so a slow stage holds back the ones before it
+void compile_pipeline(char* filename, bool emit_ir) {
+    pipeline_ir = emit_ir;
+    if (emit_ir) {
+        if (!out_open(&ir_output, filename)) {
+            perror(filename);
+            exit(1);
+        }
+    }
+    else if (filename != NULL) {
+        output_name = filename;
+        assembling = true;
+    }
+    parse_failed = false;
+
+    static const struct { const char* name; struct Unit* (*work)(struct Unit*); void (*begin)(); void (*end)(); } stage_defs[STAGE_NUM] = {
+        { .name = "parse" },
+        { .name = "check", .work = check_unit, .begin = begin_check, .end = end_check },
+        { .name = "backend", .work = backend_unit },
+        { .name = "write", .work = write_unit, .begin = begin_write, .end = end_write }
+    };
+    for (int i = 0; i < STAGE_NUM; ++i) {
+        stages[i] = (struct Stage){ .name = stage_defs[i].name, .work = stage_defs[i].work, .begin = stage_defs[i].begin, .end = stage_defs[i].end };
+        stages[i].input = i > 0 ? &rings[i - 1] : NULL;
+        stages[i].output = i < STAGE_NUM - 1 ? &rings[i] : NULL;
+        if (i < STAGE_NUM - 1)
+            ring_init(&rings[i]);
+    }
+
+    for (int i = STAGE_CHECK; i < STAGE_NUM; ++i) {
+        if (pthread_create(&stages[i].thread, NULL, run_stage, &stages[i]) != 0) {
+            perror("compile_pipeline");
+            exit(1);
+        }
+    }
+
+    double start = now();
+    extdef_hook = parse_extdef;
+    int result = yyparse();
+    extdef_hook = NULL;
+    parse_failed = result != 0;
+    pass_unit(&stages[STAGE_PARSE], NULL);
+    stages[STAGE_PARSE].elapsed = now() - start;
+
+    for (int i = STAGE_CHECK; i < STAGE_NUM; ++i)
+        pthread_join(stages[i].thread, NULL);
+    if (result != 0)
+        panic("Invalid program, can not be semantic parsed! May be existing syntax or lexical errors");
+    clear_tree();
+
+    if (emit_ir)
+        out_close(&ir_output);
+    assembling = false;
+    report_stages();
+}
@@ -0,0 +1,8 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdbool.h>
+
+void compile_pipeline(char* filename, bool emit_ir);
+
+#endif
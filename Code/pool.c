@@ -0,0 +1,161 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "pool.h"
+#include "stats.h"
+#include "diag.h"
+#include "intern.h"
+
+__thread int pool_jobs = 0; //number of threads of the passes run on the pool by the thread, 0 for one per online processor
+
+/* Definitions of the work-stealing pool */
+
+struct PoolDeque { // Definition of the indexes waiting in one worker, the owner takes the front and thieves the back
+    uint64_t range;                     //front index in the high half, back index (exclusive) in the low half
+    char pad[56];                       //keep deques of different workers on different cache lines
+};
+
+struct PoolWorker { // Definition of the threads of one pool_run
+    int id;                             //index of its deque
+    int threads;                        //number of workers
+    struct PoolDeque* deques;
+    PoolJob job;
+    void* arg;
+    pthread_t thread;
+    bool started;                       //thread is running, the calling thread of pool_run is not
+    bool recover;                       //the calling thread recovers from internal failures, so the workers catch theirs
+    bool* failed;                       //set by the first worker failing, the others take no more indexes
+    char failure[DIAG_FAILURE_SIZE];    //message of the failure of this worker
+    struct InternPool* names;           //intern pool of the calling thread, the jobs intern their names into it
+};
+
+//take an index from the front of arg:deque if arg:front is true, otherwise from its back
+//return false if the deque is empty
+static bool take_index(struct PoolDeque* deque, bool front, int* index) {
+    uint64_t old = __atomic_load_n(&deque->range, __ATOMIC_ACQUIRE);
+    for (;;) {
+        uint32_t head = old >> 32, tail = (uint32_t)old;
+        if (head >= tail)
+            return false;
+
+        uint64_t range = front ? (uint64_t)(head + 1) << 32 | tail : (uint64_t)head << 32 | (tail - 1);
+        if (__atomic_compare_exchange_n(&deque->range, &old, range, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            *index = front ? head : tail - 1;
+            return true;
+        }
+    }
+}
+
+//run the indexes of its own deque, then steal from the others until every deque is empty
+static void run_jobs(struct PoolWorker* worker) {
+    int index;
+
+    while (!__atomic_load_n(worker->failed, __ATOMIC_RELAXED) && take_index(&worker->deques[worker->id], true, &index))
+        worker->job(index, worker->arg);
+
+    bool found = true;
+    while (found) {                     // no index is added later, so a pass finding nothing ends the work
+        found = false;
+        for (int i = 1; i < worker->threads; ++i) {
+            struct PoolDeque* victim = &worker->deques[(worker->id + i) % worker->threads];
+            while (!__atomic_load_n(worker->failed, __ATOMIC_RELAXED) && take_index(victim, false, &index)) {
+                worker->job(index, worker->arg);
+                found = true;
+            }
+        }
+    }
+}
+
+//run the jobs of arg:arg, a failure of one is kept in the worker for pool_run, which reports it after every worker ended
+static void* work(void* arg) {
+    struct PoolWorker* worker = arg;
+    jmp_buf recover;
+    jmp_buf* outer = diag_recover;
+
+    intern_pool = worker->names;
+    if (!worker->recover)
+        run_jobs(worker);
+    else if (setjmp(recover) == 0) {
+        diag_recover = &recover;
+        run_jobs(worker);
+    }
+    else {
+        memcpy(worker->failure, diag_failure, DIAG_FAILURE_SIZE);
+        __atomic_store_n(worker->failed, true, __ATOMIC_RELAXED);
+    }
+    diag_recover = outer;
+    stats_flush();                      // the counters of the thread are lost when it ends
+    return NULL;
+}
+
+/* Interfaces */
+
+//return the default number of threads, one for each online processor
+int pool_threads() {
+    long res = sysconf(_SC_NPROCESSORS_ONLN);
+    if (res < 1)
+        return 1;
+    return res < POOL_MAX_THREADS ? (int)res : POOL_MAX_THREADS;
+}
+
+//run arg:job for each index below arg:number on arg:threads threads, 0 for pool_threads()
+//the calling thread works as one of them, and returns when every job is done
+void pool_run(int threads, int number, PoolJob job, void* arg) {
+    if (threads <= 0)
+        threads = pool_threads();
+    if (threads > POOL_MAX_THREADS)
+        threads = POOL_MAX_THREADS;
+    if (threads > number)
+        threads = number;
+    if (threads <= 1) {
+        for (int i = 0; i < number; ++i)
+            job(i, arg);
+        return;
+    }
+
+    struct PoolDeque* deques = NULL;
+    bool failed = false;
+    struct PoolWorker* workers = malloc(threads * sizeof(struct PoolWorker));
+    if (posix_memalign((void**)&deques, sizeof(struct PoolDeque), threads * sizeof(struct PoolDeque)) != 0
+        || workers == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    //each worker starts on a contiguous slice of the indexes
+    for (int i = 0; i < threads; ++i) {
+        uint64_t head = (uint64_t)number * i / threads, tail = (uint64_t)number * (i + 1) / threads;
+        deques[i].range = head << 32 | tail;
+        workers[i] = (struct PoolWorker){ .id = i, .threads = threads, .deques = deques, .job = job, .arg = arg };
+        workers[i].recover = diag_recover != NULL;
+        workers[i].failed = &failed;
+        workers[i].names = intern_pool;
+    }
+
+    //a worker which cannot be started leaves its deque to be stolen
+    for (int i = 1; i < threads; ++i)
+        workers[i].started = pthread_create(&workers[i].thread, NULL, work, &workers[i]) == 0;
+    work(&workers[0]);
+    for (int i = 1; i < threads; ++i) {
+        if (workers[i].started)
+            pthread_join(workers[i].thread, NULL);
+    }
+
+    //a job failed, the calling thread fails in its place once no worker runs
+    for (int i = 0; i < threads && failed; ++i) {
+        if (workers[i].failure[0] != '\0') {
+            char failure[DIAG_FAILURE_SIZE];
+            memcpy(failure, workers[i].failure, DIAG_FAILURE_SIZE);
+            free(workers);
+            free(deques);
+            diag_fail("%s", failure);
+        }
+    }
+    free(workers);
+    free(deques);
+}
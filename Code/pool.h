@@ -0,0 +1,13 @@
+#ifndef POOL_H
+#define POOL_H
+
+#define POOL_MAX_THREADS 64
+
+extern __thread int pool_jobs;
+
+typedef void (*PoolJob)(int index, void* arg); // Definition of jobs run by the pool, once for each index
+
+int pool_threads();
+void pool_run(int threads, int number, PoolJob job, void* arg);
+
+#endif
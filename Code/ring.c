@@ -0,0 +1,49 @@
+#define _POSIX_C_SOURCE 200809L
+#include <sched.h>
+#include <time.h>
+#include "ring.h"
+
+/* Definitions of the single-producer single-consumer ring */
+
+#define RING_SPINS 64                   //polls before a waiting thread yields its processor
+#define RING_YIELDS 16                  //yields before a waiting thread sleeps between polls
+
+//back off after arg:round polls of a ring which was not ready
+static void ring_wait(int round) {
+    if (round < RING_SPINS)
+        return;
+    if (round < RING_SPINS + RING_YIELDS) {
+        sched_yield();
+        return;
+    }
+    struct timespec nap = { 0, 50000 };
+    nanosleep(&nap, NULL);
+}
+
+/* Interfaces */
+
+void ring_init(struct Ring* ring) {
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+//put arg:item at the tail of arg:ring, wait while the ring is full
+void ring_push(struct Ring* ring, void* item) {
+    size_t tail = ring->tail;
+    for (int round = 0; tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == RING_SIZE; ++round)
+        ring_wait(round);
+
+    ring->slots[tail & (RING_SIZE - 1)] = item;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+//take the item at the head of arg:ring, wait while the ring is empty
+void* ring_pop(struct Ring* ring) {
+    size_t head = ring->head;
+    for (int round = 0; __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == head; ++round)
+        ring_wait(round);
+
+    void* item = ring->slots[head & (RING_SIZE - 1)];
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return item;
+}
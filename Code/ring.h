@@ -0,0 +1,20 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stddef.h>
+
+#define RING_SIZE 64                    //slots of a ring, a power of 2
+
+struct Ring { // Definition of bounded queues between one producer thread and one consumer thread
+    size_t head;                        //number of items taken, written by the consumer only
+    char pad_head[56];                  //keep the indexes of the two threads on different cache lines
+    size_t tail;                        //number of items put, written by the producer only
+    char pad_tail[56];
+    void* slots[RING_SIZE];
+};
+
+void ring_init(struct Ring* ring);
+void ring_push(struct Ring* ring, void* item);
+void* ring_pop(struct Ring* ring);
+
+#endif
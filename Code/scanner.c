@@ -0,0 +1,439 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include "node.h"
+#include "syntax.tab.h"
+#include "outbuf.h"
+#include "scanner.h"
+#include "diag.h"
+
+/* vector primitives, the widest instruction set enabled by the compiler is used */
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VEC_WIDTH 32
+#define VEC_ALL 0xffffffffu
+typedef __m256i Vec;
+#define vec_load(p) _mm256_loadu_si256((const __m256i*)(p))
+#define vec_or(v, c) _mm256_or_si256((v), _mm256_set1_epi8(c))
+#define vec_sub(v, c) _mm256_sub_epi8((v), _mm256_set1_epi8(c))
+#define vec_eq(v, c) ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8((v), _mm256_set1_epi8(c))))
+#define vec_le(v, c) ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8((v), _mm256_set1_epi8(c)), (v))))
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define VEC_WIDTH 16
+#define VEC_ALL 0xffffu
+typedef __m128i Vec;
+#define vec_load(p) _mm_loadu_si128((const __m128i*)(p))
+#define vec_or(v, c) _mm_or_si128((v), _mm_set1_epi8(c))
+#define vec_sub(v, c) _mm_sub_epi8((v), _mm_set1_epi8(c))
+#define vec_eq(v, c) ((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8((v), _mm_set1_epi8(c))))
+#define vec_le(v, c) ((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8((v), _mm_set1_epi8(c)), (v))))
+#endif
+
+#ifdef VEC_WIDTH
+//mask of the bytes of arg:v between arg:lo and arg:hi, compared as unsigned bytes
+#define vec_in(v, lo, hi) vec_le(vec_sub((v), (lo)), (char)((hi) - (lo)))
+#endif
+
+/* global variant definitions */
+
+__thread bool fast_scan = false;        //set by the thread scanning a buffer, which flex cannot do on several threads
+
+/* the state is kept by each thread, so chunks of the source are scanned in parallel */
+
+static __thread const char* cur = NULL; //next byte to scan
+static __thread const char* end = NULL; //end of the source or chunk, no token is matched across it
+static __thread const char* line_start = NULL; //start of the line for columns, lexical.l only resets them at the "\n" rule
+static __thread int lineno = 1;         //line of cur, yylineno of lexical.l
+static __thread struct OutBuf* scan_log = NULL; //output of the messages of the scanner, stdout if it is NULL
+
+static inline bool is_letter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/* scanning loops, whole vectors are scanned while they fit before the end */
+
+//skip blanks and newlines from arg:p, counting lines
+static const char* skip_blank(const char* p) {
+#ifdef VEC_WIDTH
+    while (end - p >= VEC_WIDTH) {
+        Vec v = vec_load(p);
+        uint32_t nl = vec_eq(v, '\n');
+        uint32_t stop = ~(vec_eq(v, ' ') | vec_eq(v, '\t') | vec_eq(v, '\r') | nl) & VEC_ALL;
+
+        if (stop != 0)
+            nl &= (1u << __builtin_ctz(stop)) - 1;     // newlines before the first non blank only
+        if (nl != 0) {
+            lineno += __builtin_popcount(nl);
+            line_start = p + 32 - __builtin_clz(nl);   // behind the last newline
+        }
+        if (stop != 0)
+            return p + __builtin_ctz(stop);
+        p += VEC_WIDTH;
+    }
+#endif
+    for (; p < end; ++p) {
+        if (*p == '\n') {
+            ++lineno;
+            line_start = p + 1;
+        }
+        else if (*p != ' ' && *p != '\t' && *p != '\r')
+            break;
+    }
+    return p;
+}
+
+//return the end of the identifier whose rest starts at arg:p
+static const char* ident_end(const char* p) {
+#ifdef VEC_WIDTH
+    while (end - p >= VEC_WIDTH) {
+        Vec v = vec_load(p);
+        uint32_t stop = ~(vec_in(vec_or(v, 0x20), 'a', 'z') | vec_in(v, '0', '9') | vec_eq(v, '_')) & VEC_ALL;
+
+        if (stop != 0)
+            return p + __builtin_ctz(stop);
+        p += VEC_WIDTH;
+    }
+#endif
+    while (p < end && (is_letter(*p) || is_digit(*p)))
+        ++p;
+    return p;
+}
+
+//return the first '*' or '"' from arg:p, or the end
+static const char* find_star_quote(const char* p) {
+#ifdef VEC_WIDTH
+    while (end - p >= VEC_WIDTH) {
+        Vec v = vec_load(p);
+        uint32_t stop = vec_eq(v, '*') | vec_eq(v, '"');
+
+        if (stop != 0)
+            return p + __builtin_ctz(stop);
+        p += VEC_WIDTH;
+    }
+#endif
+    while (p < end && *p != '*' && *p != '"')
+        ++p;
+    return p;
+}
+
+//count the newlines from arg:p to arg:q
+static int count_lines(const char* p, const char* q) {
+    int res = 0;
+#ifdef VEC_WIDTH
+    for (; q - p >= VEC_WIDTH; p += VEC_WIDTH)
+        res += __builtin_popcount(vec_eq(vec_load(p), '\n'));
+#endif
+    for (; p < q; ++p)
+        res += *p == '\n';
+    return res;
+}
+
+//return the first of '{', '}', ';', '/' and '"' from arg:p, or the end
+static const char* find_special(const char* p) {
+#ifdef VEC_WIDTH
+    while (end - p >= VEC_WIDTH) {
+        Vec v = vec_load(p);
+        uint32_t stop = vec_eq(v, '{') | vec_eq(v, '}') | vec_eq(v, ';') | vec_eq(v, '/') | vec_eq(v, '"');
+
+        if (stop != 0)
+            return p + __builtin_ctz(stop);
+        p += VEC_WIDTH;
+    }
+#endif
+    while (p < end && *p != '{' && *p != '}' && *p != ';' && *p != '/' && *p != '"')
+        ++p;
+    return p;
+}
+
+//print a message as printf, or keep it in scan_log
+static void report(const char* format, ...) {
+    va_list ap;
+    va_start(ap, format);
+    if (scan_log == NULL)
+        vprintf(format, ap);
+    else {
+        char text[256];
+        va_list again;
+        va_copy(again, ap);
+        int len = vsnprintf(text, sizeof(text), format, ap);
+        if (len >= (int)sizeof(text)) {
+            char* buf = malloc(len + 1);
+            if (buf == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                exit(1);
+            }
+            vsnprintf(buf, len + 1, format, again);
+            out_mem(scan_log, buf, len);
+            free(buf);
+        }
+        else if (len > 0)
+            out_mem(scan_log, text, len);
+        va_end(again);
+    }
+    va_end(ap);
+}
+
+/* rules of lexical.l */
+
+//set the location of the matched text as YY_USER_ACTION, and continue scanning behind it
+static void match(const char* p, int len) {
+    yylloc.first_line = yylloc.last_line = lineno;
+    yylloc.first_column = p - line_start + 1;
+    yylloc.last_column = yylloc.first_column + len - 1;
+    cur = p + len;
+}
+
+static int token(int tok, enum NodeKind kind, int sub, const char* p, int len) {
+    match(p, len);
+    yylval = create_token(kind, lineno, sub, p, len);
+    return tok;
+}
+
+//return the length of {bcomment} at arg:p, 0 if it does not match
+//the body is made of bytes other than '*' and '"', and '*' followed by a byte other than '/' and '"'
+static int block_comment(const char* p) {
+    const char* q = p + 2;
+    for (;;) {
+        q = find_star_quote(q);
+        if (q >= end || *q == '"' || ++q >= end || *q == '"')
+            return 0;
+        if (*q == '/')
+            return q + 1 - p;
+        ++q;                            // the byte after '*' belongs to the body
+    }
+}
+
+//return the length of {str} at arg:p, which ends at the last '"' of the line, 0 if it does not match
+static int string_len(const char* p) {
+    const char* q = memchr(p + 1, '\n', end - p - 1);
+    if (q == NULL)
+        q = end;
+    while (--q > p && *q != '"');
+    return q > p ? q - p + 1 : 0;
+}
+
+static int number(const char* p) {
+    const char* q = p + 1;
+    if (*p != '0') {
+        while (q < end && is_digit(*q))
+            ++q;
+    }
+    if (end - q >= 2 && *q == '.' && is_digit(q[1])) {
+        for (q += 2; q < end && is_digit(*q); ++q);
+        return token(FLOAT, NK_FLOAT, 0, p, q - p);
+    }
+    return token(INT, NK_INT, 0, p, q - p);
+}
+
+static int word(const char* p) {
+    int len = ident_end(p + 1) - p;
+    switch (len) {
+        case 2:
+            if (memcmp(p, "if", 2) == 0) return token(IF, NK_IF, 0, p, len);
+            break;
+        case 3:
+            if (memcmp(p, "int", 3) == 0) return token(TYPE, NK_TYPE, BK_INT, p, len);
+            break;
+        case 4:
+            if (memcmp(p, "else", 4) == 0) return token(ELSE, NK_ELSE, 0, p, len);
+            break;
+        case 5:
+            if (memcmp(p, "float", 5) == 0) return token(TYPE, NK_TYPE, BK_FLOAT, p, len);
+            if (memcmp(p, "while", 5) == 0) return token(WHILE, NK_WHILE, 0, p, len);
+            break;
+        case 6:
+            if (memcmp(p, "struct", 6) == 0) return token(STRUCT, NK_STRUCT, 0, p, len);
+            if (memcmp(p, "return", 6) == 0) return token(RETURN, NK_RETURN, 0, p, len);
+            break;
+    }
+    return token(ID, NK_ID, 0, p, len);
+}
+
+/* interfaces */
+
+//scan arg:size bytes from arg:base, which must be followed by two NULs
+void scan_buffer(const char* base, size_t size) {
+    scan_chunk(base, size, 1, NULL);
+}
+
+//scan arg:size bytes from arg:base, which start at line arg:line, in the calling thread, which yylex scans by fast_yylex then
+//messages are kept in arg:log if it is not NULL
+void scan_chunk(const char* base, size_t size, int line, struct OutBuf* log) {
+    fast_scan = true;
+    cur = line_start = base;
+    end = base + size;
+    lineno = line;
+    scan_log = log;
+}
+
+//return the last byte before arg:p which is not blank, or NUL if there is none
+static char last_visible(const char* base, const char* p) {
+    while (p > base && (p[-1] == ' ' || p[-1] == '\t' || p[-1] == '\r' || p[-1] == '\n'))
+        --p;
+    return p > base ? p[-1] : '\0';
+}
+
+//cut arg:size bytes from arg:base into chunks of ExtDefs, each of at least arg:target bytes but the last
+//an ExtDef ends at ';' or at the '}' closing a function body outside any braces, comments and strings are skipped as fast_yylex does
+//return the chunks in source order, their number is stored in arg:number, the scanner of the thread is reset
+struct SourceChunk* split_source(const char* base, size_t size, size_t target, int* number) {
+    int num = 0, cap = 16, depth = 0;
+    bool body = false;                  // the outermost braces are a function body
+    const char* begin = base;
+    int line = 1;
+    struct SourceChunk* res = malloc(cap * sizeof(struct SourceChunk));
+    if (res == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    scan_buffer(base, size);
+    for (const char* p = find_special(base); p < end; p = find_special(p)) {
+        const char* cut = NULL;
+        int len;
+        switch (*p) {
+            case '/':
+                if (p[1] == '/' && (cut = memchr(p, '\n', end - p)) != NULL) {
+                    p = cut;
+                    continue;
+                }
+                if (p[1] == '*' && (len = block_comment(p)) > 0) {
+                    p += len;
+                    continue;
+                }
+                cut = NULL;
+                break;
+            case '"':
+                if ((len = string_len(p)) > 0) {
+                    p += len;
+                    continue;
+                }
+                break;
+            case '{':
+                if (depth++ == 0)
+                    body = last_visible(base, p) == ')';
+                break;
+            case '}':
+                if (depth == 0)         // unbalanced, leave the rest to the parser
+                    p = end - 1;
+                else if (--depth == 0 && body)
+                    cut = p + 1;
+                break;
+            case ';':
+                if (depth == 0)
+                    cut = p + 1;
+                break;
+        }
+        ++p;
+
+        if (cut != NULL && (size_t)(cut - begin) >= target && cut < end) {
+            if (num == cap) {
+                res = realloc(res, (cap *= 2) * sizeof(struct SourceChunk));
+                if (res == NULL) {
+                    fprintf(stderr, "Out of memory\n");
+                    exit(1);
+                }
+            }
+            res[num++] = (struct SourceChunk){ begin, cut - begin, line };
+            line += count_lines(begin, cut);
+            begin = cut;
+        }
+    }
+    if (num == cap)
+        res = realloc(res, (cap + 1) * sizeof(struct SourceChunk));
+    if (res == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    res[num++] = (struct SourceChunk){ begin, end - begin, line };
+
+    *number = num;
+    return res;
+}
+
+//return the next token as yylex of lexical.l
+int fast_yylex(void) {
+    for (;;) {
+        const char* p = skip_blank(cur);
+        int len;
+
+        if (p >= end) {
+            cur = end;
+            return 0;
+        }
+        switch (*p) {
+            case ';': return token(SEMI, NK_SEMI, 0, p, 1);
+            case ',': return token(COMMA, NK_COMMA, 0, p, 1);
+            case '=':
+                if (p[1] == '=') return token(RELOP, NK_RELOP, RT_EQ, p, 2);
+                return token(ASSIGNOP, NK_ASSIGNOP, 0, p, 1);
+            case '>':
+                if (p[1] == '=') return token(RELOP, NK_RELOP, RT_GE, p, 2);
+                return token(RELOP, NK_RELOP, RT_GT, p, 1);
+            case '<':
+                if (p[1] == '=') return token(RELOP, NK_RELOP, RT_LE, p, 2);
+                return token(RELOP, NK_RELOP, RT_LT, p, 1);
+            case '!':
+                if (p[1] == '=') return token(RELOP, NK_RELOP, RT_NE, p, 2);
+                return token(NOT, NK_NOT, 0, p, 1);
+            case '+': return token(PLUS, NK_PLUS, 0, p, 1);
+            case '-': return token(MINUS, NK_MINUS, 0, p, 1);
+            case '*': return token(STAR, NK_STAR, 0, p, 1);
+            case '/':
+                if (p[1] == '/') {      // {lcomment} needs the newline for its '$'
+                    const char* q = memchr(p, '\n', end - p);
+                    if (q != NULL) {
+                        match(p, q - p);
+                        continue;
+                    }
+                }
+                else if (p[1] == '*' && (len = block_comment(p)) > 0) {
+                    lineno += count_lines(p, p + len);
+                    match(p, len);
+                    continue;
+                }
+                return token(DIV, NK_DIV, 0, p, 1);
+            case '&':
+                if (p[1] == '&') return token(AND, NK_AND, 0, p, 2);
+                break;
+            case '|':
+                if (p[1] == '|') return token(OR, NK_OR, 0, p, 2);
+                break;
+            case '.': return token(DOT, NK_DOT, 0, p, 1);
+            case '(': return token(LP, NK_LP, 0, p, 1);
+            case ')': return token(RP, NK_RP, 0, p, 1);
+            case '[': return token(LB, NK_LB, 0, p, 1);
+            case ']': return token(RB, NK_RB, 0, p, 1);
+            case '{': return token(LC, NK_LC, 0, p, 1);
+            case '}': return token(RC, NK_RC, 0, p, 1);
+            case '"':
+                if ((len = string_len(p)) > 0) {
+                    if (diag_log != NULL)
+                        diag_add(CMM_NOTE, 0, lineno, "this str %.*s", len, p);
+                    else
+                        report("this str %.*s \n", len, p);
+                    match(p, len);
+                    continue;
+                }
+                break;
+            default:
+                if (is_letter(*p)) return word(p);
+                if (is_digit(*p)) return number(p);
+                break;
+        }
+
+        if (diag_log != NULL)
+            diag_add(CMM_LEXICAL, 0, lineno, "Mysterious character \"%.1s\"", p);
+        else
+            report("Error type A at Line %d: Mysterious character \"%.1s\"\n", lineno, p);
+        match(p, 1);
+    }
+}
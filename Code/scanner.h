@@ -0,0 +1,24 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* hand-written scanner producing the same tokens as lexical.l, selected instead of flex by fast_scan */
+
+extern __thread bool fast_scan;         //set to scan with fast_yylex, yylex of lexical.l dispatches on it
+
+struct OutBuf;
+
+struct SourceChunk { // Definition of parts of the source made of whole ExtDefs, which are parsed separately
+    const char* begin;
+    size_t size;
+    int lineno;                         //line of the first byte
+};
+
+void scan_buffer(const char* base, size_t size);
+void scan_chunk(const char* base, size_t size, int line, struct OutBuf* log);
+struct SourceChunk* split_source(const char* base, size_t size, size_t target, int* number);
+int fast_yylex(void);
+
+#endif
@@ -0,0 +1,165 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "diag.h"
+#include "pool.h"
+#include "server.h"
+
+/* Definitions of the compile server */
+
+//set arg:options by the switches of a request, NUL-separated in arg:len bytes at arg:text
+//-ir and -j change the compile, the other served switches do not change the output, a request is always compiled whole by the library
+//return false after writing the first switch which is not served to arg:err
+static bool read_switches(const char* text, uint32_t len, struct CmmOptions* options, struct OutBuf* err) {
+    for (const char* s = text; s < text + len; s += strlen(s) + 1) {
+        enum SwitchId k = find_switch(s);
+        const char* argument = s + strlen(s) + 1;
+        if (k == SWITCH_NUM || !parser_switches[k].served || (parser_switches[k].argument && argument >= text + len)) {
+            out_str(err, "unknown option ");
+            out_str(err, s);
+            out_char(err, '\n');
+            return false;
+        }
+        if (k == SWITCH_IR)
+            options->emit_ir = options->skip_assembly = true;  // the reply carries the ir code alone
+        else if (k == SWITCH_J)
+            options->threads = atoi(argument);
+        if (parser_switches[k].argument)
+            s = argument;
+    }
+    return true;
+}
+
+//compile the request read from arg:fd and send the reply, return false if the connection is broken
+static bool serve_request(int fd) {
+    uint32_t switch_len = 0, size = 0;
+    char* switches = recv_frame(fd, &switch_len);
+    char* source = switches != NULL ? recv_frame(fd, &size) : NULL;
+    if (source == NULL) {
+        free(switches);
+        return false;
+    }
+
+    struct OutBuf out, err;
+    struct CmmOptions options = { false, 1, false };   // the threads of the server compile requests at once
+    struct CmmResult result = { NULL, 0, NULL, 0, NULL, 0 };
+    uint32_t status = 1;
+    out_open_mem(&out);
+    out_open_mem(&err);
+    if (read_switches(switches, switch_len, &options, &err)) {
+        if (cmm_compile(source, size, &options, &result))
+            status = 0;
+        diag_print(result.diags, result.diag_num, &out, &err);
+    }
+
+    const char* text = options.emit_ir ? result.ir : result.assembly;
+    size_t text_len = options.emit_ir ? result.ir_len : result.assembly_len;
+    bool sent = send_all(fd, &status, sizeof(status)) && send_frame(fd, out.data, out.len)
+        && send_frame(fd, err.data, err.len) && send_frame(fd, text, text_len);
+
+    cmm_free(&result);
+    out_close(&out);
+    out_close(&err);
+    free(switches);
+    free(source);
+    return sent;
+}
+
+//pool job serving the connections of the listening socket at arg:listener, until accept fails
+static void serve_job(int index, void* listener) {
+    (void)index;
+    int sock = *(int*)listener;
+    for (;;) {
+        int fd = accept(sock, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            perror("accept");
+            return;
+        }
+        serve_request(fd);
+        close(fd);
+    }
+}
+
+static volatile sig_atomic_t worker_pid = 0;   //process of the threads serving requests
+static volatile sig_atomic_t stopping = false;  //the server was told to stop, the worker is not started again
+
+//pass a signal stopping the server on to the worker
+static void stop_worker(int sig) {
+    stopping = true;
+    if (worker_pid > 0)
+        kill(worker_pid, sig);
+}
+
+//run the threads serving arg:sock in a worker process, which is started again whenever a request crashes it
+//the other requests in the worker lose their connections, and their clients run parser instead
+//return when the server is stopped by a signal, or the worker ends by itself because accept failed
+static void supervise(int sock, int threads) {
+    signal(SIGINT, stop_worker);
+    signal(SIGTERM, stop_worker);
+    signal(SIGHUP, stop_worker);
+    while (!stopping) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return;
+        }
+        if (pid == 0) {
+            signal(SIGINT, SIG_DFL);
+            signal(SIGTERM, SIG_DFL);
+            signal(SIGHUP, SIG_DFL);
+            pool_run(threads, threads, serve_job, &sock);
+            _exit(1);
+        }
+        worker_pid = pid;
+        if (stopping)                   // the signal came before the worker was known
+            kill(pid, SIGTERM);
+
+        int status;
+        while (waitpid(pid, &status, 0) < 0)
+            if (errno != EINTR)
+                return;
+        worker_pid = 0;
+        if (!WIFSIGNALED(status) || stopping)
+            return;
+        fprintf(stderr, "server: the worker was killed by signal %d, starting another one\n", WTERMSIG(status));
+    }
+}
+
+/* Interfaces */
+
+//serve the requests of client.c on the unix socket at arg:path, with pool_jobs threads
+//each thread keeps the pools and arenas of its compiles for the next one, in a worker process kept alive by supervise
+//return false if the socket cannot be served
+bool serve(const char* path) {
+    struct sockaddr_un addr;
+    struct stat st;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: socket path is too long\n", path);
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path);                   // left by a server before
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0 || bind(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(sock, SOMAXCONN) != 0) {
+        perror(path);
+        return false;
+    }
+    signal(SIGPIPE, SIG_IGN);           // a client which leaves early only loses its reply
+
+    int threads = pool_jobs > 0 ? pool_jobs : pool_threads();
+    supervise(sock, threads);
+    close(sock);
+    unlink(path);
+    return false;
+}
@@ -0,0 +1,108 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* protocol of the compile server, a connection carries one request and its reply */
+/* request: a frame of the switches of parser, each ended by NUL, and a frame of the source */
+/* reply: the exit status as 4 bytes, then frames of the text for stdout, for stderr and for the output file */
+/* a frame is its length as 4 bytes in host order, followed by the bytes */
+
+#define SERVER_SOCKET "/tmp/cmm.sock"   //socket of the server when CMM_SERVER is not set
+#define SERVER_MAX_FRAME (1u << 30)     //longer frames are refused
+
+enum SwitchId { // Definitions of the switches of parser, indexing parser_switches
+    SWITCH_FAST_LEX, SWITCH_IR, SWITCH_STREAM, SWITCH_PIPELINE, SWITCH_PARALLEL_PARSE, SWITCH_J, SWITCH_SERVER,
+    SWITCH_CACHE, SWITCH_CACHE_SIZE, SWITCH_CACHE_STATS, SWITCH_INCREMENTAL, SWITCH_UNIT, SWITCH_LINK, SWITCH_STATS,
+    SWITCH_NUM
+};
+
+struct Switch { // Definition of the command line of parser, shared by main.c, the server and client.c
+    const char* name;
+    bool argument;                      //followed by an argument
+    bool served;                        //implemented by a request, cmmc runs parser for the others
+};
+
+static const struct Switch parser_switches[SWITCH_NUM] = {
+    [SWITCH_FAST_LEX] = { "-fast-lex", false, true },
+    [SWITCH_IR] = { "-ir", false, true },
+    [SWITCH_STREAM] = { "-stream", false, true },
+    [SWITCH_PIPELINE] = { "-pipeline", false, true },
+    [SWITCH_PARALLEL_PARSE] = { "-parallel-parse", false, true },
+    [SWITCH_J] = { "-j", true, true },
+    [SWITCH_SERVER] = { "-server", true, false },
+    [SWITCH_CACHE] = { "-cache", true, false },
+    [SWITCH_CACHE_SIZE] = { "-cache-size", true, false },
+    [SWITCH_CACHE_STATS] = { "-cache-stats", false, false },
+    [SWITCH_INCREMENTAL] = { "-incremental", false, false },
+    [SWITCH_UNIT] = { "-unit", false, false },
+    [SWITCH_LINK] = { "-link", false, false },
+    [SWITCH_STATS] = { "-stats", true, false },
+};
+
+//return the id of the switch named arg:name, SWITCH_NUM if parser has none
+static inline enum SwitchId find_switch(const char* name) {
+    int k = 0;
+    while (k < SWITCH_NUM && strcmp(name, parser_switches[k].name) != 0)
+        ++k;
+    return (enum SwitchId)k;
+}
+
+bool serve(const char* path);
+
+/* framing, shared with client.c which is built alone */
+
+//write all arg:len bytes at arg:data to arg:fd, return false if the peer is gone
+static inline bool send_all(int fd, const void* data, size_t len) {
+    const char* p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+//read all arg:len bytes into arg:data from arg:fd, return false if it ends before
+static inline bool recv_all(int fd, void* data, size_t len) {
+    char* p = data;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static inline bool send_frame(int fd, const void* data, uint32_t len) {
+    return send_all(fd, &len, sizeof(len)) && send_all(fd, data, len);
+}
+
+//read a frame from arg:fd, its length is stored in arg:len
+//return the bytes followed by a NUL in a heap buffer, NULL if the frame is broken
+static inline char* recv_frame(int fd, uint32_t* len) {
+    if (!recv_all(fd, len, sizeof(*len)) || *len > SERVER_MAX_FRAME)
+        return NULL;
+    char* data = malloc(*len + 1);
+    if (data == NULL || !recv_all(fd, data, *len)) {
+        free(data);
+        return NULL;
+    }
+    data[*len] = '\0';
+    return data;
+}
+
+#endif
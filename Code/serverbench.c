@@ -0,0 +1,129 @@
+#ifdef CMM_SERVERBENCH
+/* benchmark of the compile server, built alone into serverbench by "make bench-server" */
+/* it starts ./parser -server on a socket of its own, then times each source compiled by running ./cmmc */
+/* against the same compile by running ./parser, both started by fork and exec as a build would start them */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define BENCH_ROUNDS 50                 //compiles of each source by each program
+#define BENCH_PARSER "./parser"
+#define BENCH_CLIENT "./cmmc"
+
+static double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+//start arg:argv with its output thrown away unless arg:quiet is false, return its pid
+static pid_t start(char** argv, bool quiet) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        if (quiet && null >= 0) {
+            dup2(null, STDOUT_FILENO);
+            dup2(null, STDERR_FILENO);
+        }
+        execv(argv[0], argv);
+        perror(argv[0]);
+        _exit(127);
+    }
+    return pid;
+}
+
+//run arg:program on arg:source, writing the assembly to /dev/null, return its exit status
+static int run(const char* program, const char* source) {
+    char* argv[] = { (char*)program, (char*)source, "/dev/null", NULL };
+    int status = 0;
+    pid_t pid = start(argv, true);
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+        ;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+//wait until the server listens on arg:path, return false if it does not within 5 seconds
+static bool wait_server(const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    for (int i = 0; i < 500; ++i) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool up = fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+        if (fd >= 0)
+            close(fd);
+        if (up)
+            return true;
+        nanosleep(&(struct timespec){ 0, 10000000 }, NULL);
+    }
+    return false;
+}
+
+//time BENCH_ROUNDS runs of arg:program on arg:source, storing the mean and the fastest in milliseconds
+static int time_program(const char* program, const char* source, double* mean, double* best) {
+    int status = 0;
+    double total = 0;
+    for (int round = 0; round < BENCH_ROUNDS; ++round) {
+        double begin = now();
+        status = run(program, source);
+        double seconds = now() - begin;
+        total += seconds;
+        if (round == 0 || seconds < *best)
+            *best = seconds;
+    }
+    *mean = total / BENCH_ROUNDS * 1e3;
+    *best *= 1e3;
+    return status;
+}
+
+int main(int argc, char** argv) {
+    char path[64];
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s source...\n", argv[0]);
+        return 1;
+    }
+    snprintf(path, sizeof(path), "/tmp/cmm-bench-%ld.sock", (long)getpid());
+    setenv("CMM_SERVER", path, 1);
+    setenv("CMM_PARSER", BENCH_PARSER, 1);
+
+    char* server[] = { BENCH_PARSER, "-server", path, NULL };
+    pid_t pid = start(server, false);
+    if (!wait_server(path)) {
+        fprintf(stderr, "%s: the server does not listen\n", path);
+        kill(pid, SIGTERM);
+        return 1;
+    }
+    for (int i = 1; i < argc; ++i)      // the threads of the server take their pools and arenas
+        run(BENCH_CLIENT, argv[i]);
+
+    printf("%-24s %7s %12s %12s %12s %12s %8s\n", "source", "status", "parser mean", "parser best", "cmmc mean", "cmmc best", "speedup");
+    for (int i = 1; i < argc; ++i) {
+        double parser_mean, parser_best, client_mean, client_best;
+        int status = time_program(BENCH_PARSER, argv[i], &parser_mean, &parser_best);
+        int client_status = time_program(BENCH_CLIENT, argv[i], &client_mean, &client_best);
+        const char* name = strrchr(argv[i], '/') != NULL ? strrchr(argv[i], '/') + 1 : argv[i];
+        printf("%-24s %3d/%-3d %9.3f ms %9.3f ms %9.3f ms %9.3f ms %7.2fx\n", name, status, client_status,
+            parser_mean, parser_best, client_mean, client_best, parser_mean / client_mean);
+    }
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    return 0;
+}
+#endif
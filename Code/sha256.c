@@ -0,0 +1,104 @@
+#include <string.h>
+#include "sha256.h"
+
+/* Definitions of SHA-256, as FIPS 180-4 */
+
+static const uint32_t round_keys[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+//mix the 64 bytes at arg:block into the state of arg:ctx
+static void sha256_block(struct Sha256* ctx, const uint8_t* block) {
+    uint32_t w[64], s[8];
+    for (int i = 0; i < 16; ++i)
+        w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16
+            | (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3];
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    memcpy(s, ctx->state, sizeof(s));
+    for (int i = 0; i < 64; ++i) {
+        uint32_t t1 = s[7] + (rotr(s[4], 6) ^ rotr(s[4], 11) ^ rotr(s[4], 25))
+            + ((s[4] & s[5]) ^ (~s[4] & s[6])) + round_keys[i] + w[i];
+        uint32_t t2 = (rotr(s[0], 2) ^ rotr(s[0], 13) ^ rotr(s[0], 22))
+            + ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+        memmove(s + 1, s, 7 * sizeof(uint32_t));
+        s[4] += t1;
+        s[0] = t1 + t2;
+    }
+    for (int i = 0; i < 8; ++i)
+        ctx->state[i] += s[i];
+}
+
+/* Interfaces */
+
+void sha256_init(struct Sha256* ctx) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->len = 0;
+}
+
+//feed arg:len bytes at arg:data to arg:ctx
+void sha256_update(struct Sha256* ctx, const void* data, size_t len) {
+    const uint8_t* p = data;
+    size_t fill = ctx->len % 64;
+    ctx->len += len;
+
+    if (fill > 0) {
+        size_t n = len < 64 - fill ? len : 64 - fill;
+        memcpy(ctx->block + fill, p, n);
+        p += n;
+        len -= n;
+        if (fill + n < 64)
+            return;
+        sha256_block(ctx, ctx->block);
+    }
+    for (; len >= 64; p += 64, len -= 64)
+        sha256_block(ctx, p);
+    memcpy(ctx->block, p, len);
+}
+
+//pad the bytes fed to arg:ctx and store their digest in arg:digest
+void sha256_final(struct Sha256* ctx, uint8_t digest[SHA256_SIZE]) {
+    static const uint8_t padding[64] = { 0x80 };
+    uint64_t bits = ctx->len * 8;
+    uint8_t tail[8];
+    for (int i = 0; i < 8; ++i)
+        tail[i] = (uint8_t)(bits >> (56 - 8 * i));
+
+    size_t fill = ctx->len % 64;
+    sha256_update(ctx, padding, fill < 56 ? 56 - fill : 120 - fill);
+    sha256_update(ctx, tail, 8);
+    for (int i = 0; i < 8; ++i) {
+        digest[4 * i] = (uint8_t)(ctx->state[i] >> 24);
+        digest[4 * i + 1] = (uint8_t)(ctx->state[i] >> 16);
+        digest[4 * i + 2] = (uint8_t)(ctx->state[i] >> 8);
+        digest[4 * i + 3] = (uint8_t)ctx->state[i];
+    }
+}
+
+//write arg:digest as lower-case hex digits ended by NUL to arg:hex
+void sha256_hex(const uint8_t digest[SHA256_SIZE], char hex[SHA256_SIZE * 2 + 1]) {
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < SHA256_SIZE; ++i) {
+        hex[2 * i] = digits[digest[i] >> 4];
+        hex[2 * i + 1] = digits[digest[i] & 15];
+    }
+    hex[SHA256_SIZE * 2] = '\0';
+}
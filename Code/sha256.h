@@ -0,0 +1,20 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_SIZE 32                  //bytes of a digest, twice as many hex digits
+
+struct Sha256 { // Definition of SHA-256 digests being computed, fed by sha256_update
+    uint32_t state[8];
+    uint64_t len;                       //bytes fed so far
+    uint8_t block[64];                  //bytes of the block which is not full yet
+};
+
+void sha256_init(struct Sha256* ctx);
+void sha256_update(struct Sha256* ctx, const void* data, size_t len);
+void sha256_final(struct Sha256* ctx, uint8_t digest[SHA256_SIZE]);
+void sha256_hex(const uint8_t digest[SHA256_SIZE], char hex[SHA256_SIZE * 2 + 1]);
+
+#endif
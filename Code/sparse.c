@@ -1,41 +1,147 @@
+#include <limits.h>
 #include "sparse.h"
+#include "pool.h"
+#include "diag.h"
+
+/* global variant definitions, the state of the analysis is kept by each thread */
+
+static __thread struct SymbolTableItem* symbol_table = NULL; //open addressing hash table with robin hood probing
+static __thread unsigned int table_cap = 0; //number of slots of symbol_table, a power of 2
+static __thread unsigned int table_num = 0; //number of symbols in symbol_table
+static __thread struct Symbol* newest_symbol = NULL; //symbol added to symbol_table last, the others are chained by Symbol.older
+static __thread struct Type** array_types = NULL; //open addressing table of array types, each pair of element type and size exists once
+static __thread unsigned int array_cap = 0, array_num = 0;
+
+struct Type INVALID_T = { INVALID }; //initialize the constant type INVALID_TYPE, compatible with no type
+struct Type INT_T = { BASIC, { INT }, 4, &INT_T }; //initialize the constant type struct of int
+struct Type FLOAT_T = { BASIC, { FLOAT }, 4, &FLOAT_T }; //initialize the constant type struct of float
+
+static __thread int struct_def_flag = 0; //set true when defining a struct type
+static __thread bool func_dec_flag = false; //set true when defining a function
+
+static __thread unsigned int anon_count = 0;
+
+__thread bool unit_imports = false; //functions declared without a definition are imported from other units by the link step
+
+static __thread struct NodeAttr* node_attrs = NULL; //semantic results indexed by Node.attr, slot 0 is unused
+static __thread uint32_t attr_num = 1, attr_cap = 0;
+static uint32_t alloc_attr(NodeRef vertex);
+static void set_attr(NodeRef vertex, struct ExpType exp, struct Symbol* symbol, int addr);
+extern __thread unsigned int var_count;
+
+#define UNCHECKED_ADDR -1 //addressing class of the attributes reserved for an Exp which is not checked yet
+
+struct CheckItem { // Definition of the check of an expression, deferred until every declaration is analysed
+    NodeRef vertex;                     //Dec with an initial value, or Stmt
+    struct Type* type;                  //[Stmt]:return type of the function, [Dec]:type of the variant
+    unsigned int visible;               //number of symbols in symbol_table when the check is deferred, the later ones are hidden from it
+};
+
+struct ErrorItem { // Definition of an error buffered to be printed in line order
+    int type;
+    int lineno;
+    unsigned int rank;                  //errors of the same line are printed in the order a sequential check finds them, by rank and then order
+    unsigned int order;                 //number of errors in the log before it
+    char* description;
+};
+
+struct ErrorLog {
+    struct ErrorItem* items;
+    unsigned int num, cap;
+};
+
+struct BodyCheck { // Definition of the checks of one function body, run by one pool job
+    unsigned int first, num;            //range of the checks in check_items
+    struct ErrorLog log;                //errors found by the checks
+};
+
+struct CheckJobs { // Definition of the state of the calling thread of semantic_parse, entered by the threads checking function bodies
+    struct BodyCheck* bodies;
+    struct CheckItem* items;
+    struct Tree tree;
+    struct SymbolTableItem* table;
+    unsigned int table_cap;
+    struct NodeAttr* attrs;
+};
+
+static __thread bool defer_checks = false; //set true while semantic_parse analyses the declarations, the checks of expressions are deferred then
+static __thread struct CheckItem* check_items = NULL; //checks deferred by all function bodies, in the order of a sequential check
+static __thread unsigned int item_num = 0, item_cap = 0;
+static __thread struct BodyCheck* body_checks = NULL;
+static __thread unsigned int body_num = 0, body_cap = 0;
+static __thread struct ErrorLog decl_log = { NULL, 0, 0 }; //errors found when analysing the declarations
+
+static __thread struct ErrorLog* error_log = NULL; //errors are buffered here if it is not NULL, otherwise printed at once
+static __thread unsigned int error_rank = 0; //rank of the errors found by the thread now
+static __thread unsigned int error_num = 0; //errors printed since init
+static __thread unsigned int visible_limit = UINT_MAX; //symbols added to symbol_table after this number of ones are not found by the thread
 
-/* global variant definitions */
+/* traverse functions */
 
-struct SymbolTableItem* symbol_table[TABLE_SIZE]; //a hash table
+static void check_job(int index, void* arg);
+static void flush_errors();
 
-struct Type INVALID_T = { INVALID }; //initialize the constant type INVALID_TYPE
-struct Type INT_T = { BASIC, INT }; //initialize the constant type struct of int
-struct Type FLOAT_T = { BASIC, FLOAT }; //initialize the constant type struct of float
+//analyse the declarations of arg:root in order, then check the function bodies in parallel with them fixed
+void semantic_parse(NodeRef root) {
+    init();
 
-int struct_def_flag = 0; //set true when defining a struct type
-bool func_dec_flag = false; //set true when defining a function
+    if (!CHECK_ID(root, NK_Program))
+        panic("Invalid program, can not be semantic parsed! May be existing syntax or lexical errors");
 
-unsigned int anon_count = 0;
-extern unsigned int var_count;
+    NodeRef list = node_child(root, 0);
+    defer_checks = true;
+    error_log = &decl_log;
+    error_rank = 0;
+    for (int i = 0; i < node_childs(list); ++i) {
+        if (body_num >= body_cap) {
+            body_cap = body_cap ? body_cap * 2 : 64;
+            body_checks = realloc(body_checks, body_cap * sizeof(struct BodyCheck));
+            if (body_checks == NULL)
+                panic("Out of memory");
+        }
+        struct BodyCheck* body = &body_checks[body_num];
+        body->first = item_num;
+        ExtDef(node_child(list, i));
+        body->num = item_num - body->first;
+        if (body->num > 0) {
+            body->log = (struct ErrorLog){ NULL, 0, 0 };
+            ++body_num;
+        }
+    }
+    defer_checks = false;
+    error_log = NULL;
 
-/* traverse functions */
+    struct CheckJobs jobs = { body_checks, check_items, { ast_nodes, ast_childs, root, 0, 0 }, symbol_table, table_cap, node_attrs };
+    pool_run(pool_jobs, body_num, check_job, &jobs);
+    flush_errors();
 
-void semantic_parse(struct Node* root) {
-    init();
-
-    if (CHECK_ID(root, "Program"))
-        visit(root);
-    else
-        panic("Invalid program, can not be semantic parsed! May be existing syntax or lexical errors");
+    free(check_items);
+    free(body_checks);
+    check_items = NULL;
+    body_checks = NULL;
+    item_num = item_cap = body_num = body_cap = 0;
 
     final_check();
 }
 
 void init() {
-    memset(symbol_table, 0, sizeof(struct SymbolTableItem *)*TABLE_SIZE);
+    symbol_table = NULL;                // the table lives in type_arena, so it is not freed here
+    table_cap = table_num = 0;
+    newest_symbol = NULL;
+    array_types = NULL;                 // so is the array type table
+    array_cap = array_num = 0;
+    anon_count = 0;
+    error_num = 0;
+    var_count = 1;
+    attr_num = 1;
+
     // add function read into symbolTable
-    struct Symbol *r = create_symbol("read",PROC,0);
+    struct Symbol *r = create_symbol(intern_str("read"),PROC,0);
     r->defined = true;
     r->proc_type.ret_type = INT_PTR;
 
     // add function write into symbolTable
-    struct Symbol *w = create_symbol("write",PROC,0);
+    struct Symbol *w = create_symbol(intern_str("write"),PROC,0);
     w->defined = true;
     w->proc_type.ret_type = INT_PTR;
     w->proc_type.argtype_list[0] = INT_PTR;
@@ -46,93 +152,231 @@ void final_check() {
     //display_symbol();
 
     //check function declarations
-    for (int i = 0; i < TABLE_SIZE; ++i) {
-        struct SymbolTableItem* ptr = symbol_table[i];
-        while (ptr != NULL) {
-            struct Symbol* id = ptr->id;
-            if (id->kind == PROC && !id->defined) {
-                errorinfo(18, id->first_lineno, "Undefined function");
-            }
-
-            ptr = ptr->next;
+    unsigned int pos = 0;
+    struct Symbol* id;
+    while ((id = next_symbol(&pos)) != NULL) {
+        if (id->kind == PROC && !id->defined && !unit_imports) {
+            errorinfo(18, id->first_lineno, "Undefined function");
         }
     }
 }
 
+//report an internal failure, see diag_fail
 void panic(char* msg) {
-    fprintf(stderr, "%s\n", msg);
-    assert(0);
+    diag_fail("%s", msg);
 }
 
 //use DFS to visit the node of syntax tree
-void visit(struct Node* vertex) {     
-    if (vertex == NULL)
+void visit(NodeRef vertex) {     
+    if (vertex == NULL_NODE)
         panic("Null Vertex Pointer");
                                                 
-    if (CHECK_ID(vertex, "ExtDef")) {       
+    if (CHECK_ID(vertex, NK_ExtDef)) {       
         ExtDef(vertex);
     }
-    else if (CHECK_ID(vertex, "DefList")) {
+    else if (CHECK_ID(vertex, NK_DefList)) {
         struct FieldList* var_dec_list = NULL;      
-        DefList(vertex, &var_dec_list);
+        DefList(vertex, &var_dec_list, NULL);
     }
-    else if (CHECK_ID(vertex, "Exp")) {      
+    else if (CHECK_ID(vertex, NK_Exp)) {      
         Exp(vertex);            
     }
     else {
         int ptr = 0;
-        while (ptr < MAX_CHILDS && vertex->childs[ptr] != NULL) {       
-            visit(vertex->childs[ptr]);
+        while (ptr < node_childs(vertex)) {       
+            visit(node_child(vertex, ptr));
             ++ptr;
         }
     }
 }
 
+//print an error, or keep it in diag_log for the library
+static void print_error(int type, int lineno, char* description) {
+    ++error_num;
+    if (diag_log != NULL)
+        diag_add(CMM_SEMANTIC, type, lineno, "%s", description);
+    else
+        printf("Error type %d at Line %d: %s\n", type, lineno, description);
+}
+
 void errorinfo(int type, int lineno, char* description) {
-    printf("Error type %d at Line %d: %s\n", type, lineno, description);
+    if (error_log == NULL) {
+        print_error(type, lineno, description);
+        return;
+    }
+
+    if (error_log->num >= error_log->cap) {
+        error_log->cap = error_log->cap ? error_log->cap * 2 : 16;
+        error_log->items = realloc(error_log->items, error_log->cap * sizeof(struct ErrorItem));
+        if (error_log->items == NULL)
+            panic("Out of memory");
+    }
+    error_log->items[error_log->num] = (struct ErrorItem){ type, lineno, error_rank, error_log->num, description };
+    ++error_log->num;
+}
+
+//get the number of errors printed by the last semantic parse
+unsigned int semantic_errors() {
+    return error_num;
+}
+
+/* checks of expressions */
+
+//assign attribute slots to the Exp nodes under arg:vertex, so checking them on another thread adds no slot
+static void reserve_attrs(NodeRef vertex) {
+    for (int i = 0; i < node_childs(vertex); ++i) {
+        NodeRef child = node_child(vertex, i);
+        if (CHECK_ID(child, NK_Exp) || CHECK_ID(child, NK_Args)) {
+            if (CHECK_ID(child, NK_Exp) && ast_nodes[child].attr == 0) {
+                uint32_t pos = alloc_attr(child);
+                node_attrs[pos] = (struct NodeAttr){ { NULL, false }, NULL, UNCHECKED_ADDR };
+            }
+            reserve_attrs(child);
+        }
+    }
+}
+
+//check the expressions of Dec or Stmt arg:item, the nested statements are not checked
+static void check_item(const struct CheckItem* item) {
+    NodeRef vertex = item->vertex;
+
+    if (CHECK_ID(vertex, NK_Dec)) {
+        if (!comp_type(item->type, Exp(node_child(vertex, 2)).type)) {
+            errorinfo(5, node_line(vertex), "Type of expression is unmatched to the type of variant!");
+        }
+    }
+    else if (CHECK_ID(node_child(vertex, 0), NK_RETURN)) {
+        if (!comp_type(item->type, Exp(node_child(vertex, 1)).type)) {
+            errorinfo(8, node_line(node_child(vertex, 0)), "Return type is unmatched to function definition");
+        }
+    }
+    else if (CHECK_ID(node_child(vertex, 2), NK_Exp)) { //common pattern of control flow stmts
+        if (!comp_type(Exp(node_child(vertex, 2)).type, INT_PTR)) {
+            errorinfo(7, node_line(node_child(vertex, 2)), "Use non integer expression as judgement condition");
+        }
+    }
+    else {
+        Exp(node_child(vertex, 0));
+    }
+}
+
+//check the expressions of arg:vertex now, or in the parallel phase of semantic_parse with the symbols visible now
+static void check_later(NodeRef vertex, struct Type* type) {
+    struct CheckItem item = { vertex, type, table_num };
+    if (!defer_checks || struct_def_flag) {
+        check_item(&item);
+        return;
+    }
+
+    if (item_num >= item_cap) {
+        item_cap = item_cap ? item_cap * 2 : 256;
+        check_items = realloc(check_items, item_cap * sizeof(struct CheckItem));
+        if (check_items == NULL)
+            panic("Out of memory");
+    }
+    reserve_attrs(vertex);
+    check_items[item_num++] = item;
+    error_rank = item_num * 2;  // later errors of the declarations follow the errors of the check
+}
+
+//pool job running the checks of function body arg:index in arg:jobs, with the symbols and attributes of the calling thread
+static void check_job(int index, void* arg) {
+    struct CheckJobs* jobs = arg;
+    struct BodyCheck* body = jobs->bodies + index;
+
+    enter_tree(&jobs->tree);
+    symbol_table = jobs->table;
+    table_cap = jobs->table_cap;
+    node_attrs = jobs->attrs;
+    check_items = jobs->items;
+    error_log = &body->log;
+    for (unsigned int i = body->first; i < body->first + body->num; ++i) {
+        visible_limit = check_items[i].visible;
+        error_rank = i * 2 + 1;
+        check_item(&check_items[i]);
+    }
+    visible_limit = UINT_MAX;
+    error_log = NULL;
+}
+
+//order of buffered errors, by line and then by the order a sequential check finds them
+static int error_cmp(const void* a, const void* b) {
+    const struct ErrorItem* l = a;
+    const struct ErrorItem* r = b;
+    if (l->lineno != r->lineno)
+        return l->lineno < r->lineno ? -1 : 1;
+    if (l->rank != r->rank)
+        return l->rank < r->rank ? -1 : 1;
+    return l->order < r->order ? -1 : (l->order > r->order);
+}
+
+//print the errors buffered by both phases of semantic_parse in line order, and free the logs
+static void flush_errors() {
+    struct ErrorLog* all = &decl_log;
+    for (unsigned int i = 0; i < body_num; ++i) {
+        struct ErrorLog* log = &body_checks[i].log;
+        if (all->num + log->num > all->cap) {
+            all->cap = all->num + log->num;
+            all->items = realloc(all->items, all->cap * sizeof(struct ErrorItem));
+            if (all->items == NULL)
+                panic("Out of memory");
+        }
+        if (log->num > 0)
+            memcpy(all->items + all->num, log->items, log->num * sizeof(struct ErrorItem));
+        all->num += log->num;
+        free(log->items);
+    }
+
+    if (all->num > 0)
+        qsort(all->items, all->num, sizeof(struct ErrorItem), error_cmp);
+    for (unsigned int i = 0; i < all->num; ++i)
+        print_error(all->items[i].type, all->items[i].lineno, all->items[i].description);
+
+    free(all->items);
+    *all = (struct ErrorLog){ NULL, 0, 0 };
 }
 
 /* semantic parse function */
 
-void ExtDef(struct Node* vertex) {
-    SAFE_ID(vertex,"ExtDef");
-    struct Type* type_inh = Specifier(vertex->childs[0]);
+void ExtDef(NodeRef vertex) {
+    SAFE_ID(vertex, NK_ExtDef);
+    struct Type* type_inh = Specifier(node_child(vertex, 0));
 
-    if (CHECK_ID(vertex->childs[1], "ExtDecList")) {
-        ExtDecList(vertex->childs[1], type_inh);
+    if (CHECK_ID(node_child(vertex, 1), NK_ExtDecList)) {
+        ExtDecList(node_child(vertex, 1), type_inh);
     }
-    else if (CHECK_ID(vertex->childs[1], "FunDec")) {
-        if (CHECK_ID(vertex->childs[2], "SEMI")) func_dec_flag = true;
-        struct Symbol* func = FunDec(vertex->childs[1], type_inh);
-        if (CHECK_ID(vertex->childs[2], "SEMI")) func_dec_flag = false;
+    else if (CHECK_ID(node_child(vertex, 1), NK_FunDec)) {
+        if (CHECK_ID(node_child(vertex, 2), NK_SEMI)) func_dec_flag = true;
+        struct Symbol* func = FunDec(node_child(vertex, 1), type_inh);
+        if (CHECK_ID(node_child(vertex, 2), NK_SEMI)) func_dec_flag = false;
 
-        if (CHECK_ID(vertex->childs[2], "CompSt") && func != NULL) { 
+        if (CHECK_ID(node_child(vertex, 2), NK_CompSt) && func != NULL) { 
             struct Symbol* former = search_symbol(func->id);
             if (former->defined == false) {
                 former->defined = true;
             }
             else
-                errorinfo(4, vertex->childs[1]->lineno, "Redefined function");
+                errorinfo(4, node_line(node_child(vertex, 1)), "Redefined function");
 
-            if (!CompSt(vertex->childs[2], type_inh)) {
+            if (!CompSt(node_child(vertex, 2), type_inh)) {
                 /* no return val */
             } 
         }
     }
 }
 
-struct Type* Specifier(struct Node* vertex) {   
-    SAFE_ID(vertex,"Specifier");
-    if (CHECK_ID(vertex->childs[0], "TYPE")) {      
+struct Type* Specifier(NodeRef vertex) {   
+    SAFE_ID(vertex, NK_Specifier);
+    if (CHECK_ID(node_child(vertex, 0), NK_TYPE)) {      
         struct Type* basic_type;
-        if (strcmp(vertex->childs[0]->info, "int") == 0)  // this is "int" defined in .l file 
+        if (node_sub(node_child(vertex, 0)) == BK_INT)  // sub kind is set in .l file 
             basic_type = INT_PTR;
         else
             basic_type = FLOAT_PTR;
         return basic_type;
     }
     else {
-        struct Type* res = StructSpecifier(vertex->childs[0]);
+        struct Type* res = StructSpecifier(node_child(vertex, 0));
         if (res == NULL) {
             return INVALID_TYPE;
         }
@@ -144,18 +388,18 @@ struct Type* Specifier(struct Node* vertex) {
     }
 }
 
-struct Type* StructSpecifier(struct Node* vertex) {
-    SAFE_ID(vertex,"StructSpecifier");
+struct Type* StructSpecifier(NodeRef vertex) {
+    SAFE_ID(vertex, NK_StructSpecifier);
 
-    if (CHECK_ID(vertex->childs[1], "Tag")) { //struct def reference  
+    if (CHECK_ID(node_child(vertex, 1), NK_Tag)) { //struct def reference  
 
-        struct Symbol* id = search_symbol(vertex->childs[1]->childs[0]->info);
+        struct Symbol* id = search_symbol(node_text(node_child(node_child(vertex, 1), 0)));
         if (id == NULL) {
-            errorinfo(17, vertex->childs[1]->lineno, "Undefined struct type");
+            errorinfo(17, node_line(node_child(vertex, 1)), "Undefined struct type");
             return NULL;
         }
         else if (id->kind != USER_TYPE) {
-            errorinfo(17, vertex->childs[1]->lineno, "Undefined struct type");
+            errorinfo(17, node_line(node_child(vertex, 1)), "Undefined struct type");
         }
 
         struct Type* type = id->type;
@@ -163,23 +407,23 @@ struct Type* StructSpecifier(struct Node* vertex) {
     }
     else { //struct definition
         struct Symbol* id;
-        if (vertex->childs[1]->childs[0] != NULL) {
-            id = create_symbol(vertex->childs[1]->childs[0]->info, USER_TYPE, vertex->childs[1]->childs[0]->lineno);
+        if (node_child(node_child(vertex, 1), 0) != NULL_NODE) {
+            id = create_symbol(node_text(node_child(node_child(vertex, 1), 0)), USER_TYPE, node_line(node_child(node_child(vertex, 1), 0)));
         }
         else {
             char p[20];
             sprintf(p, "%d", anon_count++);
-            id = create_symbol(p, USER_TYPE, vertex->childs[1]->lineno);
+            id = create_symbol(intern_str(p), USER_TYPE, node_line(node_child(vertex, 1)));
         }
 
         struct Type* type = create_type(STRUCTURE);
 
         struct_def_flag ++;
-        DefList(vertex->childs[3], &type->structure);
+        DefList(node_child(vertex, 3), &type->structure, type);
         struct_def_flag --;
 
         if (id == NULL) {
-            errorinfo(16, vertex->childs[1]->lineno, "Redefined struct identifier");
+            errorinfo(16, node_line(node_child(vertex, 1)), "Redefined struct identifier");
         }
         else {
             id->type = type;
@@ -190,67 +434,66 @@ struct Type* StructSpecifier(struct Node* vertex) {
     }
 }
 
-void ExtDecList(struct Node* vertex, struct Type* type_inh) {
-    SAFE_ID(vertex,"ExtDecList");
-    VarDec(vertex->childs[0], type_inh);
+void ExtDecList(NodeRef vertex, struct Type* type_inh) {
+    SAFE_ID(vertex, NK_ExtDecList);
+    VarDec(node_child(vertex, 0), type_inh);
 
-    if (vertex->childs[2] != NULL) {
-        ExtDecList(vertex->childs[2], type_inh);
+    if (node_child(vertex, 2) != NULL_NODE) {
+        ExtDecList(node_child(vertex, 2), type_inh);
     }
 }
 
-struct Symbol* VarDec(struct Node* vertex, struct Type* type_inh) {
-    SAFE_ID(vertex,"VarDec");
-    if (CHECK_ID(vertex->childs[0], "ID")) {                                                            
-        struct Symbol* var = create_symbol(vertex->childs[0]->info, VAR, vertex->childs[0]->lineno);
+struct Symbol* VarDec(NodeRef vertex, struct Type* type_inh) {
+    SAFE_ID(vertex, NK_VarDec);
+    if (CHECK_ID(node_child(vertex, 0), NK_ID)) {                                                            
+        struct Symbol* var = create_symbol(node_text(node_child(vertex, 0)), VAR, node_line(node_child(vertex, 0)));
+        struct Symbol* entry = var;     //the symbol which the name refers to in the symbol table
         struct Type* type = type_inh;
 
         if (var == NULL) {
-            errorinfo(3, vertex->childs[0]->lineno, "Redefined variant");
+            errorinfo(3, node_line(node_child(vertex, 0)), "Redefined variant");
+            entry = search_symbol(node_text(node_child(vertex, 0)));
             //create new symbol for further check
-            var = malloc(sizeof(struct Symbol));
+            var = arena_alloc(&type_arena, sizeof(struct Symbol));
+            memset(var, 0, sizeof(struct Symbol));
             var->kind = VAR;
-            var->id = malloc(strlen(vertex->childs[0]->info) + 1);
-            strcpy(var->id, vertex->childs[0]->info);
-            var->first_lineno = vertex->childs[0]->lineno;
+            var->id = node_text(node_child(vertex, 0));
+            var->first_lineno = node_line(node_child(vertex, 0));
         }
 
         var->type = type;
 
+        struct ExpType var_type = { type, true };
+        set_attr(vertex, var_type, entry, VAR);
         return var;
     }
     else {
-        struct Type* type = create_type(ARRAY);
-        type->array.elem_type = type_inh;
-        type->array.size = atoi(vertex->childs[2]->info);
-        return VarDec(vertex->childs[0], type);
+        struct Type* type = array_type(type_inh, atoi(node_text(node_child(vertex, 2))));
+        return VarDec(node_child(vertex, 0), type);
     }
 }
 
-struct Symbol* FunDec(struct Node* vertex, struct Type* type_inh) {  
-    SAFE_ID(vertex, "FunDec");                                          
-    struct Symbol* func = search_symbol(vertex->childs[0]->info);                              
+struct Symbol* FunDec(NodeRef vertex, struct Type* type_inh) {  
+    SAFE_ID(vertex, NK_FunDec);                                          
+    struct Symbol* func = search_symbol(node_text(node_child(vertex, 0)));                              
     struct Symbol* former = NULL;
 
     if (func == NULL) { //first appear                
-        func = create_symbol(vertex->childs[0]->info, PROC, vertex->childs[0]->lineno);        
+        func = create_symbol(node_text(node_child(vertex, 0)), PROC, node_line(node_child(vertex, 0)));        
     }
     else { //appear again, need to check       
         former = func;
 
-        func = malloc(sizeof(struct Symbol));
+        func = arena_alloc(&type_arena, sizeof(struct Symbol));
         memset(func, 0, sizeof(struct Symbol));
-        char *id = vertex->childs[0]->info;
-
-        func->id = malloc(strlen(id) + 1);
-        strcpy(func->id, id);
+        func->id = node_text(node_child(vertex, 0));
         func->kind = PROC;
-        func->first_lineno = vertex->childs[0]->lineno;
+        func->first_lineno = node_line(node_child(vertex, 0));
     }
 
     func->proc_type.ret_type = type_inh;
-    if (CHECK_ID(vertex->childs[2], "VarList")) {
-        VarList(vertex->childs[2], func, 0);
+    if (CHECK_ID(node_child(vertex, 2), NK_VarList)) {
+        VarList(node_child(vertex, 2), func);
     }
 
     if (former != NULL) {
@@ -270,216 +513,206 @@ struct Symbol* FunDec(struct Node* vertex, struct Type* type_inh) {
     return func;
 }
 
-void VarList(struct Node* vertex, struct Symbol* func, int pos) {
-    SAFE_ID(vertex, "VarList");               
+void VarList(NodeRef vertex, struct Symbol* func) {
+    SAFE_ID(vertex, NK_VarList);               
     if (func->kind != PROC) {
         panic("Unexpected Non process function id");
     }
-    else if (pos >= MAX_ARGS) {
-        panic("Too many arguments for a function");
-    }
 
-    func->proc_type.argtype_list[pos] = ParamDec(vertex->childs[0])->type; 
-    if (vertex->childs[1] != NULL) {
-        VarList(vertex->childs[2], func, pos + 1);
+    int pos = 0;
+    for (int i = 0; i < node_childs(vertex); i += 2) { // ParamDec and COMMA take turns
+        if (pos >= MAX_ARGS) {
+            panic("Too many arguments for a function");
+        }
+        func->proc_type.argtype_list[pos++] = ParamDec(node_child(vertex, i))->type; 
     }
 }
 
-struct Symbol* ParamDec(struct Node* vertex) {
-    SAFE_ID(vertex,"ParamDec");
-    struct Type* type_inh = Specifier(vertex->childs[0]);
+struct Symbol* ParamDec(NodeRef vertex) {
+    SAFE_ID(vertex, NK_ParamDec);
+    struct Type* type_inh = Specifier(node_child(vertex, 0));
 
-    return VarDec(vertex->childs[1], type_inh);
+    return VarDec(node_child(vertex, 1), type_inh);
 }
 
-void DefList(struct Node* vertex, struct FieldList** fl_inh) {  
-    SAFE_ID(vertex,"DefList");
-    if (vertex->childs[0] != NULL) {    
-        struct FieldList* fl_syn = Def(vertex->childs[0]);
+//arg:struct_inh is the struct type whose fields are defined by the list, NULL for local definitions
+void DefList(NodeRef vertex, struct FieldList** fl_inh, struct Type* struct_inh) {  
+    SAFE_ID(vertex, NK_DefList);
+    for (int i = 0; i < node_childs(vertex); ++i) {    
+        struct FieldList* fl_syn = Def(node_child(vertex, i));
 
-        if (*fl_inh == NULL) //set as the head
-            *fl_inh = fl_syn;
-        else { //insert to the tail
-            struct FieldList* tail = *fl_inh;
-            while (tail->next != NULL) {
-                if (struct_def_flag && check_fields(tail->id, fl_syn)) {
-                    errorinfo(15, vertex->childs[0]->lineno, "Redefined field");
+        if (struct_inh != NULL) {
+            for (struct FieldList* fl = fl_syn; fl != NULL; fl = fl->next) {
+                if (find_field(struct_inh, fl->id) != NULL) {
+                    errorinfo(15, node_line(node_child(vertex, i)), "Redefined field");
                 }
-
-                tail = tail->next;
             }
-
-            if (struct_def_flag && check_fields(tail->id, fl_syn)) {
-                errorinfo(15, vertex->childs[0]->lineno, "Redefined field");
+            for (struct FieldList* fl = fl_syn; fl != NULL; fl = fl->next) {
+                add_field(struct_inh, fl);
             }
-            tail->next = fl_syn;
         }
 
-        //connect sublist to the tail
-        DefList(vertex->childs[1], fl_inh);
+        //insert to the tail, fl_inh is left on the next pointer of the last field
+        while (*fl_inh != NULL)
+            fl_inh = &(*fl_inh)->next;
+        *fl_inh = fl_syn;
     }
 }
 
-struct FieldList* Def(struct Node* vertex) {    
-    SAFE_ID(vertex,"Def");
-    struct Type* type_inh = Specifier(vertex->childs[0]);   
+struct FieldList* Def(NodeRef vertex) {    
+    SAFE_ID(vertex, NK_Def);
+    struct Type* type_inh = Specifier(node_child(vertex, 0));   
 
-    return DecList(vertex->childs[1], type_inh);
+    return DecList(node_child(vertex, 1), type_inh);
 }
 
-struct FieldList* DecList(struct Node* vertex, struct Type* type_inh) {
-    SAFE_ID(vertex,"DecList");
-    struct Symbol* var = Dec(vertex->childs[0], type_inh);
+struct FieldList* DecList(NodeRef vertex, struct Type* type_inh) {
+    SAFE_ID(vertex, NK_DecList);
+    struct Symbol* var = Dec(node_child(vertex, 0), type_inh);
     struct FieldList* fl_syn = create_field(var->id, var->type);
 
-    if (vertex->childs[2] != NULL) {
-        fl_syn->next = DecList(vertex->childs[2], type_inh);
+    if (node_child(vertex, 2) != NULL_NODE) {
+        fl_syn->next = DecList(node_child(vertex, 2), type_inh);
     }
 
     return fl_syn;
 }
 
-struct Symbol* Dec(struct Node* vertex, struct Type* type_inh) {   
-    SAFE_ID(vertex,"Dec");
-    struct Symbol* var = VarDec(vertex->childs[0], type_inh);
+struct Symbol* Dec(NodeRef vertex, struct Type* type_inh) {   
+    SAFE_ID(vertex, NK_Dec);
+    struct Symbol* var = VarDec(node_child(vertex, 0), type_inh);
 
-    if (CHECK_ID(vertex->childs[1], "ASSIGNOP")) {
+    if (CHECK_ID(node_child(vertex, 1), NK_ASSIGNOP)) {
         if (struct_def_flag) {
-            errorinfo(15, vertex->lineno, "Cannot initialize field when defining struct type");
-        }
-        if (!comp_type(var->type, Exp(vertex->childs[2]).type)) {
-            errorinfo(5, vertex->lineno, "Type of expression is unmatched to the type of variant!");
+            errorinfo(15, node_line(vertex), "Cannot initialize field when defining struct type");
         }
+        check_later(vertex, var->type);
     }
     return var;
 }
 
-bool CompSt(struct Node* vertex, struct Type* type_inh) {
-    SAFE_ID(vertex,"CompSt");
+bool CompSt(NodeRef vertex, struct Type* type_inh) {
+    SAFE_ID(vertex, NK_CompSt);
     
     struct FieldList* var_def_list = NULL;
-    DefList(vertex->childs[1], &var_def_list);  
-    return StmtList(vertex->childs[2], type_inh);
+    DefList(node_child(vertex, 1), &var_def_list, NULL);  
+    return StmtList(node_child(vertex, 2), type_inh);
 }
 
-bool StmtList(struct Node* vertex, struct Type* type_inh) {
-    SAFE_ID(vertex, "StmtList");               
+bool StmtList(NodeRef vertex, struct Type* type_inh) {
+    SAFE_ID(vertex, NK_StmtList);               
 
-    if (vertex->childs[0] == NULL) {
-        return false;
-    }
-    else {          
-        bool flag1 = Stmt(vertex->childs[0], type_inh);  
-        bool flag2 = StmtList(vertex->childs[1], type_inh);
-        return flag1 || flag2;
+    bool flag = false;
+    for (int i = 0; i < node_childs(vertex); ++i) {
+        if (Stmt(node_child(vertex, i), type_inh))
+            flag = true;
     }
+    return flag;
 }
 
-bool Stmt(struct Node* vertex, struct Type* type_inh) {
-    SAFE_ID(vertex, "Stmt");
-    if (CHECK_ID(vertex->childs[0], "RETURN")) {
-        if (!comp_type(type_inh, Exp(vertex->childs[1]).type)) {
-            errorinfo(8, vertex->childs[0]->lineno, "Return type is unmatched to function definition");
-        }
+bool Stmt(NodeRef vertex, struct Type* type_inh) {
+    SAFE_ID(vertex, NK_Stmt);
+    if (CHECK_ID(node_child(vertex, 0), NK_RETURN)) {
+        check_later(vertex, type_inh);
         return true;
     }
-    else if (CHECK_ID(vertex->childs[0], "CompSt")) {
-        return CompSt(vertex->childs[0], type_inh);
+    else if (CHECK_ID(node_child(vertex, 0), NK_CompSt)) {
+        return CompSt(node_child(vertex, 0), type_inh);
     }
-    else if (CHECK_ID(vertex->childs[2], "Exp")) { //common pattern of control flow stmts
-
-        if (!comp_type(Exp(vertex->childs[2]).type, INT_PTR)) {
-            errorinfo(7, vertex->childs[2]->lineno, "Use non integer expression as judgement condition");
-        }  
-        bool flag = Stmt(vertex->childs[4], type_inh);
+    else if (CHECK_ID(node_child(vertex, 2), NK_Exp)) { //common pattern of control flow stmts
+        check_later(vertex, type_inh);
+        bool flag = Stmt(node_child(vertex, 4), type_inh);
 
-        if (CHECK_ID(vertex->childs[6], "Stmt")) {
-            flag = flag || Stmt(vertex->childs[6], type_inh);
+        if (CHECK_ID(node_child(vertex, 6), NK_Stmt)) {
+            flag = flag || Stmt(node_child(vertex, 6), type_inh);
         }
         return flag;
     }
     else {          
-        Exp(vertex->childs[0]); 
+        check_later(vertex, type_inh);
         return false;
     }
 }
 
-struct ExpType Exp(struct Node* vertex) {
-    SAFE_ID(vertex, "Exp");
+struct ExpType Exp(NodeRef vertex) {
+    SAFE_ID(vertex, NK_Exp);
     struct ExpType type_syn;
     type_syn.type = INVALID_TYPE;
     type_syn.lvalue = false;
+    struct Symbol* symbol = NULL;
+    int addr = VAR;
 
-    if (CHECK_ID(vertex->childs[0], "ID") && !CHECK_ID(vertex->childs[1], "LP")) { //Var reference
-        struct Symbol* var = search_symbol(vertex->childs[0]->info);
+    if (CHECK_ID(node_child(vertex, 0), NK_ID) && !CHECK_ID(node_child(vertex, 1), NK_LP)) { //Var reference
+        struct Symbol* var = search_symbol(node_text(node_child(vertex, 0)));
         type_syn.lvalue = true;
+        symbol = var;
 
         if (var != NULL) {
             type_syn.type = var->type;
         }
         else {
-            errorinfo(1, vertex->childs[0]->lineno, "Use undefined variant");
+            errorinfo(1, node_line(node_child(vertex, 0)), "Use undefined variant");
         }
     }
-    else if (CHECK_ID(vertex->childs[0], "INT")) {
+    else if (CHECK_ID(node_child(vertex, 0), NK_INT)) {
         type_syn.type = INT_PTR;
     }
-    else if (CHECK_ID(vertex->childs[0], "FLOAT")) {
+    else if (CHECK_ID(node_child(vertex, 0), NK_FLOAT)) {
         type_syn.type = FLOAT_PTR;
     }
-    else if (CHECK_ID(vertex->childs[1], "ASSIGNOP")) {   
-        struct ExpType ltype = Exp(vertex->childs[0]);
-        struct ExpType rtype = Exp(vertex->childs[2]);
+    else if (CHECK_ID(node_child(vertex, 1), NK_ASSIGNOP)) {   
+        struct ExpType ltype = Exp(node_child(vertex, 0));
+        struct ExpType rtype = Exp(node_child(vertex, 2));
 
         if (!comp_type(ltype.type, rtype.type)) {
-            errorinfo(5, vertex->childs[1]->lineno, "Types of variants besides the '=' are unmatched");
+            errorinfo(5, node_line(node_child(vertex, 1)), "Types of variants besides the '=' are unmatched");
         }
         if (!ltype.lvalue) {
-            errorinfo(6, vertex->childs[1]->lineno, "The left operand is not lvalue");
+            errorinfo(6, node_line(node_child(vertex, 1)), "The left operand is not lvalue");
         }
         else {
             type_syn.lvalue = true;
         }
         type_syn.type = ltype.type;
     }
-    else if (CHECK_ID(vertex->childs[1], "AND") || CHECK_ID(vertex->childs[1], "OR")) { 
-        struct ExpType ltype = Exp(vertex->childs[0]);
-        struct ExpType rtype = Exp(vertex->childs[2]);
+    else if (CHECK_ID(node_child(vertex, 1), NK_AND) || CHECK_ID(node_child(vertex, 1), NK_OR)) { 
+        struct ExpType ltype = Exp(node_child(vertex, 0));
+        struct ExpType rtype = Exp(node_child(vertex, 2));
 
         if (!(comp_type(ltype.type, INT_PTR) && comp_type(rtype.type, INT_PTR))) {
-            errorinfo(7, vertex->childs[1]->lineno, "Use non integer expression for logical operation");
+            errorinfo(7, node_line(node_child(vertex, 1)), "Use non integer expression for logical operation");
         }
         type_syn.type = INT_PTR;
     }
-    else if (CHECK_ID(vertex->childs[1], "RELOP")) {
-        struct ExpType ltype = Exp(vertex->childs[0]);
-        struct ExpType rtype = Exp(vertex->childs[2]);
+    else if (CHECK_ID(node_child(vertex, 1), NK_RELOP)) {
+        struct ExpType ltype = Exp(node_child(vertex, 0));
+        struct ExpType rtype = Exp(node_child(vertex, 2));
 
         if (!comp_type(ltype.type, rtype.type)) {
-            errorinfo(7, vertex->childs[1]->lineno, "Types of variants besides the operator are unmatched");
+            errorinfo(7, node_line(node_child(vertex, 1)), "Types of variants besides the operator are unmatched");
         }
         if (!(ltype.type->kind == BASIC && rtype.type->kind == BASIC)) {
-            errorinfo(7, vertex->lineno, "Cannot use non basic variants for relational operation");
+            errorinfo(7, node_line(vertex), "Cannot use non basic variants for relational operation");
         }
         type_syn.type = INT_PTR;
     }
-    else if (CHECK_ID(vertex->childs[1], "PLUS") || CHECK_ID(vertex->childs[1], "MINUS") || CHECK_ID(vertex->childs[1], "STAR") || CHECK_ID(vertex->childs[1], "DIV")) {
-        struct ExpType ltype = Exp(vertex->childs[0]);
-        struct ExpType rtype = Exp(vertex->childs[2]);
+    else if (CHECK_ID(node_child(vertex, 1), NK_PLUS) || CHECK_ID(node_child(vertex, 1), NK_MINUS) || CHECK_ID(node_child(vertex, 1), NK_STAR) || CHECK_ID(node_child(vertex, 1), NK_DIV)) {
+        struct ExpType ltype = Exp(node_child(vertex, 0));
+        struct ExpType rtype = Exp(node_child(vertex, 2));
         struct Type* res = NULL;
 
         if (!comp_type(ltype.type, rtype.type)) {
-            errorinfo(7, vertex->childs[1]->lineno, "Types of variants besides the operator are unmatched");
+            errorinfo(7, node_line(node_child(vertex, 1)), "Types of variants besides the operator are unmatched");
         }
 
         if (ltype.type->kind != BASIC) {
-            errorinfo(7,vertex->childs[0]->lineno, "Type of left operand is invalid, use non basic type expression for arithmetical operation");
+            errorinfo(7,node_line(node_child(vertex, 0)), "Type of left operand is invalid, use non basic type expression for arithmetical operation");
         }
         else {
             res = ltype.type;
         }
         if (rtype.type->kind != BASIC) {
-            errorinfo(7,vertex->childs[0]->lineno, "Type of right operand is invalid, use non basic type expression for arithmetical operation");
+            errorinfo(7,node_line(node_child(vertex, 0)), "Type of right operand is invalid, use non basic type expression for arithmetical operation");
         }
         else if (res == NULL) {
             res = rtype.type;
@@ -490,54 +723,53 @@ struct ExpType Exp(struct Node* vertex) {
         }
         type_syn.type = res;
     }
-    else if(CHECK_ID(vertex->childs[0], "LP") && CHECK_ID(vertex->childs[1], "Exp")) {
-        type_syn = Exp(vertex->childs[1]);
+    else if(CHECK_ID(node_child(vertex, 0), NK_LP) && CHECK_ID(node_child(vertex, 1), NK_Exp)) {
+        type_syn = Exp(node_child(vertex, 1));
+        addr = node_attrs[ast_nodes[node_child(vertex, 1)].attr].addr;
     }
-    else if (CHECK_ID(vertex->childs[0], "MINUS")) {
-        struct ExpType rtype = Exp(vertex->childs[1]);
+    else if (CHECK_ID(node_child(vertex, 0), NK_MINUS)) {
+        struct ExpType rtype = Exp(node_child(vertex, 1));
 
         if (rtype.type->kind != BASIC) {
-            errorinfo(7, vertex->childs[1]->lineno, "Use non basic type expression for arithmetical operation");
+            errorinfo(7, node_line(node_child(vertex, 1)), "Use non basic type expression for arithmetical operation");
         }
         type_syn.type = rtype.type;
     }
-    else if (CHECK_ID(vertex->childs[0], "NOT")) {
-        struct ExpType rtype = Exp(vertex->childs[1]);
+    else if (CHECK_ID(node_child(vertex, 0), NK_NOT)) {
+        struct ExpType rtype = Exp(node_child(vertex, 1));
 
         if (!(comp_type(rtype.type, INT_PTR))) {
-            errorinfo(7, vertex->childs[1]->lineno, "Use non integer expression for logical operation");
+            errorinfo(7, node_line(node_child(vertex, 1)), "Use non integer expression for logical operation");
         }
         type_syn.type = INT_PTR;
     }
-    else if (CHECK_ID(vertex->childs[0], "ID") && CHECK_ID(vertex->childs[1], "LP")) {//function invoking
-        struct Symbol* func = search_symbol(vertex->childs[0]->info);
+    else if (CHECK_ID(node_child(vertex, 0), NK_ID) && CHECK_ID(node_child(vertex, 1), NK_LP)) {//function invoking
+        struct Symbol* func = search_symbol(node_text(node_child(vertex, 0)));
+        symbol = func;
         if (func == NULL) {
-            errorinfo(2, vertex->childs[0]->lineno, "Use undefined function");
+            errorinfo(2, node_line(node_child(vertex, 0)), "Use undefined function");
         }
         else if (func->kind != PROC) {
-            errorinfo(11, vertex->childs[0]->lineno, "The identifier is not a function");
+            errorinfo(11, node_line(node_child(vertex, 0)), "The identifier is not a function");
         }
         else {
             bool flag = true;
 
             //check args list
-            if (CHECK_ID(vertex->childs[2], "Args")) {
-                struct FieldList* argslist = Args(vertex->childs[2]);
+            if (CHECK_ID(node_child(vertex, 2), NK_Args)) {
                 int pos = 0;
-                while (argslist != NULL && pos < MAX_ARGS) {
-                    struct Type* arg = argslist->type;
-                    if (!comp_type(arg, func->proc_type.argtype_list[pos])) {
+                for (NodeRef args = node_child(vertex, 2); args != NULL_NODE; args = node_child(args, 2)) {
+                    struct Type* arg = Exp(node_child(args, 0)).type;
+                    if (pos < MAX_ARGS && !comp_type(arg, func->proc_type.argtype_list[pos])) {
                         flag = false;
                     }
-
                     pos++;
-                    argslist = argslist->next;
                 }
 
-                if (pos == MAX_ARGS && argslist != NULL) {
+                if (pos > MAX_ARGS) {
                     panic("Too many arguments");
                 }
-                else if (argslist == NULL && pos < MAX_ARGS && func->proc_type.argtype_list[pos] != NULL) {
+                else if (pos < MAX_ARGS && func->proc_type.argtype_list[pos] != NULL) {
                     flag = false;
                 }
             }
@@ -546,80 +778,85 @@ struct ExpType Exp(struct Node* vertex) {
             }
 
             if (flag == false) {
-                errorinfo(9, vertex->childs[2]->lineno, "Arguments are unmatched to the definition of function");
+                errorinfo(9, node_line(node_child(vertex, 2)), "Arguments are unmatched to the definition of function");
             }
             type_syn.type = func->proc_type.ret_type;
         }
     }
-    else if (CHECK_ID(vertex->childs[1], "LB")) {
-        struct ExpType id_type = Exp(vertex->childs[0]);
-        struct ExpType index_type = Exp(vertex->childs[2]);
+    else if (CHECK_ID(node_child(vertex, 1), NK_LB)) {
+        struct ExpType id_type = Exp(node_child(vertex, 0));
+        struct ExpType index_type = Exp(node_child(vertex, 2));
         type_syn.lvalue = true;
+        addr = ARRAY;
 
         if (!(index_type.type->kind == BASIC && index_type.type->basic == INT)) {
-            errorinfo(12, vertex->childs[2]->lineno, "Use non integer expression as array index");
+            errorinfo(12, node_line(node_child(vertex, 2)), "Use non integer expression as array index");
         }
 
         if (id_type.type->kind != ARRAY) {
-            errorinfo(10, vertex->childs[0]->lineno, "The identifier is not an array");
+            errorinfo(10, node_line(node_child(vertex, 0)), "The identifier is not an array");
         }
         else {
             type_syn.type = id_type.type->array.elem_type;
         }
     }
-    else if (CHECK_ID(vertex->childs[1], "DOT")) {
-        struct ExpType id_type = Exp(vertex->childs[0]);
+    else if (CHECK_ID(node_child(vertex, 1), NK_DOT)) {
+        struct ExpType id_type = Exp(node_child(vertex, 0));
         type_syn.lvalue = true;
+        addr = STRUCTURE;
 
         if (id_type.type->kind != STRUCTURE) {
-            errorinfo(13, vertex->childs[0]->lineno, "The identifier is not a struct variant");
+            errorinfo(13, node_line(node_child(vertex, 0)), "The identifier is not a struct variant");
         }
         else {
-            struct FieldList* fl = id_type.type->structure;
-
-            bool flag = false;
-            while (fl != NULL) {
-                if (strcmp(fl->id, vertex->childs[2]->info) == 0) {   // is equal
-                    flag = true;
-                    type_syn.type = fl->type;
-                    break;
-                }
+            struct FieldList* fl = find_field(id_type.type, node_text(node_child(vertex, 2)));
 
-                fl = fl->next;
+            if (fl != NULL) {
+                type_syn.type = fl->type;
             }
-
-            if (flag == false) {
-                errorinfo(14, vertex->childs[2]->lineno, "Use undefined field of struct variant");
+            else {
+                errorinfo(14, node_line(node_child(vertex, 2)), "Use undefined field of struct variant");
             }
         }
     }
 
+    set_attr(vertex, type_syn, symbol, addr);
     return type_syn;
 }
 
-struct FieldList* Args(struct Node* vertex) {
-    SAFE_ID(vertex, "Args");
-    struct Type* type = Exp(vertex->childs[0]).type;
-    struct FieldList* res = create_field("arg", type);
+/* operations on data structure for semantic parsing */
 
-    if (vertex->childs[2] != NULL && CHECK_ID(vertex->childs[2], "Args")) {
-        struct FieldList* types = Args(vertex->childs[2]);
-        res->next = types;
+// put arg:item into the slot chosen by robin hood probing, items closer to their home slot give way
+static void place_symbol(struct SymbolTableItem item) {
+    unsigned int mask = table_cap - 1;
+    unsigned int pos = item.hash & mask, dist = 0;
+
+    while (symbol_table[pos].id != NULL) {
+        unsigned int cur = (pos - symbol_table[pos].hash) & mask;   // probe distance of the resident
+        if (cur < dist) {
+            struct SymbolTableItem temp = symbol_table[pos];
+            symbol_table[pos] = item;
+            item = temp;
+            dist = cur;
+        }
+        pos = (pos + 1) & mask;
+        ++dist;
     }
-
-    return res;
+    symbol_table[pos] = item;
 }
 
-/* operations on data structure for semantic parsing */
-
-// BKDR Hash Function used for symbol table
-unsigned int hash(char *str) {
-    unsigned int val = 5381;
-    while(*str) {
-        val += (val << 5) + (*str++);
+// double the slots of the symbol table and rehash the symbols with their stored hash values
+static void grow_table() {
+    struct SymbolTableItem* old = symbol_table;
+    unsigned int old_cap = table_cap;
+
+    table_cap = old_cap ? old_cap * 2 : TABLE_INIT_SIZE;
+    symbol_table = arena_alloc(&type_arena, table_cap * sizeof(struct SymbolTableItem));
+    memset(symbol_table, 0, table_cap * sizeof(struct SymbolTableItem));
+    for (unsigned int i = 0; i < old_cap; ++i) {
+        if (old[i].id != NULL)
+            place_symbol(old[i]);
     }
-
-    return ((val & 0x7fffffff) % TABLE_SIZE);
 }
 
 // insert a symbol into the symbol table
@@ -627,22 +864,13 @@ void add_symbol(struct Symbol* newItem) {
     if (newItem == NULL)
         panic("Null new item");
 
-    int pos = hash(newItem->id);
-    struct SymbolTableItem* head = symbol_table[pos];
-
-    //insert into the top pos
-    if (head == NULL) {             
-        head = malloc(sizeof(struct SymbolTableItem));
-        head->id = newItem;
-        head->next = NULL;
-        symbol_table[pos] = head;
-    }
-    else {
-        struct SymbolTableItem* temp = malloc(sizeof(struct SymbolTableItem));
-        temp->id = newItem;
-        temp->next = head;
-        symbol_table[pos] = temp;
-    }
+    if ((table_num + 1) * 4 > table_cap * 3)    // keep the load factor under 3/4
+        grow_table();
+    struct SymbolTableItem item = { newItem, intern_hash(newItem->id) };
+    place_symbol(item);
+    newItem->seq = table_num++;
+    newItem->older = newest_symbol;
+    newest_symbol = newItem;
 
     if(newItem->kind == VAR || newItem->kind == USER_TYPE) {
         newItem->var_num = var_count++;
@@ -651,20 +879,43 @@ void add_symbol(struct Symbol* newItem) {
 
 // search the symbol in the symbol table, return NULL, if not found
 struct Symbol* search_symbol(char* name) {
-    int pos = hash(name);
-    struct SymbolTableItem* head = symbol_table[pos];           
+    if (table_cap == 0)
+        return NULL;
+
+    unsigned int h = intern_hash(name), mask = table_cap - 1;
+    unsigned int pos = h & mask, dist = 0;
+    // stop at an empty slot, or a resident closer to its home slot than the name would be
+    while (symbol_table[pos].id != NULL && ((pos - symbol_table[pos].hash) & mask) >= dist) {
+        if (symbol_table[pos].id->id == name) { // symbols added after the visible ones are not defined yet to the thread
+            STAT_ADD(COUNT_SYMBOL_PROBE, dist + 1);
+            return symbol_table[pos].id->seq < visible_limit ? symbol_table[pos].id : NULL;
+        }
+
+        pos = (pos + 1) & mask;
+        ++dist;
+    }
 
-    while (head != NULL) {
-        if (CHECK_ID(head->id, name))
-            return head->id;
+    STAT_ADD(COUNT_SYMBOL_PROBE, dist + 1);
+    return NULL;
+}
 
-        head = head->next;
+// iterate the symbol table from slot arg:pos, which starts at 0, return NULL after the last symbol
+struct Symbol* next_symbol(unsigned int* pos) {
+    while (*pos < table_cap) {
+        struct Symbol* res = symbol_table[(*pos)++].id;
+        if (res != NULL)
+            return res;
     }
 
     return NULL;
 }
 
-// create a Symbol structure variant, return NULL, if the symbol exists
+// return the symbol added to the symbol table last, the symbols before it are reached by Symbol.older
+struct Symbol* latest_symbol() {
+    return newest_symbol;
+}
+
+// create a Symbol structure variant named by interned arg:id, return NULL, if the symbol exists
 struct Symbol* create_symbol(char* id, int kind, int first_lineno) {
     struct Symbol* temp;
     bool flag = !((struct_def_flag || func_dec_flag) && kind == VAR); //judge whether need to alter symbol table
@@ -674,11 +925,10 @@ struct Symbol* create_symbol(char* id, int kind, int first_lineno) {
             return NULL;
     }
 
-    temp = malloc(sizeof(struct Symbol));
+    temp = arena_alloc(&type_arena, sizeof(struct Symbol));
     memset(temp, 0, sizeof(struct Symbol));
 
-    temp->id = malloc(strlen(id) + 1);
-    strcpy(temp->id, id);
+    temp->id = id;
     temp->kind = kind;
     temp->first_lineno = first_lineno;
 
@@ -687,162 +937,237 @@ struct Symbol* create_symbol(char* id, int kind, int first_lineno) {
     return temp;
 }
 
-// create a Type structure variant
+// create a Type structure variant, which is only compatible with itself
 struct Type* create_type(int kind) {
-    struct Type* temp = malloc(sizeof(struct Type));
+    struct Type* temp = arena_alloc(&type_arena, sizeof(struct Type));
     memset(temp, 0, sizeof(struct Type));
 
     temp->kind = kind;
+    temp->compat = temp;
     return temp;
 }
 
-// create a FieldList structure variant
+// hash of the array type of arg:size elements of arg:elem_type
+static unsigned int array_hash(struct Type* elem_type, int size) {
+    uintptr_t p = (uintptr_t)elem_type / ARENA_ALIGN;   // types are aligned by the arena
+    return (unsigned int)(p ^ (p >> 16)) * 31 + (unsigned int)size;
+}
+
+// put array type arg:type into the first free slot of the array type table, probing linearly
+static void place_array(struct Type* type) {
+    unsigned int mask = array_cap - 1;
+    unsigned int pos = array_hash(type->array.elem_type, type->array.size) & mask;
+    while (array_types[pos] != NULL)
+        pos = (pos + 1) & mask;
+    array_types[pos] = type;
+}
+
+// return the type of arrays of arg:size elements of arg:elem_type, each such type is created once
+struct Type* array_type(struct Type* elem_type, int size) {
+    if (array_cap != 0) {
+        unsigned int mask = array_cap - 1;
+        unsigned int pos = array_hash(elem_type, size) & mask;
+        while (array_types[pos] != NULL) {
+            if (array_types[pos]->array.elem_type == elem_type && array_types[pos]->array.size == size)
+                return array_types[pos];
+            pos = (pos + 1) & mask;
+        }
+    }
+
+    if ((array_num + 1) * 2 > array_cap) {    // keep the load factor under 1/2
+        struct Type** old = array_types;
+        unsigned int old_cap = array_cap;
+
+        array_cap = old_cap ? old_cap * 2 : ARRAY_TABLE_INIT_SIZE;
+        array_types = arena_alloc(&type_arena, array_cap * sizeof(struct Type*));
+        memset(array_types, 0, array_cap * sizeof(struct Type*));
+        for (unsigned int i = 0; i < old_cap; ++i) {
+            if (old[i] != NULL)
+                place_array(old[i]);
+        }
+    }
+
+    struct Type* type = create_type(ARRAY);
+    type->array.elem_type = elem_type;
+    type->array.size = size;
+    type->size = size * elem_type->size;
+    place_array(type);
+    ++array_num;
+
+    // the size of arrays is ignored when comparing types, so arrays share the type of 0 elements
+    if (elem_type->compat == NULL)
+        type->compat = NULL;
+    else if (size != 0 || elem_type->compat != elem_type)
+        type->compat = array_type(elem_type->compat, 0);
+    return type;
+}
+
+// create a FieldList structure variant named by interned arg:id
 struct FieldList* create_field(char* id, struct Type* type) {
-    struct FieldList* temp = malloc(sizeof(struct FieldList));
+    struct FieldList* temp = arena_alloc(&type_arena, sizeof(struct FieldList));
     memset(temp, 0, sizeof(struct FieldList));
 
-    temp->id = malloc(strlen(id) + 1);
-    strcpy(temp->id, id);
+    temp->id = id;
     temp->type = type;
 
     return temp;
 }
 
 void display_symbol() {
-    // symbol_table[TABLE_SIZE]
-    for(int i = 0; i < TABLE_SIZE; i++) {   
-        if(symbol_table[i] != NULL) {                       
-            struct SymbolTableItem *p = symbol_table[i];
-            while(p != NULL) {
-                printf("%d: ID is %s, kind is %d\n", i, p->id->id, p->id->kind);  
-                p = p->next;
-            }
-        }
+    unsigned int pos = 0;
+    struct Symbol* id;
+    while ((id = next_symbol(&pos)) != NULL) {
+        printf("%u: ID is %s, kind is %d\n", pos - 1, id->id, id->kind);  
     }
 }
 
 // compare two Type structure, return true, if they are equal
 bool comp_type(struct Type* ltype, struct Type* rtype) {
-    if ((ltype ==  NULL || rtype == NULL) || ltype->kind != rtype->kind)  // ltype may be NULL 
+    if (ltype ==  NULL || rtype == NULL)  // ltype may be NULL 
         return false;
 
-    if (ltype->kind == BASIC) {
-        return ltype->basic == rtype->basic;
-    }
-    else if (ltype->kind == ARRAY) {
-        return comp_type(ltype->array.elem_type, rtype->array.elem_type);
-    }
-    else if (ltype->kind == STRUCTURE) {
-        return !strcmp(ltype->struct_id, rtype->struct_id);
-    }
+    return ltype->compat != NULL && ltype->compat == rtype->compat;
+}
+
+// put arg:field into the first free slot of the field index of arg:type, probing linearly
+static void place_field(struct Type* type, struct FieldList* field) {
+    unsigned int mask = type->index_cap - 1;
+    unsigned int pos = intern_hash(field->id) & mask;
+    while (type->field_index[pos] != NULL)
+        pos = (pos + 1) & mask;
+    type->field_index[pos] = field;
 }
 
-// check whether the id exists in the field list or not, return true if id exists
-bool check_fields(char* id, struct FieldList* head) {
-    while (head != NULL) {
-        if (strcmp(id, head->id) == 0) {   // id == head->id return true
-            return true;
+// append arg:field to the layout of struct arg:type, behind the fields added before
+void add_field(struct Type* type, struct FieldList* field) {
+    field->offset = type->size;
+    type->size += field->type->size;
+    if (find_field(type, field->id) != NULL)  // a redefined field is only reachable by the first one
+        return;
+
+    if ((type->field_num + 1) * 2 > type->index_cap) {  // keep the load factor under 1/2
+        struct FieldList** old = type->field_index;
+        unsigned int old_cap = type->index_cap;
+
+        type->index_cap = old_cap ? old_cap * 2 : FIELD_INDEX_INIT_SIZE;
+        type->field_index = arena_alloc(&type_arena, type->index_cap * sizeof(struct FieldList*));
+        memset(type->field_index, 0, type->index_cap * sizeof(struct FieldList*));
+        for (unsigned int i = 0; i < old_cap; ++i) {
+            if (old[i] != NULL)
+                place_field(type, old[i]);
         }
+    }
+    place_field(type, field);
+    ++type->field_num;
+}
 
-        head = head->next;
+// search the field named by interned arg:id in struct arg:type, return NULL if not found
+struct FieldList* find_field(struct Type* type, char* id) {
+    if (type == NULL || type->kind != STRUCTURE || type->index_cap == 0)
+        return NULL;
+
+    unsigned int mask = type->index_cap - 1;
+    unsigned int pos = intern_hash(id) & mask;
+    while (type->field_index[pos] != NULL) {
+        if (type->field_index[pos]->id == id)
+            return type->field_index[pos];
+        pos = (pos + 1) & mask;
     }
 
-    return false;
+    return NULL;
 }
 
 /* operations on syntax tree nodes*/
 
-struct Node* create_node(bool type, char* id, int lineno, const char* info) {
-    struct Node* res = malloc(NODE_SIZE);
-    memset(res, 0, NODE_SIZE);             // Nodes initialized
-
-    res->type = type;
-    res->lineno = lineno;
-    
-    if (strlen(id) == 0)
-        panic("Invalid Id\n");
-    res->id = malloc(strlen(id) + 1);
-    strcpy(res->id, id);
+//assign a new attribute slot to arg:vertex, return its index
+static uint32_t alloc_attr(NodeRef vertex) {
+    if (attr_num >= attr_cap) {
+        STAT_ADD(COUNT_BYTES, (attr_cap ? attr_cap : 1024) * sizeof(struct NodeAttr));
+        attr_cap = attr_cap ? attr_cap * 2 : 1024;
+        node_attrs = realloc(node_attrs, attr_cap * sizeof(struct NodeAttr));
+        if (node_attrs == NULL)
+            panic("Out of memory");
+    }
+    ast_nodes[vertex].attr = attr_num;
+    return attr_num++;
+}
 
-    res->info = malloc(strlen(info) + 1);
-    strcpy(res->info, info);
+//store the semantic results of arg:vertex, reusing its slot if it was analysed or reserved before
+static void set_attr(NodeRef vertex, struct ExpType exp, struct Symbol* symbol, int addr) {
+    uint32_t pos = ast_nodes[vertex].attr;
+    if (pos == 0)
+        pos = alloc_attr(vertex);
 
-    return res;
+    node_attrs[pos].exp = exp;
+    node_attrs[pos].symbol = symbol;
+    node_attrs[pos].addr = addr;
 }
 
-void destroy_tree(struct Node* root) {
-    free(root->id);
-    free(root->info);
-
-    int pos = 0;
-    while (pos < MAX_CHILDS && root->childs[pos] != NULL) {
-        destroy_tree(root->childs[pos]);
-        pos++;
+//return the semantic results of arg:vertex, an Exp which is not analysed yet is analysed now
+struct NodeAttr node_attr(NodeRef vertex) {
+    uint32_t pos = ast_nodes[vertex].attr;
+    if (pos == 0 || node_attrs[pos].addr == UNCHECKED_ADDR) {
+        if (CHECK_ID(vertex, NK_Exp)) {
+            Exp(vertex);
+        }
+        else {
+            struct NodeAttr none = { { INVALID_TYPE, false }, NULL, VAR };
+            return none;
+        }
     }
-    free(root);
+    return node_attrs[ast_nodes[vertex].attr];
 }
 
-void insert(struct Node* dest, struct Node* src) {
-    //find a empty position to insert
-    int pos = 0;
-    while (pos < MAX_CHILDS && dest->childs[pos] != NULL) pos++;
-
-    if (pos == MAX_CHILDS) {
-        panic("childs are too many!");
-    }
-    else {
-        dest->childs[pos] = src;
-    }
+//forget the semantic results of all nodes, the storage is kept for nodes analysed later
+void reset_attrs() {
+    attr_num = 1;
 }
 
-void combine(struct Node *dest,int number,...){
-    struct Node* src = NULL;
-    va_list ap;
-    va_start(ap,number); // start behind number
-    for(int i = 0; i < number; i++){
-        src = va_arg(ap,struct Node *);
-        insert(dest, src);
-    }
-    va_end(ap);
+//free the semantic results of all nodes
+void clear_attrs() {
+    free(node_attrs);
+    node_attrs = NULL;
+    attr_num = 1;
+    attr_cap = 0;
 }
 
-void display(struct Node* root,int space) {
-    if(root->type == LEXICAL_U) {                // lexical
+void display(NodeRef root,int space) {
+    if(node_is_token(root)) {                // lexical
         for(int k = 0;k < space;k++) {          // printf space
             printf(" ");
         }
-        if(strcmp(root->id,"ID") == 0) {          // ID
-            printf("%s: %s\n",root->id,root->info);
+        if(node_kind(root) == NK_ID) {          // ID
+            printf("%s: %s\n",node_name(node_kind(root)),node_text(root));
         }      
-        else if(strcmp(root->id,"TYPE") == 0) {   // TYPE
-            printf("%s: %s\n",root->id,root->info);
+        else if(node_kind(root) == NK_TYPE) {   // TYPE
+            printf("%s: %s\n",node_name(node_kind(root)),node_text(root));
         }
-        else if(strcmp(root->id,"INT") == 0) {   // INT
-            printf("%s: %d\n",root->id,atoi(root->info));
+        else if(node_kind(root) == NK_INT) {   // INT
+            printf("%s: %d\n",node_name(node_kind(root)),atoi(node_text(root)));
         }
-        else if(strcmp(root->id,"FLOAT") == 0) {   // FLOAT
-            printf("%s: %f\n",root->id,atof(root->info));
+        else if(node_kind(root) == NK_FLOAT) {   // FLOAT
+            printf("%s: %f\n",node_name(node_kind(root)),atof(node_text(root)));
         }
         else {
-            printf("%s\n",root->id);
+            printf("%s\n",node_name(node_kind(root)));
         }
     }
     else {                                // programmer 
-        if(root->childs[0] != NULL) {     // not empty 
+        if(node_child(root, 0) != NULL_NODE) {     // not empty 
             for(int k = 0;k < space;k++) {  // printf space
                 printf(" ");
             }
-            printf("%s (%d)\n",root->id,root->lineno); 
+            printf("%s (%d)\n",node_name(node_kind(root)),node_line(root)); 
             space += 2;                  // space add 2
-            for(int i = 0;(i < MAX_CHILDS) && (root->childs[i] != NULL);i++) {
-                display(root->childs[i],space);
+            for(int i = 0;i < node_childs(root);i++) {
+                display(node_child(root, i),space);
             }
         }
     }
 }
 
-void output(struct Node* root) {
-    if(root == NULL){
+void output(NodeRef root) {
+    if(root == NULL_NODE){
         panic("this tree is empty !\n");
         return;
     }
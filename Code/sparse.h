@@ -5,44 +5,39 @@
 #include <assert.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include "arena.h"
+#include "node.h"
+#include "intern.h"
+#include "stats.h"
+#include "diag.h"
 
 /* type and constant value definitions */
 
-#define LEXICAL_U 1
-#define GRAM_U 0
 #define INT 0
 #define FLOAT 1
 
-#define MAX_CHILDS 8
 #define MAX_ARGS 10
-#define TABLE_SIZE 6
+#define TABLE_INIT_SIZE 64                //initial number of slots of the symbol table, a power of 2
+#define ARRAY_TABLE_INIT_SIZE 64          //initial number of slots of the array type table, a power of 2
+#define FIELD_INDEX_INIT_SIZE 8           //initial number of slots of the field index of a struct, a power of 2
 
-#define NODE_SIZE sizeof(struct Node)
-#define CHECK_ID(vertex, name) ((vertex != NULL) ? !strcmp(vertex->id, name) : false)
+#define CHECK_ID(vertex, nk) (STAT_COUNT(COUNT_CHECK_ID), (vertex != NULL_NODE) ? node_kind(vertex) == (nk) : false)
 #define INT_PTR &INT_T
 #define FLOAT_PTR &FLOAT_T
 #define INVALID_TYPE &INVALID_T
-#define SAFE_ID(vertex, name) \
-        if (strcmp(vertex->id, name) != 0) \
+#define SAFE_ID(vertex, nk) \
+        if (node_kind(vertex) != (nk)) \
         {   \
-            printf("When checking %s:\n",vertex->id); \
-            panic("Node Unmatched!!"); \
+            diag_fail("When checking %s: Node Unmatched!!", node_name(node_kind(vertex))); \
         }
  
 enum MetaType { BASIC, ARRAY, STRUCTURE, INVALID };  
 enum SymbolMetaType { VAR, PROC, USER_TYPE };  // var, function, structure
 
-struct Node {
-    bool type;                          //[Lexical Unit]:true, [Grammatical Unit]:false
-    char* id;                           //[Lexical Unit]:token, [Grammatical Unit]:non-terminals
-    int lineno;                         //line number
-    char* info;                         //[Lexical Unit]:details, [Grammatical Unit]:undefined
-    struct Node* childs[MAX_CHILDS];    //pointers to child nodes
-};
-
 struct FieldList {                  
     char* id;                           //name of id
     struct Type* type;                  //type of id
+    int offset;                         //[Field]:bytes from the start of the struct, others:0
     struct FieldList* next;
 };
 
@@ -54,8 +49,13 @@ struct Type {
         struct {
             char* struct_id;
             struct FieldList* structure;    //head ptr for FieldList
+            struct FieldList** field_index; //open addressing table of the fields by name
+            unsigned int index_cap;         //number of slots of field_index, a power of 2
+            unsigned int field_num;         //number of names in field_index
         };
     };
+    int size;                           //bytes taken by a variant of the type
+    struct Type* compat;                //representative of the types compatible with it, NULL if none is
 };
 
 struct ExpType {
@@ -63,12 +63,20 @@ struct ExpType {
     bool lvalue;                        //flag for whether it is lvalue
 };
 
+struct NodeAttr {                       //semantic results cached on Exp and VarDec nodes for translation
+    struct ExpType exp;                 //[Exp]:type and lvalue flag, [VarDec]:type of the variant
+    struct Symbol* symbol;              //[Exp]:variant or function referred by ID, [VarDec]:variant declared
+    int addr;                           //[Exp]:addressing class, VAR, ARRAY or STRUCTURE
+};
+
 struct Symbol {
     char* id;                           //name of the symbol, id in PL
     enum SymbolMetaType kind;           //meta type of the symbol
     int first_lineno;                   //lineno where the symbol is declared firstly
     bool defined;                       //flag for define status of the symbol, only used by functions
     int var_num;                            //record temporary var
+    unsigned int seq;                   //number of symbols added to the symbol table before it
+    struct Symbol* older;               //symbol added to the symbol table just before it
     union {
         struct Type* type;
         struct {
@@ -79,43 +87,52 @@ struct Symbol {
 };
 
 struct SymbolTableItem {
-    struct Symbol* id;                  //the symbol carried by the item
-    struct SymbolTableItem* next;
+    struct Symbol* id;                  //the symbol carried by the item, NULL for an empty slot
+    unsigned int hash;                  //hash value of the name of the symbol
 };
 
+extern __thread bool unit_imports;
+
 /* function declarations */
 
 void init();
-void visit(struct Node* vertex);
+void semantic_parse(NodeRef root);
+void visit(NodeRef vertex);
 void final_check();
 void panic(char* msg);
 void errorinfo(int type, int lineno, char* description);
-void output(struct Node* root);
-unsigned int hash(char *str);
+unsigned int semantic_errors();
+void output(NodeRef root);
 
 void add_symbol(struct Symbol* newItem);
 struct Symbol* search_symbol(char* name);
+struct Symbol* next_symbol(unsigned int* pos);
+struct Symbol* latest_symbol();
 struct Symbol* create_symbol(char* id, int kind, int first_lineno);
 struct Type* create_type(int kind);
+struct Type* array_type(struct Type* elem_type, int size);
 struct FieldList* create_field(char* id, struct Type* type);
 bool comp_type(struct Type* ltype, struct Type* rtype);
 void display_symbol();
-bool check_fields(char* id, struct FieldList* fl);
+void add_field(struct Type* type, struct FieldList* field);
+struct FieldList* find_field(struct Type* type, char* id);
+struct NodeAttr node_attr(NodeRef vertex);
+void reset_attrs();
+void clear_attrs();
 
-void ExtDef(struct Node* vertex);
-struct Type* Specifier(struct Node* vertex);
-struct Type* StructSpecifier(struct Node* vertex);
-struct ExpType Exp(struct Node* vertex);
-void ExtDecList(struct Node* vertex, struct Type* type_inh);
-struct Symbol* VarDec(struct Node* vertex, struct Type* type_inh);
-struct Symbol* FunDec(struct Node* vertex, struct Type* type_inh);
-struct Symbol* Dec(struct Node* vertex, struct Type* type_inh);
-struct Symbol* ParamDec(struct Node* vertex);
-void VarList(struct Node* vertex, struct Symbol* func, int pos);
-void DefList(struct Node* vertex, struct FieldList** fl_inh);
-struct FieldList* Def(struct Node* vertex);
-struct FieldList* DecList(struct Node* vertex, struct Type* type_inh);
-bool CompSt(struct Node* vertex, struct Type* type_inh);
-bool StmtList(struct Node* vertex, struct Type* type_inh);
-bool Stmt(struct Node* vertex, struct Type* type_inh);
-struct FieldList* Args(struct Node* vertex);
\ No newline at end of file
+void ExtDef(NodeRef vertex);
+struct Type* Specifier(NodeRef vertex);
+struct Type* StructSpecifier(NodeRef vertex);
+struct ExpType Exp(NodeRef vertex);
+void ExtDecList(NodeRef vertex, struct Type* type_inh);
+struct Symbol* VarDec(NodeRef vertex, struct Type* type_inh);
+struct Symbol* FunDec(NodeRef vertex, struct Type* type_inh);
+struct Symbol* Dec(NodeRef vertex, struct Type* type_inh);
+struct Symbol* ParamDec(NodeRef vertex);
+void VarList(NodeRef vertex, struct Symbol* func);
+void DefList(NodeRef vertex, struct FieldList** fl_inh, struct Type* struct_inh);
+struct FieldList* Def(NodeRef vertex);
+struct FieldList* DecList(NodeRef vertex, struct Type* type_inh);
+bool CompSt(NodeRef vertex, struct Type* type_inh);
+bool StmtList(NodeRef vertex, struct Type* type_inh);
+bool Stmt(NodeRef vertex, struct Type* type_inh);
\ No newline at end of file
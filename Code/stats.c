@@ -0,0 +1,185 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "outbuf.h"
+#include "stats.h"
+
+/* Definitions of the instrumentation */
+
+#define STATS_TOP_FUNCS 10              //slowest functions printed in the table
+
+bool stats_enabled = false;
+__thread uint64_t stat_counts[COUNT_NUM]; //counters of the thread since its last stats_flush
+
+static const char* const phase_names[PHASE_NUM] = { "parse", "semantic_parse", "translate_semantic", "export_ir", "split_blocks", "assemble" };
+static const char* const counter_names[COUNT_NUM] = { "check_id", "symbol_probes", "add_code", "spills", "loads", "bytes" };
+
+struct StatEvent { // Definition of spans written to the trace
+    const char* name;                   //phase name, or interned name of the function
+    bool func;                          //span of a function in the backend, otherwise of a phase
+    int tid;                            //number of the thread running the span, from 1
+    uint64_t begin;                     //nanoseconds of the monotonic clock
+    uint64_t dur;
+    uint64_t bytes;
+};
+
+static uint64_t totals[COUNT_NUM];      //counters added by stats_flush
+static uint64_t phase_time[PHASE_NUM], phase_bytes[PHASE_NUM];
+static int thread_num = 0;
+static __thread int thread_id = 0;      //0 until the thread records a span
+
+static pthread_mutex_t event_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct StatEvent* events = NULL;
+static int event_num = 0, event_cap = 0;
+
+static uint64_t now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static uint64_t total_count(enum StatCounter counter) {
+    return __atomic_load_n(&totals[counter], __ATOMIC_RELAXED) + stat_counts[counter];
+}
+
+//return the bytes allocated since arg:mark, by its thread or by the process
+static uint64_t bytes_since(const struct StatMark* mark) {
+    return (mark->thread ? stat_counts[COUNT_BYTES] : total_count(COUNT_BYTES)) - mark->bytes;
+}
+
+//add a span from arg:mark until arg:end to the trace
+static void add_event(const char* name, bool func, const struct StatMark* mark, uint64_t end) {
+    if (thread_id == 0)
+        thread_id = __atomic_add_fetch(&thread_num, 1, __ATOMIC_RELAXED);
+    struct StatEvent event = { name, func, thread_id, mark->time, end - mark->time, bytes_since(mark) };
+
+    pthread_mutex_lock(&event_lock);
+    if (event_num == event_cap) {
+        event_cap = event_cap ? event_cap * 2 : 256;
+        if ((events = realloc(events, event_cap * sizeof(struct StatEvent))) == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    events[event_num++] = event;
+    pthread_mutex_unlock(&event_lock);
+}
+
+static int slower_event(const void* a, const void* b) {
+    uint64_t x = ((const struct StatEvent*)a)->dur, y = ((const struct StatEvent*)b)->dur;
+    return x > y ? -1 : x < y;
+}
+
+//print the phases, the slowest functions and the counters to stderr
+static void print_table() {
+    fprintf(stderr, "%-20s %12s %14s\n", "phase", "ms", "bytes");
+    for (int k = 0; k < PHASE_NUM; ++k)
+        fprintf(stderr, "%-20s %12.3f %14llu\n", phase_names[k], phase_time[k] / 1e6, (unsigned long long)phase_bytes[k]);
+
+    struct StatEvent* funcs = malloc((event_num ? event_num : 1) * sizeof(struct StatEvent));
+    if (funcs == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    int func_num = 0;
+    for (int i = 0; i < event_num; ++i)
+        if (events[i].func)
+            funcs[func_num++] = events[i];
+    qsort(funcs, func_num, sizeof(struct StatEvent), slower_event);
+    if (func_num > 0)
+        fprintf(stderr, "\n%-20s %12s %14s\n", "function", "ms", "bytes");
+    for (int i = 0; i < func_num && i < STATS_TOP_FUNCS; ++i)
+        fprintf(stderr, "%-20s %12.3f %14llu\n", funcs[i].name, funcs[i].dur / 1e6, (unsigned long long)funcs[i].bytes);
+    if (func_num > STATS_TOP_FUNCS)
+        fprintf(stderr, "(%d more functions in the trace)\n", func_num - STATS_TOP_FUNCS);
+    free(funcs);
+
+    fprintf(stderr, "\n%-20s %12s\n", "counter", "count");
+    for (int k = 0; k < COUNT_NUM; ++k)
+        fprintf(stderr, "%-20s %12llu\n", counter_names[k], (unsigned long long)totals[k]);
+}
+
+//write the spans as complete events and the counters as one counter event, times in microseconds from the first span
+static bool write_trace(const char* filename) {
+    struct OutBuf out;
+    char text[256];
+    if (!out_open(&out, filename))
+        return false;
+
+    uint64_t start = event_num > 0 ? events[0].begin : 0, end = start;
+    for (int i = 0; i < event_num; ++i) {
+        if (events[i].begin < start)
+            start = events[i].begin;
+        if (events[i].begin + events[i].dur > end)
+            end = events[i].begin + events[i].dur;
+    }
+
+    out_str(&out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (int i = 0; i < event_num; ++i) {
+        out_str(&out, "{\"name\":\"");
+        out_str(&out, events[i].name);  // names of phases and identifiers of C-- need no escapes
+        snprintf(text, sizeof(text), "\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"bytes\":%llu}},\n",
+            events[i].func ? "function" : "phase", events[i].tid, (events[i].begin - start) / 1e3, events[i].dur / 1e3,
+            (unsigned long long)events[i].bytes);
+        out_str(&out, text);
+    }
+    snprintf(text, sizeof(text), "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"args\":{", (end - start) / 1e3);
+    out_str(&out, text);
+    for (int k = 0; k < COUNT_NUM; ++k) {
+        snprintf(text, sizeof(text), "%s\"%s\":%llu", k ? "," : "", counter_names[k], (unsigned long long)totals[k]);
+        out_str(&out, text);
+    }
+    out_str(&out, "}}\n]}\n");
+    out_close(&out);
+    return true;
+}
+
+/* Interfaces */
+
+//add the counters of the thread to the totals, before the thread ends
+void stats_flush() {
+    if (!stats_enabled)
+        return;
+    for (int k = 0; k < COUNT_NUM; ++k) {
+        if (stat_counts[k] != 0)
+            __atomic_fetch_add(&totals[k], stat_counts[k], __ATOMIC_RELAXED);
+        stat_counts[k] = 0;
+    }
+}
+
+//start a span at arg:mark, arg:thread tells that it does not run the pool, so its bytes are counted by the thread alone
+void stats_begin(struct StatMark* mark, bool thread) {
+    if (!stats_enabled)
+        return;
+    mark->thread = thread;
+    mark->bytes = thread ? stat_counts[COUNT_BYTES] : total_count(COUNT_BYTES);
+    mark->time = now();
+}
+
+//end the span started at arg:mark, adding it to arg:phase
+void stats_end(const struct StatMark* mark, enum StatPhase phase) {
+    if (!stats_enabled)
+        return;
+    uint64_t end = now();
+    __atomic_fetch_add(&phase_time[phase], end - mark->time, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&phase_bytes[phase], bytes_since(mark), __ATOMIC_RELAXED);
+    add_event(phase_names[phase], false, mark, end);
+}
+
+//end the span started at arg:mark, which assembled the function arg:name
+void stats_func(const struct StatMark* mark, const char* name) {
+    if (!stats_enabled)
+        return;
+    add_event(name, true, mark, now());
+}
+
+//print the table to stderr and write the trace to arg:filename, after every worker ended
+//return false if the trace cannot be written, errno tells why
+bool stats_report(const char* filename) {
+    stats_flush();
+    print_table();
+    return write_trace(filename);
+}
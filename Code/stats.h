@@ -0,0 +1,50 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* instrumentation of compiles, enabled by "parser -stats trace" */
+/* phases record their wall time and allocated bytes, the backend records the time of each function */
+/* hot paths bump counters of their thread, which are added to the totals when a pool worker ends */
+/* the results are printed as a table to stderr and written as a Chrome trace_event file */
+
+enum StatPhase { // Definitions of phases of a compile
+    PHASE_PARSE,                        //lexing and parsing, yyparse or parse_chunks
+    PHASE_SEMANTIC,                     //semantic_parse
+    PHASE_TRANSLATE,                    //translate_semantic
+    PHASE_EXPORT,                       //export_code, writing the ir code with -ir
+    PHASE_SPLIT,                        //split_blocks, summed over the functions
+    PHASE_ASSEMBLE,                     //assemble, the functions in parallel
+    PHASE_NUM
+};
+
+enum StatCounter { // Definitions of hot-path counters
+    COUNT_CHECK_ID,                     //node kinds compared by CHECK_ID
+    COUNT_SYMBOL_PROBE,                 //slots of the symbol table visited by search_symbol
+    COUNT_ADD_CODE,                     //ir codes added by add_code
+    COUNT_SPILL,                        //registers spilled by the assembler
+    COUNT_LOAD,                         //loads emitted by the assembler
+    COUNT_BYTES,                        //bytes allocated from the arenas and the tree pools
+    COUNT_NUM
+};
+
+struct StatMark { // Definition of the start of a measured span
+    uint64_t time;                      //nanoseconds of the monotonic clock
+    uint64_t bytes;                     //COUNT_BYTES of the thread, or of the process if the span runs the pool
+    bool thread;                        //the span runs on one thread
+};
+
+extern bool stats_enabled;              //set before any thread starts, read by all of them
+extern __thread uint64_t stat_counts[COUNT_NUM];
+
+#define STAT_ADD(counter, n) ((void)(stats_enabled && (stat_counts[counter] += (n))))
+#define STAT_COUNT(counter) STAT_ADD(counter, 1)
+
+void stats_flush();
+void stats_begin(struct StatMark* mark, bool thread);
+void stats_end(const struct StatMark* mark, enum StatPhase phase);
+void stats_func(const struct StatMark* mark, const char* name);
+bool stats_report(const char* filename);
+
+#endif
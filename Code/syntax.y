@@ -1,23 +1,34 @@
 %{
     #include <stdio.h>
+    #include "node.h"
     #include "lex.yy.c"
+    #include "diag.h"
 
     #define YYERROR_VERBOSE
 
     //extern struct Node;
 
-    extern struct Node* create_node(bool type, char* id, int lineno, const char* info);
-    extern void insert(struct Node* dest, struct Node* src);
-    extern void combine(struct Node* dest, int number, ...);
-
     void yyerror(const char *s);
 
-    struct Node* syntax_tree = NULL;
+    __thread NodeRef syntax_tree = NULL_NODE; //root built by the last yyparse of the thread
+    __thread int syntax_errors = 0;     //syntax errors met by the parsers of the thread
+    __thread bool quiet_syntax = false; //count syntax errors without reporting them, for chunks which are parsed again on errors
+    __thread void (*extdef_hook)(NodeRef vertex, struct TreeMark mark) = NULL; //if set, each reduced ExtDef is passed to it with the pools before it, and released instead of kept in the tree
+
+    static __thread struct TreeMark extdef_mark; //pools before the ExtDef being reduced
 %}
 
 %locations
+%define api.pure
+
+%code provides {
+    /* the parser keeps its state on the stack, the scanners pass each token by these to yylex */
+    extern __thread YYSTYPE yylval;
+    extern __thread YYLTYPE yylloc;
+    int yylex(YYSTYPE* lval, YYLTYPE* lloc);
+}
 
-%define api.value.type { struct Node * }
+%define api.value.type { NodeRef }
 
 /* declared tokens */
 %token INT FLOAT ID
@@ -48,260 +59,238 @@
 
 /* High-level Definitions */
 Program : ExtDefList {
-    $$ = create_node(GRAM_U, "Program", @$.first_line, "");
-    insert($$, $1);
+    close_list($1);
+    $$ = create_node(NK_Program, @$.first_line, 1, $1);
     syntax_tree = $$;
 }
     ;
-ExtDefList : ExtDef ExtDefList {
-    $$ = create_node(GRAM_U, "ExtDefList", @$.first_line, "");
-    combine($$, 2, $1, $2);
+ExtDefList : ExtDefList ExtDef {
+    $$ = $1;
+    if (extdef_hook != NULL) {
+        extdef_hook($2, extdef_mark);
+        if (yychar == YYEMPTY) {    // otherwise a lookahead token may be stored behind the mark, and is kept with the next ExtDef
+            release_tree(extdef_mark);
+            extdef_mark = mark_tree();
+        }
+    }
+    else
+        list_append($$, $2);
+}
+    | {
+    $$ = open_list(NK_ExtDefList, @$.first_line);
+    extdef_mark = mark_tree();
 }
-    | {$$ = create_node(GRAM_U, "ExtDefList", @$.first_line, "");}
     ; 
 ExtDef : Specifier ExtDecList SEMI {
-    $$ = create_node(GRAM_U, "ExtDef", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_ExtDef, @$.first_line, 3, $1, $2, $3);
 }
     | Specifier SEMI {
-    $$ = create_node(GRAM_U, "ExtDef", @$.first_line, "");
-    combine($$, 2, $1, $2);
+    $$ = create_node(NK_ExtDef, @$.first_line, 2, $1, $2);
 }
     | Specifier FunDec CompSt {
-    $$ = create_node(GRAM_U, "ExtDef", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_ExtDef, @$.first_line, 3, $1, $2, $3);
 }
     | Specifier FunDec SEMI {
-    $$ = create_node(GRAM_U, "ExtDef", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_ExtDef, @$.first_line, 3, $1, $2, $3);
 }
     ;
 ExtDecList : VarDec {
-    $$ = create_node(GRAM_U, "ExtDecList", @$.first_line, "");
-    insert($$, $1);
+    $$ = create_node(NK_ExtDecList, @$.first_line, 1, $1);
 }
     | VarDec COMMA ExtDecList {
-    $$ = create_node(GRAM_U, "ExtDecList", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_ExtDecList, @$.first_line, 3, $1, $2, $3);
 }
     ;
 
 /* Specifiers */
 Specifier : TYPE {
-    $$ = create_node(GRAM_U, "Specifier", @$.first_line, "");
-    insert($$, $1);
+    $$ = create_node(NK_Specifier, @$.first_line, 1, $1);
 }
     | StructSpecifier {
-    $$ = create_node(GRAM_U, "Specifier", @$.first_line, "");
-    insert($$, $1);
+    $$ = create_node(NK_Specifier, @$.first_line, 1, $1);
 }
     ;
 StructSpecifier : STRUCT OptTag LC DefList RC {
-    $$ = create_node(GRAM_U, "StructSpecifier", @$.first_line, "");
-    combine($$, 5, $1, $2, $3, $4, $5);
+    close_list($4);
+    $$ = create_node(NK_StructSpecifier, @$.first_line, 5, $1, $2, $3, $4, $5);
 }
     | STRUCT Tag {
-    $$ = create_node(GRAM_U, "StructSpecifier", @$.first_line, "");
-    combine($$, 2, $1, $2);
+    $$ = create_node(NK_StructSpecifier, @$.first_line, 2, $1, $2);
 }
     ;
 OptTag : ID {
-    $$ = create_node(GRAM_U, "OptTag", @$.first_line, "");
-    insert($$, $1);
+    $$ = create_node(NK_OptTag, @$.first_line, 1, $1);
 }
-    | {$$ = create_node(GRAM_U, "OptTag", @$.first_line, "");}
+    | {$$ = create_node(NK_OptTag, @$.first_line, 0);}
     ;
 Tag : ID {
-    $$ = create_node(GRAM_U, "Tag", @$.first_line, "");
-    insert($$, $1);
+    $$ = create_node(NK_Tag, @$.first_line, 1, $1);
 }
     ;
 
 /* Declarators */
 VarDec : ID {
-    $$ = create_node(GRAM_U, "VarDec", @$.first_line, "");
-    insert($$, $1);
+    $$ = create_node(NK_VarDec, @$.first_line, 1, $1);
 }
     | VarDec LB INT RB {
-    $$ = create_node(GRAM_U, "VarDec", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_VarDec, @$.first_line, 3, $1, $2, $3);
 }
     ;
 FunDec : ID LP VarList RP {
-    $$ = create_node(GRAM_U, "FunDec", @$.first_line, "");
-    combine($$, 4, $1, $2, $3, $4);
+    close_list($3);
+    $$ = create_node(NK_FunDec, @$.first_line, 4, $1, $2, $3, $4);
 }
     | ID LP RP {
-    $$ = create_node(GRAM_U, "FunDec", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_FunDec, @$.first_line, 3, $1, $2, $3);
 }
     ;
-VarList : ParamDec COMMA VarList {
-    $$ = create_node(GRAM_U, "VarList", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+VarList : VarList COMMA ParamDec {
+    $$ = $1;
+    list_append($$, $2);
+    list_append($$, $3);
 }
     | ParamDec {
-    $$ = create_node(GRAM_U, "VarList", @$.first_line, "");
-    insert($$, $1);
+    $$ = open_list(NK_VarList, @$.first_line);
+    list_append($$, $1);
 }
     ;
 ParamDec : Specifier VarDec {
-    $$ = create_node(GRAM_U, "ParamDec", @$.first_line, "");
-    combine($$, 2, $1, $2);
+    $$ = create_node(NK_ParamDec, @$.first_line, 2, $1, $2);
 }
     ;
 
 /* Statements */
 CompSt : LC DefList StmtList RC {
-    $$ = create_node(GRAM_U, "CompSt", @$.first_line, "");
-    combine($$, 4, $1, $2, $3, $4);
+    close_list($3);     // the list opened last is closed first
+    close_list($2);
+    $$ = create_node(NK_CompSt, @$.first_line, 4, $1, $2, $3, $4);
 }
     ;
-StmtList : Stmt StmtList {
-    $$ = create_node(GRAM_U, "StmtList", @$.first_line, "");
-    combine($$, 2, $1, $2);
+StmtList : StmtList Stmt {
+    $$ = $1;
+    list_append($$, $2);
 }
-    |  { $$ = create_node(GRAM_U, "StmtList", @$.first_line, ""); }
+    |  { $$ = open_list(NK_StmtList, @$.first_line); }
     ;
 Stmt : Exp SEMI {
-    $$ = create_node(GRAM_U, "Stmt", @$.first_line, "");
-    combine($$, 2, $1, $2);
+    $$ = create_node(NK_Stmt, @$.first_line, 2, $1, $2);
 }
     | CompSt {
-    $$ = create_node(GRAM_U, "Stmt", @$.first_line, "");
-    insert($$, $1);
+    $$ = create_node(NK_Stmt, @$.first_line, 1, $1);
 }
     | RETURN Exp SEMI {
-    $$ = create_node(GRAM_U, "Stmt", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_Stmt, @$.first_line, 3, $1, $2, $3);
 }
     | IF LP Exp RP Stmt %prec LOWER_THAN_ELSE {
-    $$ = create_node(GRAM_U, "Stmt", @$.first_line, "");
-    combine($$, 5, $1, $2, $3, $4, $5);
+    $$ = create_node(NK_Stmt, @$.first_line, 5, $1, $2, $3, $4, $5);
 }
     | IF LP Exp RP Stmt ELSE Stmt {
-    $$ = create_node(GRAM_U, "Stmt", @$.first_line, "");
-    combine($$, 7, $1, $2, $3, $4, $5, $6, $7);
+    $$ = create_node(NK_Stmt, @$.first_line, 7, $1, $2, $3, $4, $5, $6, $7);
 }
     | WHILE LP Exp RP Stmt {
-    $$ = create_node(GRAM_U, "Stmt", @$.first_line, "");
-    combine($$, 5, $1, $2, $3, $4, $5);
+    $$ = create_node(NK_Stmt, @$.first_line, 5, $1, $2, $3, $4, $5);
 }
     ;
 
 /* Local Definitions */
-DefList : Def DefList {
-    $$ = create_node(GRAM_U, "DefList", @$.first_line, "");
-    combine($$, 2, $1, $2);
+DefList : DefList Def {
+    $$ = $1;
+    list_append($$, $2);
 }
-    | { $$ = create_node(GRAM_U, "DefList", @$.first_line, ""); }
+    | { $$ = open_list(NK_DefList, @$.first_line); }
     ;
 Def : Specifier DecList SEMI {
-    $$ = create_node(GRAM_U, "Def", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_Def, @$.first_line, 3, $1, $2, $3);
 }
     ;
 DecList : Dec {
-    $$ = create_node(GRAM_U, "DecList", @$.first_line, "");
-    insert($$, $1);
+    $$ = create_node(NK_DecList, @$.first_line, 1, $1);
 }
     | Dec COMMA DecList {
-    $$ = create_node(GRAM_U, "DecList", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_DecList, @$.first_line, 3, $1, $2, $3);
 }
     ;
 Dec : VarDec {
-    $$ = create_node(GRAM_U, "Dec", @$.first_line, "");
-    insert($$, $1);
+    $$ = create_node(NK_Dec, @$.first_line, 1, $1);
 }
     | VarDec ASSIGNOP Exp {
-    $$ = create_node(GRAM_U, "Dec", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_Dec, @$.first_line, 3, $1, $2, $3);
 }
     ;
 
 /* Expressions */
 Exp : ID {
-    $$ = create_node(GRAM_U, "Exp", @$.first_line, "");
-    insert($$, $1);
+    $$ = create_node(NK_Exp, @$.first_line, 1, $1);
 }
     | INT {
-    $$ = create_node(GRAM_U, "Exp", @$.first_line, "");
-    insert($$, $1);
+    $$ = create_node(NK_Exp, @$.first_line, 1, $1);
 }
     | FLOAT {
-    $$ = create_node(GRAM_U, "Exp", @$.first_line, "");
-    insert($$, $1);
+    $$ = create_node(NK_Exp, @$.first_line, 1, $1);
 }
     | Exp ASSIGNOP Exp {
-    $$ = create_node(GRAM_U, "Exp", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_Exp, @$.first_line, 3, $1, $2, $3);
 }
     | Exp AND Exp {
-    $$ = create_node(GRAM_U, "Exp", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_Exp, @$.first_line, 3, $1, $2, $3);
 }
     | Exp OR Exp {
-    $$ = create_node(GRAM_U, "Exp", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_Exp, @$.first_line, 3, $1, $2, $3);
 }
     | Exp RELOP Exp {
-    $$ = create_node(GRAM_U, "Exp", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_Exp, @$.first_line, 3, $1, $2, $3);
 }
     | Exp PLUS Exp {
-    $$ = create_node(GRAM_U, "Exp", @$.first_line, "");    
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_Exp, @$.first_line, 3, $1, $2, $3);
 }
     | Exp MINUS Exp {
-    $$ = create_node(GRAM_U, "Exp", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_Exp, @$.first_line, 3, $1, $2, $3);
 }
     | Exp STAR Exp {
-    $$ = create_node(GRAM_U, "Exp", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_Exp, @$.first_line, 3, $1, $2, $3);
 }
     | Exp DIV Exp {
-    $$ = create_node(GRAM_U, "Exp", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_Exp, @$.first_line, 3, $1, $2, $3);
 }
     | LP Exp RP {
-    $$ = create_node(GRAM_U, "Exp", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_Exp, @$.first_line, 3, $1, $2, $3);
 }
     | MINUS Exp {
-    $$ = create_node(GRAM_U, "Exp", @$.first_line, "");
-    combine($$, 2, $1, $2);
+    $$ = create_node(NK_Exp, @$.first_line, 2, $1, $2);
 }
     | NOT Exp {
-    $$ = create_node(GRAM_U, "Exp", @$.first_line, "");
-    combine($$, 2, $1, $2);
+    $$ = create_node(NK_Exp, @$.first_line, 2, $1, $2);
 }
     | ID LP Args RP {
-    $$ = create_node(GRAM_U, "Exp", @$.first_line, "");
-    combine($$, 4, $1, $2, $3, $4);
+    $$ = create_node(NK_Exp, @$.first_line, 4, $1, $2, $3, $4);
 }
     | ID LP RP {
-    $$ = create_node(GRAM_U, "Exp", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_Exp, @$.first_line, 3, $1, $2, $3);
 }
     | Exp LB Exp RB {
-    $$ = create_node(GRAM_U, "Exp", @$.first_line, ""); 
-    combine($$, 4, $1, $2, $3, $4);
+    $$ = create_node(NK_Exp, @$.first_line, 4, $1, $2, $3, $4);
 }
     | Exp DOT ID {
-    $$ = create_node(GRAM_U, "Exp", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_Exp, @$.first_line, 3, $1, $2, $3);
 }
     ;
 Args : Exp COMMA Args {
-    $$ = create_node(GRAM_U, "Args", @$.first_line, "");
-    combine($$, 3, $1, $2, $3);
+    $$ = create_node(NK_Args, @$.first_line, 3, $1, $2, $3);
 }
     | Exp {
-    $$ = create_node(GRAM_U, "Args", @$.first_line, "");
-    insert($$, $1);
+    $$ = create_node(NK_Args, @$.first_line, 1, $1);
 }
     ;
 
-%%
\ No newline at end of file
+%%
+
+//report a syntax error to stderr as liby does, or keep it in diag_log for the library
+void yyerror(const char *s) {
+    ++syntax_errors;
+    if (quiet_syntax)
+        return;
+    if (diag_log != NULL)
+        diag_add(CMM_SYNTAX, 0, yylloc.first_line, "%s", s);
+    else
+        fprintf(stderr, "%s\n", s);
+}
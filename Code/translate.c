@@ -1,16 +1,16 @@
 #include "sparse.h"
 #include "ircode.h"
+#include "diag.h"
 
 #define ARGNUM 20
 
-extern struct SymbolTableItem* symbol_table[TABLE_SIZE]; //a hash table
 
-unsigned int var_count = 1;
-unsigned int tmp_count = 1;
-unsigned int label_count = 1;
+__thread unsigned int var_count = 1; //the counters and symbols below are kept by the thread translating the program
+__thread unsigned int tmp_count = 1;
+__thread unsigned int label_count = 1;
 
-char ZERO[10] = "#0";
-char ONE[10] = "#1";
+const struct Operand ZERO = { OPD_IMM, OM_NONE, { 0 } };
+const struct Operand ONE = { OPD_IMM, OM_NONE, { 1 } };
 char READ[10] = "READ";
 char WRITE[10] = "WRITE";
 char CALL[10] = "CALL";
@@ -21,53 +21,59 @@ char LABEL[10] = "LABEL";
 char IF[10] = "IF";
 char GOTO[10] = "GOTO";
 
-static struct Symbol *paralist[ARGNUM]; // paramdec list
+static __thread struct Symbol *paralist[ARGNUM]; // paramdec list
 
-static char *structlist[ARGNUM]; // search Node struct to get offset directly
-int struct_label = 0;
+static __thread char *read_name, *write_name; // interned names of built-in functions
+
+static __thread struct Symbol *checked_symbol = NULL; // symbols added up to it are known to be legal, in streaming translation
+static __thread bool stream_legal = true; // false once translate_stream met an illegal symbol
+
+static const char *illegal_msg = "Cannot translate: Code contains variables of multi-dimensional array type or parameters of array type.";
 
 /* functions */
 
-int space_create(struct Type *t);
-void int_to_char(int num, char* dst); 
-char *new_var(char *name);
-char *new_tmp();
-char *new_label();
-char *new_imm(char *src);
-int part_offset(struct FieldList *p, char *name);
-int total_offset(char *name); 
-bool in_paralist(char *name);
-int use_addr(struct Node *vertex);
-bool legal_to_output();
-char *num2imm(int n);
-void add_ch(char *dst, char ch);
+struct Operand new_var(struct Symbol *p);
+struct Operand new_tmp();
+struct Operand new_label();
+struct Operand new_imm(char *src);
+struct Operand new_func(char *name);
+bool in_paralist(struct Symbol *p);
+bool legal_symbol(struct Symbol *s);
+struct Operand num2imm(int n);
+void add_modifier(struct Operand *dst, enum OPERAND_MODIFIER modifier);
 
 /* translate function declaration */
 
-void translate_semantic(struct Node *root);
-void translate_init();
-void translate_visit(struct Node *vertex);
-void translate_ExtDef(struct Node *vertex);
-void translate_FunDec(struct Node *vertex);
-void translate_CompSt(struct Node *vertex);
-void translate_Def(struct Node *vertex);
-void translate_DefList(struct Node *vertex);
-void translate_Dec(struct Node *vertex);
-void translate_DecList(struct Node *vertex);
-void translate_Stmt(struct Node *vertex);
-void translate_StmtList(struct Node *vertex);
-void translate_VarList(struct Node *vertex);
-void translate_ParamDec(struct Node *vertex);
-void translate_Exp(struct Node *vertex, char *place);
-void translate_Args(struct Node *vertex, char *a[], int type[], int *k);
-void translate_VarDec(struct Node *vertex);
-void get_structlist(struct Node *vertex);
-void translate_Cond(struct Node *vertex, char *label_true, char *label_false);
+void translate_visit(NodeRef vertex);
+void translate_FunDec(NodeRef vertex);
+void translate_CompSt(NodeRef vertex);
+void translate_Def(NodeRef vertex);
+void translate_DefList(NodeRef vertex);
+void translate_Dec(NodeRef vertex);
+void translate_DecList(NodeRef vertex);
+void translate_Stmt(NodeRef vertex);
+void translate_StmtList(NodeRef vertex);
+void translate_VarList(NodeRef vertex);
+void translate_ParamDec(NodeRef vertex);
+void translate_Exp(NodeRef vertex, struct Operand *place);
+void translate_Args(NodeRef vertex, struct Operand a[], int type[], int *k);
+void translate_VarDec(NodeRef vertex);
+void translate_Cond(NodeRef vertex, struct Operand *label_true, struct Operand *label_false);
 
 /* function definition */
 
-void translate_semantic(struct Node *root) {
-    SAFE_ID(root, "Program");
+// print that the program cannot be translated, or keep it in diag_log for the library
+static void report_illegal() {
+    if(diag_log != NULL) {
+        diag_add(CMM_TRANSLATE, 0, 0, "%s", illegal_msg);
+    }
+    else {
+        printf("%s \n", illegal_msg);
+    }
+}
+
+void translate_semantic(NodeRef root) {
+    SAFE_ID(root, NK_Program);
 
     translate_init();
 
@@ -75,63 +81,91 @@ void translate_semantic(struct Node *root) {
         translate_visit(root);
     }
     else {
-        printf("Cannot translate: Code contains variables of multi-dimensional array type or parameters of array type. \n");
+        report_illegal();
     }    
 }
 
+// translate the ExtDef arg:vertex as soon as it is analysed, after translate_init
+// only the symbols added so far are checked, nothing is translated after an illegal one
+void translate_stream(NodeRef vertex) {
+    SAFE_ID(vertex, NK_ExtDef);
+    if(!stream_legal) {
+        return;
+    }
+
+    for(struct Symbol *s = latest_symbol(); s != checked_symbol; s = s->older) {
+        if(!legal_symbol(s)) {
+            stream_legal = false;
+        }
+    }
+    checked_symbol = latest_symbol();
+
+    if(stream_legal) {
+        translate_ExtDef(vertex);
+    }
+    else {
+        report_illegal();
+    }
+}
+
 void translate_init() {
-    memset(structlist, 0, sizeof(structlist));
+    tmp_count = 1;
+    label_count = 1;
+    checked_symbol = NULL;
+    stream_legal = true;
+    read_name = intern_str("read");
+    write_name = intern_str("write");
 }
 
-void translate_visit(struct Node *vertex) { 
-    if (CHECK_ID(vertex, "ExtDef")) {   
+void translate_visit(NodeRef vertex) { 
+    if (CHECK_ID(vertex, NK_ExtDef)) {   
         translate_ExtDef(vertex);
     }
     else {
         int ptr = 0;
-        while (ptr < MAX_CHILDS && vertex->childs[ptr] != NULL) {
-            translate_visit(vertex->childs[ptr]);
+        while (ptr < node_childs(vertex)) {
+            translate_visit(node_child(vertex, ptr));
             ptr ++;
         }
     }
 }
 
-void translate_ExtDef(struct Node *vertex) {       
-    SAFE_ID(vertex, "ExtDef");
+void translate_ExtDef(NodeRef vertex) {       
+    SAFE_ID(vertex, NK_ExtDef);
 
-    if (CHECK_ID(vertex->childs[1], "FunDec") && 
-        (CHECK_ID(vertex->childs[2], "CompSt"))) {  
-        translate_FunDec(vertex->childs[1]);
-        translate_CompSt(vertex->childs[2]);
+    if (CHECK_ID(node_child(vertex, 1), NK_FunDec) && 
+        (CHECK_ID(node_child(vertex, 2), NK_CompSt))) {  
+        translate_FunDec(node_child(vertex, 1));
+        translate_CompSt(node_child(vertex, 2));
     }
 }
 
-void translate_FunDec(struct Node *vertex) {
-    SAFE_ID(vertex, "FunDec");
-    //printf("FUNCTION %s :\n", vertex->childs[0]->info);
-    add_code(OT_FUNC, vertex->childs[0]->info, NULL, NULL, NULL);
+void translate_FunDec(NodeRef vertex) {
+    SAFE_ID(vertex, NK_FunDec);
+    //printf("FUNCTION %s :\n", node_text(node_child(vertex, 0)));
+    struct Operand func = new_func(node_text(node_child(vertex, 0)));
+    add_code(OT_FUNC, &func, NULL, NULL, 0);
     memset(paralist, 0, sizeof(paralist)); // initialize paralist when each function begins
 
-    if(CHECK_ID(vertex->childs[2], "VarList")) {
-        translate_VarList(vertex->childs[2]);
+    if(CHECK_ID(node_child(vertex, 2), NK_VarList)) {
+        translate_VarList(node_child(vertex, 2));
     }
 }
 
-void translate_VarList(struct Node *vertex) {   
-    SAFE_ID(vertex, "VarList");
-    translate_ParamDec(vertex->childs[0]);
-    if(vertex->childs[2] != NULL) {
-        translate_VarList(vertex->childs[2]);
+void translate_VarList(NodeRef vertex) {   
+    SAFE_ID(vertex, NK_VarList);
+    for(int i = 0;i < node_childs(vertex);i += 2) {     // ParamDec and COMMA take turns
+        translate_ParamDec(node_child(vertex, i));
     }
 }
 
-void translate_ParamDec(struct Node *vertex) {
-    SAFE_ID(vertex, "ParamDec");
-    SAFE_ID(vertex->childs[1], "VarDec");
-    if(CHECK_ID(vertex->childs[1]->childs[0], "ID")) { // ID 
-        char *dst = new_var(vertex->childs[1]->childs[0]->info);
-        add_code(OT_PARAM, dst, NULL, NULL, NULL);
-        struct Symbol *p = search_symbol(vertex->childs[1]->childs[0]->info);
+void translate_ParamDec(NodeRef vertex) {
+    SAFE_ID(vertex, NK_ParamDec);
+    SAFE_ID(node_child(vertex, 1), NK_VarDec);
+    if(CHECK_ID(node_child(node_child(vertex, 1), 0), NK_ID)) { // ID 
+        struct Symbol *p = node_attr(node_child(vertex, 1)).symbol;
+        struct Operand dst = new_var(p);
+        add_code(OT_PARAM, &dst, NULL, NULL, 0);
         if(p->type->kind == STRUCTURE) {    // store structure for using v2　directly instead of &v2
             int i = 0;
             for(;i < ARGNUM && paralist[i] != NULL;i++);
@@ -149,77 +183,73 @@ void translate_ParamDec(struct Node *vertex) {
     }
 }
 
-void translate_CompSt(struct Node *vertex) {
-    SAFE_ID(vertex, "CompSt");
-    translate_DefList(vertex->childs[1]);
-    translate_StmtList(vertex->childs[2]);
+void translate_CompSt(NodeRef vertex) {
+    SAFE_ID(vertex, NK_CompSt);
+    translate_DefList(node_child(vertex, 1));
+    translate_StmtList(node_child(vertex, 2));
 }
 
-void translate_Def(struct Node *vertex) {
-    SAFE_ID(vertex, "Def");
-    translate_DecList(vertex->childs[1]);
+void translate_Def(NodeRef vertex) {
+    SAFE_ID(vertex, NK_Def);
+    translate_DecList(node_child(vertex, 1));
 }
 
-void translate_DefList(struct Node *vertex) {
-    SAFE_ID(vertex, "DefList");
-    if(CHECK_ID(vertex->childs[0], "Def")) {
-        translate_Def(vertex->childs[0]);
-        translate_DefList(vertex->childs[1]);
+void translate_DefList(NodeRef vertex) {
+    SAFE_ID(vertex, NK_DefList);
+    for(int i = 0;i < node_childs(vertex);i++) {
+        translate_Def(node_child(vertex, i));
     }
 }
 
-void translate_DecList(struct Node *vertex) {
-    SAFE_ID(vertex, "DecList");
-    translate_Dec(vertex->childs[0]);
-    if(CHECK_ID(vertex->childs[1], "COMMA")) {
-        translate_DecList(vertex->childs[2]);
+void translate_DecList(NodeRef vertex) {
+    SAFE_ID(vertex, NK_DecList);
+    translate_Dec(node_child(vertex, 0));
+    if(CHECK_ID(node_child(vertex, 1), NK_COMMA)) {
+        translate_DecList(node_child(vertex, 2));
     }
 }
 
-void translate_Dec(struct Node *vertex) {
-    SAFE_ID(vertex, "Dec");  
-    if(CHECK_ID(vertex->childs[1], "ASSIGNOP")) {
+void translate_Dec(NodeRef vertex) {
+    SAFE_ID(vertex, NK_Dec);  
+    if(CHECK_ID(node_child(vertex, 1), NK_ASSIGNOP)) {
 
-        translate_VarDec(vertex->childs[0]);    // malloc space for array and structure
+        translate_VarDec(node_child(vertex, 0));    // malloc space for array and structure
 
-        if(CHECK_ID(vertex->childs[0]->childs[0], "ID")) {
-            char *dst = new_var(vertex->childs[0]->childs[0]->info);
-            char *src = new_tmp();
-            translate_Exp(vertex->childs[2],src);
-            int type = use_addr(vertex->childs[2]);
+        if(CHECK_ID(node_child(node_child(vertex, 0), 0), NK_ID)) {
+            struct Operand dst = new_var(node_attr(node_child(vertex, 0)).symbol);
+            struct Operand src = new_tmp();
+            translate_Exp(node_child(vertex, 2), &src);
+            int type = node_attr(node_child(vertex, 2)).addr;
             if(type == ARRAY || type == STRUCTURE) {    
                 //printf("%s := *%s \n", dst, src);
-                add_ch(src, '*');
+                add_modifier(&src, OM_DEREF);
             }
             else {
                 //printf("%s := %s \n", dst, src); 
             }
-            add_code(OT_ASSIGN, dst, src, NULL, NULL);
+            add_code(OT_ASSIGN, &dst, &src, NULL, 0);
         }
         else {
             panic("not allow array or structure initialized when defined !!");
         }
     }
     else {
-        translate_VarDec(vertex->childs[0]);
+        translate_VarDec(node_child(vertex, 0));
     }
 }
 
-void translate_VarDec(struct Node *vertex) {
-    SAFE_ID(vertex, "VarDec");
-    if(CHECK_ID(vertex->childs[0], "ID")) {
-        struct Symbol *p = search_symbol(vertex->childs[0]->info);
+void translate_VarDec(NodeRef vertex) {
+    SAFE_ID(vertex, NK_VarDec);
+    if(CHECK_ID(node_child(vertex, 0), NK_ID)) {
+        struct Symbol *p = node_attr(vertex).symbol;
         if(p->kind == VAR) {
             struct Type *t = p->type;
-            int space = space_create(t);            // dec space for array and structure
             if((t->kind == ARRAY && t->array.elem_type->kind == BASIC) || t->kind == STRUCTURE) {
-                int space = space_create(t);
-                char *src = new_var(vertex->childs[0]->info);
-                //printf("%s %s %d \n", DEC, src, space);
+                struct Operand src = new_var(p);
+                //printf("%s %s %d \n", DEC, src, t->size);
 
-                char *space_char = (char *)malloc(sizeof(char)*ARGNUM);
-                int_to_char(space, space_char);
-                add_code(OT_DEC, src, space_char, NULL, NULL);
+                struct Operand size = { OPD_SIZE, OM_NONE, { t->size } };    // dec space for array and structure
+                add_code(OT_DEC, &src, &size, NULL, 0);
             }
             else if(t->kind == ARRAY && t->array.elem_type->kind != BASIC) {
                 panic("impossible vardec !!\n");
@@ -227,146 +257,137 @@ void translate_VarDec(struct Node *vertex) {
         }
     }
     else {
-        translate_VarDec(vertex->childs[0]);
+        translate_VarDec(node_child(vertex, 0));
     }
 }
 
-void translate_StmtList(struct Node *vertex) {
-    SAFE_ID(vertex, "StmtList");
-    if(vertex->childs[0] != NULL) {
-        translate_Stmt(vertex->childs[0]);
-        translate_StmtList(vertex->childs[1]);
+void translate_StmtList(NodeRef vertex) {
+    SAFE_ID(vertex, NK_StmtList);
+    for(int i = 0;i < node_childs(vertex);i++) {
+        translate_Stmt(node_child(vertex, i));
     }
 }
 
-void translate_Stmt(struct Node *vertex) {
-    SAFE_ID(vertex, "Stmt");
-    if (CHECK_ID(vertex->childs[0], "RETURN")) {
-        char *src = new_tmp();
-        translate_Exp(vertex->childs[1], src);
-        int type = use_addr(vertex->childs[1]);
+void translate_Stmt(NodeRef vertex) {
+    SAFE_ID(vertex, NK_Stmt);
+    if (CHECK_ID(node_child(vertex, 0), NK_RETURN)) {
+        struct Operand src = new_tmp();
+        translate_Exp(node_child(vertex, 1), &src);
+        int type = node_attr(node_child(vertex, 1)).addr;
         if(type == VAR) {
             //printf("%s %s \n", RETURN, src);
 
-            add_code(OT_RET, src, NULL, NULL, NULL);
+            add_code(OT_RET, &src, NULL, NULL, 0);
         }
         else {
             //printf("%s *%s \n", RETURN, src);
 
-            add_ch(src, '*');
-            add_code(OT_RET, src, NULL, NULL, NULL);
+            add_modifier(&src, OM_DEREF);
+            add_code(OT_RET, &src, NULL, NULL, 0);
         }
     }
-    else if (CHECK_ID(vertex->childs[0], "CompSt")) {
-        translate_CompSt(vertex->childs[0]);
+    else if (CHECK_ID(node_child(vertex, 0), NK_CompSt)) {
+        translate_CompSt(node_child(vertex, 0));
     }
-    else if (CHECK_ID(vertex->childs[2], "Exp")) { 
-        if(CHECK_ID(vertex->childs[0], "IF") && !CHECK_ID(vertex->childs[6], "Stmt")) { // if
-            char *label_true = new_label();
-            char *label_false = new_label();
-            translate_Cond(vertex->childs[2], label_true, label_false); // code of cond exp
+    else if (CHECK_ID(node_child(vertex, 2), NK_Exp)) { 
+        if(CHECK_ID(node_child(vertex, 0), NK_IF) && !CHECK_ID(node_child(vertex, 6), NK_Stmt)) { // if
+            struct Operand label_true = new_label();
+            struct Operand label_false = new_label();
+            translate_Cond(node_child(vertex, 2), &label_true, &label_false); // code of cond exp
             //printf("%s %s\n", GOTO, label_false);
             //printf("%s %s :\n", LABEL, label_true);
-            add_code(OT_LABEL, label_true, NULL, NULL, NULL);
-            translate_Stmt(vertex->childs[4]); // code of true
+            add_code(OT_LABEL, &label_true, NULL, NULL, 0);
+            translate_Stmt(node_child(vertex, 4)); // code of true
             //printf("%s %s :\n", LABEL, label_false);
-            add_code(OT_LABEL, label_false, NULL, NULL, NULL);
+            add_code(OT_LABEL, &label_false, NULL, NULL, 0);
         }
-        else if (CHECK_ID(vertex->childs[0], "IF") && CHECK_ID(vertex->childs[6], "Stmt")) { // if else
-                char *label_a = new_label();
-                char *label_b = new_label();
-                char *label_c = new_label();
-                // translate_Cond(vertex->childs[2], label_a, label_b);
+        else if (CHECK_ID(node_child(vertex, 0), NK_IF) && CHECK_ID(node_child(vertex, 6), NK_Stmt)) { // if else
+                struct Operand label_a = new_label();
+                struct Operand label_b = new_label();
+                struct Operand label_c = new_label();
+                // translate_Cond(node_child(vertex, 2), label_a, label_b);
                 // printf("%s %s :\n", LABEL, label_a);
                 // add_code(OT_LABEL, label_a, NULL, NULL, NULL);
-                // translate_Stmt(vertex->childs[4]);
+                // translate_Stmt(node_child(vertex, 4));
                 // printf("%s %s \n", GOTO, label_c);
                 // add_code(OT_GOTO, label_c, NULL, NULL, NULL);
                 // printf("%s %s :\n", LABEL, label_b);
                 // add_code(OT_LABEL, label_b, NULL, NULL, NULL);
-                // translate_Stmt(vertex->childs[6]);
+                // translate_Stmt(node_child(vertex, 6));
                 // printf("%s %s :\n", LABEL, label_c);
                 // add_code(OT_LABEL, label_c, NULL, NULL, NULL);
 
-                translate_Cond(vertex->childs[2], label_a, label_b); // code of cond exp
+                translate_Cond(node_child(vertex, 2), &label_a, &label_b); // code of cond exp
                 /* optimized:reduce GOTO stmt */
                 struct CodeListItem* goto_b = end_code();
-                assert(rm_code(goto_b) != NULL);
+                DIAG_ASSERT(rm_code(goto_b) != NULL);
 
-                translate_Stmt(vertex->childs[6]); // code of false
-                add_code(OT_GOTO, label_c, NULL, NULL, NULL);
+                translate_Stmt(node_child(vertex, 6)); // code of false
+                add_code(OT_GOTO, &label_c, NULL, NULL, 0);
 
-                add_code(OT_LABEL, label_a, NULL, NULL, NULL);
-                translate_Stmt(vertex->childs[4]); // code of true
+                add_code(OT_LABEL, &label_a, NULL, NULL, 0);
+                translate_Stmt(node_child(vertex, 4)); // code of true
 
-                add_code(OT_LABEL, label_c, NULL, NULL, NULL);
+                add_code(OT_LABEL, &label_c, NULL, NULL, 0);
         }
         else { // while
-            char *label_a = new_label();
-            char *label_b = new_label();
-            char *label_c = new_label();
-            add_code(OT_LABEL, label_a, NULL, NULL, NULL);
-            translate_Cond(vertex->childs[2], label_b, label_c);
-            add_code(OT_LABEL, label_b, NULL, NULL, NULL);
-            translate_Stmt(vertex->childs[4]);
-            add_code(OT_GOTO, label_a, NULL, NULL, NULL);
-            add_code(OT_LABEL, label_c, NULL, NULL, NULL);
+            struct Operand label_a = new_label();
+            struct Operand label_b = new_label();
+            struct Operand label_c = new_label();
+            add_code(OT_LABEL, &label_a, NULL, NULL, 0);
+            translate_Cond(node_child(vertex, 2), &label_b, &label_c);
+            add_code(OT_LABEL, &label_b, NULL, NULL, 0);
+            translate_Stmt(node_child(vertex, 4));
+            add_code(OT_GOTO, &label_a, NULL, NULL, 0);
+            add_code(OT_LABEL, &label_c, NULL, NULL, 0);
         }
     }
     else { // Exp SEMI
-        translate_Exp(vertex->childs[0],NULL);
+        translate_Exp(node_child(vertex, 0),NULL);
     }
 }
 
-void translate_Exp(struct Node* vertex, char *place) {
-    SAFE_ID(vertex, "Exp");
+void translate_Exp(NodeRef vertex, struct Operand *place) {
+    SAFE_ID(vertex, NK_Exp);
 
-    if (CHECK_ID(vertex->childs[0], "ID") && !CHECK_ID(vertex->childs[1], "LP")) { //Var reference
+    if (CHECK_ID(node_child(vertex, 0), NK_ID) && !CHECK_ID(node_child(vertex, 1), NK_LP)) { //Var reference
         if(place == NULL) return;
-        struct ExpType p = Exp(vertex);
-        int type = p.type->kind;
+        struct NodeAttr p = node_attr(vertex);
+        int type = p.exp.type->kind;
         if(type == VAR) {
-            char *src = new_var(vertex->childs[0]->info);
-            memset(place, 0, sizeof(char)*ARGNUM);
-            strcpy(place, src);
+            *place = new_var(p.symbol);
         }
         else {  
-            bool flag = in_paralist(vertex->childs[0]->info);
-            struct Symbol *p = search_symbol(vertex->childs[0]->info);
-            char *v1 = new_var(vertex->childs[0]->info);
+            bool flag = in_paralist(p.symbol);
+            struct Operand v1 = new_var(p.symbol);
             if(flag) {
                 //printf("%s := %s \n", place, v1);
             }
             else {
                 //printf("%s := &%s \n", place, v1);
-                add_ch(v1, '&');
+                add_modifier(&v1, OM_ADDR);
             }
             //add_code(OT_ASSIGN, place, v1, NULL, NULL);
             //place = v1;
 
-            memset(place, 0, sizeof(char)*ARGNUM);
-            strcpy(place, v1);
+            *place = v1;
         }
     }
-    else if (CHECK_ID(vertex->childs[0], "INT") || CHECK_ID(vertex->childs[0], "FLOAT")) {
+    else if (CHECK_ID(node_child(vertex, 0), NK_INT) || CHECK_ID(node_child(vertex, 0), NK_FLOAT)) {
         if(place == NULL) return;
-        char *tmp = new_imm(vertex->childs[0]->info);   
-
-        memset(place, 0, sizeof(char)*ARGNUM);
-        strcpy(place, tmp);
-    }
-    else if (CHECK_ID(vertex->childs[1], "ASSIGNOP")) {     
-        char *src = new_tmp();
-        char *dst = new_tmp();
-        int left = use_addr(vertex->childs[0]);
-        int right = use_addr(vertex->childs[2]);
-        translate_Exp(vertex->childs[2], src);
+        *place = new_imm(node_text(node_child(vertex, 0)));
+    }
+    else if (CHECK_ID(node_child(vertex, 1), NK_ASSIGNOP)) {     
+        struct Operand src = new_tmp();
+        struct Operand dst = new_tmp();
+        int left = node_attr(node_child(vertex, 0)).addr;
+        int right = node_attr(node_child(vertex, 2)).addr;
+        translate_Exp(node_child(vertex, 2), &src);
         if(left == VAR) {
-            translate_Exp(vertex->childs[0], dst);
-            if (place != NULL && vertex->childs[0] != NULL && (CHECK_ID(vertex->childs[0]->childs[0], "ID"))) {
+            translate_Exp(node_child(vertex, 0), &dst);
+            if (place != NULL && node_child(vertex, 0) != NULL_NODE && (CHECK_ID(node_child(node_child(vertex, 0), 0), NK_ID))) {
                 //printf("cur: %s\n", place);
-                //printf("target: %s\n", new_var(vertex->childs[0]->childs[0]->info));
-                strcpy(place, new_var(vertex->childs[0]->childs[0]->info));
+                *place = new_var(node_attr(node_child(vertex, 0)).symbol);
                 //printf("after: %s\n", place);
             }
 
@@ -375,409 +396,304 @@ void translate_Exp(struct Node* vertex, char *place) {
             }
             else {
                 //printf("%s := *%s \n", dst, src);
-                add_ch(src, '*');
+                add_modifier(&src, OM_DEREF);
             }
         }
         else {
-            translate_Exp(vertex->childs[0], dst);
+            translate_Exp(node_child(vertex, 0), &dst);
             if(right == VAR) {
                 //printf("*%s := %s \n", dst, src);
-                add_ch(dst, '*');
+                add_modifier(&dst, OM_DEREF);
             }
             else {
                 //printf("*%s := *%s \n", dst, src);
-                add_ch(dst, '*');
-                add_ch(src, '*');
+                add_modifier(&dst, OM_DEREF);
+                add_modifier(&src, OM_DEREF);
             }
         }
-        add_code(OT_ASSIGN, dst, src, NULL, NULL);
-        if(place != NULL && strcmp(place, dst)) {
-            add_code(OT_ASSIGN, place, dst, NULL, NULL);
+        add_code(OT_ASSIGN, &dst, &src, NULL, 0);
+        if(place != NULL && !same_operand(place, &dst)) {
+            add_code(OT_ASSIGN, place, &dst, NULL, 0);
         }
     }
-    else if (CHECK_ID(vertex->childs[1], "AND") || CHECK_ID(vertex->childs[1], "OR")
-            || CHECK_ID(vertex->childs[1], "RELOP") || CHECK_ID(vertex->childs[0], "NOT")) {
-        
-        char *label_true = new_label();
-        char *label_false = new_label();
-        add_code(OT_ASSIGN, place, ZERO, NULL, NULL);
-        translate_Cond(vertex, label_true, label_false);
-        add_code(OT_LABEL, label_true, NULL, NULL, NULL);
-        add_code(OT_ASSIGN, place, ONE, NULL, NULL);
-        add_code(OT_LABEL, label_false, NULL, NULL, NULL);
+    else if (CHECK_ID(node_child(vertex, 1), NK_AND) || CHECK_ID(node_child(vertex, 1), NK_OR)
+            || CHECK_ID(node_child(vertex, 1), NK_RELOP) || CHECK_ID(node_child(vertex, 0), NK_NOT)) {
+        struct Operand t;
+        if(place == NULL) {
+            t = new_tmp();
+            place = &t;
+        }
+        struct Operand label_true = new_label();
+        struct Operand label_false = new_label();
+        add_code(OT_ASSIGN, place, &ZERO, NULL, 0);
+        translate_Cond(vertex, &label_true, &label_false);
+        add_code(OT_LABEL, &label_true, NULL, NULL, 0);
+        add_code(OT_ASSIGN, place, &ONE, NULL, 0);
+        add_code(OT_LABEL, &label_false, NULL, NULL, 0);
     }
-    else if (CHECK_ID(vertex->childs[1], "PLUS") || CHECK_ID(vertex->childs[1], "MINUS")
-            || CHECK_ID(vertex->childs[1], "STAR") || CHECK_ID(vertex->childs[1], "DIV")) {
+    else if (CHECK_ID(node_child(vertex, 1), NK_PLUS) || CHECK_ID(node_child(vertex, 1), NK_MINUS)
+            || CHECK_ID(node_child(vertex, 1), NK_STAR) || CHECK_ID(node_child(vertex, 1), NK_DIV)) {
         if(place == NULL) return;
-        int left = use_addr(vertex->childs[0]);
-        int right = use_addr(vertex->childs[2]);
-        char *src = new_tmp();
-        char *dst = new_tmp();
-        translate_Exp(vertex->childs[2], src);
-        translate_Exp(vertex->childs[0], dst);
-        char *op = vertex->childs[1]->info;
+        int left = node_attr(node_child(vertex, 0)).addr;
+        int right = node_attr(node_child(vertex, 2)).addr;
+        struct Operand src = new_tmp();
+        struct Operand dst = new_tmp();
+        translate_Exp(node_child(vertex, 2), &src);
+        translate_Exp(node_child(vertex, 0), &dst);
         if(left != VAR && right != VAR) {
             //printf("%s := *%s %s *%s \n", place, dst, op, src);
-            add_ch(dst, '*');
-            add_ch(src, '*');
+            add_modifier(&dst, OM_DEREF);
+            add_modifier(&src, OM_DEREF);
         }
         else if(left != VAR && right == VAR) {
             //printf("%s := *%s %s %s \n", place, dst, op, src);
-            add_ch(dst, '*');
+            add_modifier(&dst, OM_DEREF);
         }
         else if(left == VAR && right != VAR) {
             //printf("%s := %s %s *%s \n", place, dst, op, src);
-            add_ch(src, '*');
+            add_modifier(&src, OM_DEREF);
         }
         else {
             //printf("%s := %s %s %s \n", place, dst, op, src);
         }
-        if(CHECK_ID(vertex->childs[1], "PLUS")) add_code(OT_ADD, dst, src, place, NULL);
-        else if(CHECK_ID(vertex->childs[1], "MINUS")) add_code(OT_SUB, dst, src, place, NULL);
-        else if(CHECK_ID(vertex->childs[1], "STAR")) add_code(OT_MUL, dst, src, place, NULL);
-        else add_code(OT_DIV, dst, src, place, NULL);
+        if(CHECK_ID(node_child(vertex, 1), NK_PLUS)) add_code(OT_ADD, &dst, &src, place, 0);
+        else if(CHECK_ID(node_child(vertex, 1), NK_MINUS)) add_code(OT_SUB, &dst, &src, place, 0);
+        else if(CHECK_ID(node_child(vertex, 1), NK_STAR)) add_code(OT_MUL, &dst, &src, place, 0);
+        else add_code(OT_DIV, &dst, &src, place, 0);
     }
-    else if (CHECK_ID(vertex->childs[0], "MINUS")) {
+    else if (CHECK_ID(node_child(vertex, 0), NK_MINUS)) {
         if(place == NULL) return;
-        char *src = new_tmp();
-        translate_Exp(vertex->childs[1], src);
-        add_code(OT_SUB, ZERO, src, place, NULL);
+        struct Operand src = new_tmp();
+        translate_Exp(node_child(vertex, 1), &src);
+        add_code(OT_SUB, &ZERO, &src, place, 0);
     }
-    else if(CHECK_ID(vertex->childs[0], "LP") && CHECK_ID(vertex->childs[1], "Exp")) {
+    else if(CHECK_ID(node_child(vertex, 0), NK_LP) && CHECK_ID(node_child(vertex, 1), NK_Exp)) {
         // char *src = new_tmp();
-        // translate_Exp(vertex->childs[1], src);
+        // translate_Exp(node_child(vertex, 1), src);
         // if(place != NULL) {
         //     printf("%s := %s \n", place, src);
         //     add_code(OT_ASSIGN, place, src, NULL, NULL);
         // }
 
         /* optimized:reduce assign operations */
-        translate_Exp(vertex->childs[1], place);
+        translate_Exp(node_child(vertex, 1), place);
     }
-    else if (CHECK_ID(vertex->childs[0], "ID") && CHECK_ID(vertex->childs[1], "LP")) { //function invoking
-        if(CHECK_ID(vertex->childs[2], "Args")) { // ID LP Args RP
-            char *a[ARGNUM];
+    else if (CHECK_ID(node_child(vertex, 0), NK_ID) && CHECK_ID(node_child(vertex, 1), NK_LP)) { //function invoking
+        if(CHECK_ID(node_child(vertex, 2), NK_Args)) { // ID LP Args RP
+            struct Operand a[ARGNUM];
             int argtype[2*ARGNUM];
-            memset(a, 0, sizeof(char *)*ARGNUM);
             int len = 0;                            
-            translate_Args(vertex->childs[2], a, argtype, &len);
-            if(!strcmp(vertex->childs[0]->info, "write")) {
-                int type = use_addr(vertex->childs[2]->childs[0]);
+            translate_Args(node_child(vertex, 2), a, argtype, &len);
+            if(node_text(node_child(vertex, 0)) == write_name) {
+                int type = node_attr(node_child(node_child(vertex, 2), 0)).addr;
                 if(type != VAR) {
-                    char *tmp = num2imm(0);
-                    strcpy(tmp, a[0]);
-                    add_ch(tmp, '*');
-                    add_code(OT_WRITE, tmp, NULL, NULL, NULL);
+                    struct Operand tmp = a[0];
+                    add_modifier(&tmp, OM_DEREF);
+                    add_code(OT_WRITE, &tmp, NULL, NULL, 0);
                 }
                 else {
-                    add_code(OT_WRITE, a[0], NULL, NULL, NULL);
+                    add_code(OT_WRITE, &a[0], NULL, NULL, 0);
                 }
                 return;
             }
             else {
                 for (int i = len - 1; i >= 0; i--) {
                     if(argtype[2*i] != VAR) {
-                        add_code(OT_ARG, a[i], NULL, NULL, NULL);
+                        add_code(OT_ARG, &a[i], NULL, NULL, 0);
                     }
                     else if(argtype[2*i] == VAR && argtype[2*i+1] != VAR) {
-                        char *tmp = num2imm(0);
-                        strcpy(tmp, a[i]);
-                        add_ch(tmp, '*');
-                        add_code(OT_ARG, tmp, NULL, NULL, NULL);
+                        struct Operand tmp = a[i];
+                        add_modifier(&tmp, OM_DEREF);
+                        add_code(OT_ARG, &tmp, NULL, NULL, 0);
                     }
                     else if(argtype[2*i] == VAR && argtype[2*i+1] == VAR) {
-                        add_code(OT_ARG, a[i], NULL, NULL, NULL);
+                        add_code(OT_ARG, &a[i], NULL, NULL, 0);
                     }
                     else {
                         panic("type is illegal !!\n");
                     }
                 }
+                struct Operand func = new_func(node_text(node_child(vertex, 0)));
                 if(place != NULL) {
-                    add_code(OT_CALL, place, vertex->childs[0]->info, NULL, NULL);
+                    add_code(OT_CALL, place, &func, NULL, 0);
                 }
                 else {
-                    char *t = new_tmp();
-                    add_code(OT_CALL, t, vertex->childs[0]->info, NULL, NULL);
+                    struct Operand t = new_tmp();
+                    add_code(OT_CALL, &t, &func, NULL, 0);
                 }
             }
         }
         else { // ID LP RP
-            if (!strcmp(vertex->childs[0]->info, "read")) {
+            if (node_text(node_child(vertex, 0)) == read_name) {
                 if(place != NULL) {
                     /* optimized:reduce assign operations */
-                    add_code(OT_READ, place, NULL, NULL, NULL);
+                    add_code(OT_READ, place, NULL, NULL, 0);
                     return;
                 }
             }
             else {
+                struct Operand func = new_func(node_text(node_child(vertex, 0)));
                 if(place != NULL) {
-                    add_code(OT_CALL, place, vertex->childs[0]->info, NULL, NULL);
+                    add_code(OT_CALL, place, &func, NULL, 0);
                 }
                 else {
-                    char *t = new_tmp();
-                    add_code(OT_CALL, t, vertex->childs[0]->info, NULL, NULL);
+                    struct Operand t = new_tmp();
+                    add_code(OT_CALL, &t, &func, NULL, 0);
                 }
             }
         }
     }
-    else if (CHECK_ID(vertex->childs[1], "LB")) {
-        int offset = 0;
-        struct Node *v = vertex->childs[0];
+    else if (CHECK_ID(node_child(vertex, 1), NK_LB)) {
+        NodeRef v = node_child(vertex, 0);
 
 
-        char *t1 = new_tmp();
-        char *t2 = new_tmp();
-        int type = use_addr(vertex->childs[2]);
+        struct Operand t1 = new_tmp();
+        struct Operand t2 = new_tmp();
+        int type = node_attr(node_child(vertex, 2)).addr;
         if (type == VAR) {
-            translate_Exp(vertex->childs[2], t1); // index
+            translate_Exp(node_child(vertex, 2), &t1); // index
         }
         else {
-            char *t3 = new_tmp();
-            translate_Exp(vertex->childs[2], t3);
-            add_ch(t3, '*');
-            add_code(OT_ASSIGN, t1, t3, NULL, NULL);
-        }
-        char *num = num2imm(4);
-        add_code(OT_MUL, t1, num, t2, NULL);
-
-        if(CHECK_ID(v->childs[0], "ID") && !CHECK_ID(v->childs[1], "LP")) {
-            char *name = v->childs[0]->info;        
-            char *v1 = new_var(name);
-            bool flag = in_paralist(name);
-            struct Symbol *p = search_symbol(name);
+            struct Operand t3 = new_tmp();
+            translate_Exp(node_child(vertex, 2), &t3);
+            add_modifier(&t3, OM_DEREF);
+            add_code(OT_ASSIGN, &t1, &t3, NULL, 0);
+        }
+        struct Operand num = num2imm(node_attr(vertex).exp.type->size);    // element stride
+        add_code(OT_MUL, &t1, &num, &t2, 0);
+
+        if(CHECK_ID(node_child(v, 0), NK_ID) && !CHECK_ID(node_child(v, 1), NK_LP)) {
+            struct Symbol *p = node_attr(v).symbol;
+            struct Operand v1 = new_var(p);
+            bool flag = in_paralist(p);
             if (p->kind == VAR && p->type->kind == ARRAY) {       
                 if(!flag) {
-                    add_ch(v1, '&');
+                    add_modifier(&v1, OM_ADDR);
                 }
-                add_code(OT_ADD, v1, t2, place, NULL);
+                add_code(OT_ADD, &v1, &t2, place, 0);
             }
 
         }
-        else if(CHECK_ID(v->childs[0], "Exp") && CHECK_ID(v->childs[1], "LB")) {
+        else if(CHECK_ID(node_child(v, 0), NK_Exp) && CHECK_ID(node_child(v, 1), NK_LB)) {
             panic("multimensional array !!!\n");
         }
-        else if(CHECK_ID(v->childs[0], "Exp") && CHECK_ID(v->childs[1], "DOT")) {
-            char *tmp = new_tmp();
-            translate_Exp(v, tmp); // get offset
-            add_code(OT_ADD, tmp, t2, place, NULL);
+        else if(CHECK_ID(node_child(v, 0), NK_Exp) && CHECK_ID(node_child(v, 1), NK_DOT)) {
+            struct Operand tmp = new_tmp();
+            translate_Exp(v, &tmp); // get offset
+            add_code(OT_ADD, &tmp, &t2, place, 0);
         } 
 
     }
-    else if (CHECK_ID(vertex->childs[1], "DOT")) {     
-        get_structlist(vertex);
-        char *first = structlist[0];
-        char *v1 = new_var(first); 
-        int offset = total_offset(vertex->childs[2]->info);         // get offset
-        char *num = num2imm(offset);
+    else if (CHECK_ID(node_child(vertex, 1), NK_DOT)) {     
+        int offset = 0;
+        NodeRef base = vertex;
+        while(CHECK_ID(node_child(base, 1), NK_DOT)) {      // add up field offsets along the access chain
+            struct FieldList *field = find_field(node_attr(node_child(base, 0)).exp.type, node_text(node_child(base, 2)));
+            if(field != NULL) {
+                offset += field->offset;
+            }
+            base = node_child(base, 0);
+        }
+        struct Symbol *first = node_attr(base).symbol;
+        struct Operand v1 = new_var(first); 
+        struct Operand num = num2imm(offset);
       
         if(in_paralist(first)) {
-            add_code(OT_ADD, v1, num, place, NULL);
+            add_code(OT_ADD, &v1, &num, place, 0);
         }
         else {
-            add_ch(v1, '&');
-            add_code(OT_ADD, v1, num, place, NULL);
+            add_modifier(&v1, OM_ADDR);
+            add_code(OT_ADD, &v1, &num, place, 0);
         }
     }
 }
 
-void translate_Cond(struct Node *vertex, char *label_true, char *label_false) {
-    if(CHECK_ID(vertex->childs[0], "Exp") && CHECK_ID(vertex->childs[1], "RELOP")){
-        char *t1 = new_tmp();
-        char *t2 = new_tmp();
-        char *op = vertex->childs[1]->info;
-        translate_Exp(vertex->childs[0], t1);
-        translate_Exp(vertex->childs[2], t2);
-        if(use_addr(vertex->childs[0])) {           // element in array or structure
-            add_ch(t1, '*');
+void translate_Cond(NodeRef vertex, struct Operand *label_true, struct Operand *label_false) {
+    if(CHECK_ID(node_child(vertex, 0), NK_Exp) && CHECK_ID(node_child(vertex, 1), NK_RELOP)){
+        struct Operand t1 = new_tmp();
+        struct Operand t2 = new_tmp();
+        enum RELOP_TYPE op = node_sub(node_child(vertex, 1));
+        translate_Exp(node_child(vertex, 0), &t1);
+        translate_Exp(node_child(vertex, 2), &t2);
+        if(node_attr(node_child(vertex, 0)).addr) {           // element in array or structure
+            add_modifier(&t1, OM_DEREF);
         }
-        if(use_addr(vertex->childs[2])) {
-            add_ch(t2, '*');
+        if(node_attr(node_child(vertex, 2)).addr) {
+            add_modifier(&t2, OM_DEREF);
         }
-        add_code(OT_RELOP, t1, t2, label_true, op);
-        add_code(OT_GOTO, label_false, NULL, NULL, NULL);
+        add_code(OT_RELOP, &t1, &t2, label_true, op);
+        add_code(OT_GOTO, label_false, NULL, NULL, 0);
 
     }
-    else if(CHECK_ID(vertex->childs[0], "NOT")) {
-        translate_Cond(vertex->childs[1], label_false, label_true);
+    else if(CHECK_ID(node_child(vertex, 0), NK_NOT)) {
+        translate_Cond(node_child(vertex, 1), label_false, label_true);
     }
-    else if(CHECK_ID(vertex->childs[1], "AND")) {
-        char *label_tmp = new_label();
-        translate_Cond(vertex->childs[0], label_tmp, label_false);
-        add_code(OT_LABEL, label_tmp, NULL, NULL, NULL);
-        translate_Cond(vertex->childs[2], label_true, label_false);
+    else if(CHECK_ID(node_child(vertex, 1), NK_AND)) {
+        struct Operand label_tmp = new_label();
+        translate_Cond(node_child(vertex, 0), &label_tmp, label_false);
+        add_code(OT_LABEL, &label_tmp, NULL, NULL, 0);
+        translate_Cond(node_child(vertex, 2), label_true, label_false);
     }
-    else if(CHECK_ID(vertex->childs[1], "OR")) {
-        char *label_tmp = new_label();
-        translate_Cond(vertex->childs[0], label_true, label_tmp);
-        add_code(OT_LABEL, label_tmp, NULL, NULL, NULL);
-        translate_Cond(vertex->childs[2], label_true, label_false);
+    else if(CHECK_ID(node_child(vertex, 1), NK_OR)) {
+        struct Operand label_tmp = new_label();
+        translate_Cond(node_child(vertex, 0), label_true, &label_tmp);
+        add_code(OT_LABEL, &label_tmp, NULL, NULL, 0);
+        translate_Cond(node_child(vertex, 2), label_true, label_false);
     }
     else {
-        char *t1 = new_tmp();
-        translate_Exp(vertex, t1);
-        if(use_addr(vertex)) {
-            add_ch(t1, '*');
+        struct Operand t1 = new_tmp();
+        translate_Exp(vertex, &t1);
+        if(node_attr(vertex).addr) {
+            add_modifier(&t1, OM_DEREF);
         }
-        char op[10] = "!=";
-        add_code(OT_RELOP, t1, ZERO, label_true, op);
-        add_code(OT_GOTO, label_false, NULL, NULL, NULL);
+        add_code(OT_RELOP, &t1, &ZERO, label_true, RT_NE);
+        add_code(OT_GOTO, label_false, NULL, NULL, 0);
     }
 }
 
-void get_structlist(struct Node *vertex) {
-        struct Node *v = vertex->childs[0];
-        if(CHECK_ID(v->childs[0], "ID") && !CHECK_ID(v->childs[1], "LP")) {
+void translate_Args(NodeRef vertex, struct Operand a[], int type[], int *k) {
 
-            char *name = v->childs[0]->info;
-            structlist[struct_label ++] = name;
-            structlist[struct_label ++] = vertex->childs[2]->info;
-        }
-        else {  
-            get_structlist(vertex->childs[0]);
-            char *id_name = vertex->childs[2]->info;
-            structlist[struct_label ++] = id_name;
-        }
-}
-void translate_Args(struct Node *vertex, char *a[], int type[], int *k) {
-
-    struct ExpType p = Exp(vertex->childs[0]);
-    if (p.type->kind == ARRAY) {
+    struct NodeAttr p = node_attr(node_child(vertex, 0));
+    if (p.exp.type->kind == ARRAY) {
         panic("impossible !!\n");
     }
     else {
-        char *src = new_tmp();
-        translate_Exp(vertex->childs[0], src);
-        type[2*(*k)] = Exp(vertex->childs[0]).type->kind;
-        type[2*(*k) + 1] = use_addr(vertex->childs[0]);
+        struct Operand src = new_tmp();
+        translate_Exp(node_child(vertex, 0), &src);
+        type[2*(*k)] = p.exp.type->kind;
+        type[2*(*k) + 1] = p.addr;
         a[*k] = src;
         *k = (*k) + 1;
     }
-    if(CHECK_ID(vertex->childs[2], "Args")) {
-        translate_Args(vertex->childs[2], a, type, k);
+    if(CHECK_ID(node_child(vertex, 2), NK_Args)) {
+        translate_Args(node_child(vertex, 2), a, type, k);
     }
 }
 
-int use_addr(struct Node *vertex) {
-    if (CHECK_ID(vertex->childs[0], "LP")) {
-        return use_addr(vertex->childs[1]);
-    }
-    if (CHECK_ID(vertex->childs[0], "Exp") && CHECK_ID(vertex->childs[1], "DOT")) {
-        return STRUCTURE;
-    }
-    else if (CHECK_ID(vertex->childs[0], "Exp") && CHECK_ID(vertex->childs[1], "LB")) {
-        return ARRAY;
-    }
-     
-    return VAR;
-}
-
-bool in_paralist(char *name) {
+bool in_paralist(struct Symbol *p) {
     bool flag = false;
     int i = 0;
-    while (i < ARGNUM && paralist[i] != NULL && strcmp(paralist[i]->id, name) != 0) {
+    while (i < ARGNUM && paralist[i] != NULL && paralist[i] != p) {
         i++;
     }
     flag = (i == ARGNUM || paralist[i] == NULL) ? false : true;
     return flag;
 }
 
-int part_offset(struct FieldList *p, char *name) {
-    int offset = 0;
-    while (p != NULL && strcmp(name, p->id) != 0) { 
-        if (p->type->kind == BASIC) {
-            offset += 4;
-        }
-        else if (p->type->kind == ARRAY) {
-            offset += p->type->array.size * 4;
-        }
-        else {
-            struct FieldList *m = p->type->structure;
-            offset += part_offset(m, name);
-        }
-        p = p->next;
-    }
-    return offset;
-}
-
-int total_offset(char *name) {
-    int offset = 0;
-    struct FieldList *p = search_symbol(structlist[0])->type->structure;
-    struct FieldList *q = p;
-    for(int i = 0;i < struct_label - 2;i++) {
-        char *tmp = structlist[i+1];        
-        offset += part_offset(p, tmp);
-        while(q != NULL && strcmp(q->id, tmp) != 0) {
-            q = q->next;
-        }
-        p = q->type->structure;
-        q = p;
-    }
-    offset += part_offset(p, name);
-    memset(structlist, 0, sizeof(structlist));          // initialized to zero
-    struct_label = 0;
-    return offset;
-}
-
-int space_create(struct Type *t) {
-    if(t->kind == BASIC) {
-        return 4;
-    }
-    else if(t->kind == ARRAY) {
-        return t->array.size * space_create(t->array.elem_type);
-    }
-    else {  // structure
-        int space = 0;
-        for(struct FieldList *p = t->structure;p != NULL;p = p->next) {
-            space += space_create(p->type);
-        }
-        return space;
-    }
-}
-
-void int_to_char(int num, char *dst) {
-    int m = num, n = 0, k = 0;
-    do
-    {
-        n = m % 10;
-        dst[k++] = n + '0';
-        m = m / 10;
-    } while (m != 0);
-    dst[k] = '\0';
-
-    for(int i = 0, j = k-1; i <= j; i++, j--) {
-        char tmp = dst[i];
-        dst[i] = dst[j];
-        dst[j] = tmp;
-    }
-}
-
-char *num2imm(int n) {
-    char *dst = (char *)malloc(sizeof(char)*ARGNUM);
-    char src[ARGNUM];
-    int_to_char(n, src);
-    dst[0] = '#';
-    strcpy(dst+1, src);
+struct Operand num2imm(int n) {
+    struct Operand dst = { OPD_IMM, OM_NONE, { n } };
     return dst;
 }
 
-void add_ch(char *dst, char ch) {
-    char src[ARGNUM];
-    strcpy(src, dst);
-    memset(dst, 0, strlen(dst));
-    dst[0] = ch;
-    strncpy(dst + 1, src, strlen(src));
+void add_modifier(struct Operand *dst, enum OPERAND_MODIFIER modifier) {
+    dst->modifier = modifier;
 }
 
-char *new_var(char *name) {
-    char *dst = (char *)malloc(sizeof(char)*ARGNUM);
-    memset(dst, 0, sizeof(char)*ARGNUM);
-    struct Symbol *p = search_symbol(name);
+struct Operand new_var(struct Symbol *p) {
+    struct Operand dst = { OPD_VAR, OM_NONE };
     if (p != NULL && (p->kind == VAR))
     {
-        dst[0] = 'v';
-        char src[10];
-        int_to_char(p->var_num, src);
-        strcpy(dst + 1, src);
+        dst.id = p->var_num;
     }
     else
     {
@@ -786,32 +702,35 @@ char *new_var(char *name) {
     return dst;
 }
 
-char *new_tmp() {   
-    char *dst = (char *)malloc(sizeof(char)*ARGNUM);
-    memset(dst, 0, sizeof(char)*ARGNUM);
-    dst[0] = 't';
-    char src[10];
-    int_to_char(tmp_count++, src);
-    strcpy(dst + 1, src);
+struct Operand new_tmp() {   
+    struct Operand dst = { OPD_TMP, OM_NONE, { tmp_count++ } };
     return dst;
 }
 
-char *new_label() {   
-    char *dst = (char *)malloc(sizeof(char)*ARGNUM);
-    memset(dst, 0, sizeof(char)*ARGNUM);  
-    char tmp[10] = "label";
-    char src[10];
-    strcpy(dst,tmp);
-    int_to_char(label_count++, src);
-    strcpy(dst + 5, src);
+struct Operand new_label() {   
+    struct Operand dst = { OPD_LABEL, OM_NONE, { label_count++ } };
     return dst;
 }
 
-char *new_imm(char *src) {
-    char *dst = (char *)malloc(sizeof(char)*ARGNUM);
-    memset(dst, 0, sizeof(char)*ARGNUM);
-    dst[0] = '#';
-    strcpy(dst + 1, src);
+struct Operand new_imm(char *src) {
+    struct Operand dst = { OPD_IMM, OM_NONE };
+    if (strchr(src, '.') == NULL) {
+        dst.value = atoi(src);
+    }
+    else {  // float number keeps its text
+        int len = strlen(src);
+        char name[len + 2];
+        name[0] = '#';
+        strcpy(name + 1, src);
+        dst.kind = OPD_FLOAT;
+        dst.name = intern(name, len + 1);
+    }
+    return dst;
+}
+
+struct Operand new_func(char *name) {
+    struct Operand dst = { OPD_FUNC, OM_NONE };
+    dst.name = name;                            // interned, so it outlives the syntax tree
     return dst;
 }
 
@@ -831,29 +750,34 @@ bool structure_arrays(struct FieldList *s) {
     return flag;
 }
 
-bool legal_to_output() {
+bool legal_symbol(struct Symbol *s) {
     bool flag = true;
-    for(int i = 0;i < TABLE_SIZE; i++) {
-        struct SymbolTableItem *p = symbol_table[i];
-        while(p != NULL) {
-            struct Symbol *s = p->id;
-            if(s->kind == VAR && s->type->kind == ARRAY && s->type->array.elem_type->kind != BASIC) {  
+    if(s->kind == VAR && s->type->kind == ARRAY && s->type->array.elem_type->kind != BASIC) {  
+        flag = false;
+    }       // high dimensions arrays
+    else if(s->kind == PROC) {  // array in arglist
+        for(int j = 0;j < MAX_ARGS;j++) {
+            if(s->proc_type.argtype_list[j] != NULL && s->proc_type.argtype_list[j]->kind == ARRAY) {
                 flag = false;
-            }       // high dimensions arrays
-            else if(s->kind == PROC) {  // array in arglist
-                for(int j = 0;j < MAX_ARGS;j++) {
-                    if(s->proc_type.argtype_list[j] != NULL && s->proc_type.argtype_list[j]->kind == ARRAY) {
-                        flag = false;
-                    }
-                }
-            }           
-            else if(s->kind == STRUCTURE) {  // high dimensions array in structure
-                if(! structure_arrays(s->type->structure)) {
-                    flag = false;
-                }
             }
-            p = p->next;
+        }
+    }           
+    else if(s->kind == STRUCTURE) {  // high dimensions array in structure
+        if(! structure_arrays(s->type->structure)) {
+            flag = false;
         }
     }
     return flag;
-}
\ No newline at end of file
+}
+
+bool legal_to_output() {
+    bool flag = true;
+    unsigned int pos = 0;
+    struct Symbol *s;
+    while((s = next_symbol(&pos)) != NULL) {
+        if(! legal_symbol(s)) {
+            flag = false;
+        }
+    }
+    return flag;
+}
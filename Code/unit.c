@@ -0,0 +1,378 @@
+#define _POSIX_C_SOURCE 200809L
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "sparse.h"
+#include "ircode.h"
+#include "assemble.h"
+#include "unit.h"
+
+/* Definitions of translation units */
+
+struct UnitFunc {                       //function in the summary of a unit
+    const char* name;                   //NUL-terminated in the unit file
+    bool defined;                       //defined by the unit, otherwise only declared and imported from another unit
+    uint32_t lineno;
+    const char* sig;                    //return and parameter types, see put_type
+    uint32_t sig_len;
+    int unit;                           //index of the unit in the link
+};
+
+struct UnitStruct {                     //named struct type in the summary of a unit
+    const char* name;
+    const char* layout;                 //names, offsets and types of the fields
+    uint32_t layout_len;
+    int unit;
+};
+
+struct Unit {                           //unit file loaded by the link step
+    const char* path;
+    char* data;
+    uint32_t var_num, tmp_num, label_num; //variants, temporaries and labels numbered by the unit from 1
+    const char* text;                   //assembly with relocatable operands, see relocate_code
+    uint32_t text_len;
+};
+
+struct Link {                           //units being linked and their summaries
+    struct Unit* units;
+    struct UnitFunc* funcs;
+    int func_num, func_cap;
+    struct UnitStruct* structs;
+    int struct_num, struct_cap;
+};
+
+struct Reader {                         //cursor over a unit file
+    const char* p;
+    const char* end;
+    bool ok;                            //false once something was read past the end
+};
+
+/* encoding of summaries */
+
+static void put_u32(struct OutBuf* out, uint32_t value) {
+    out_mem(out, (const char*)&value, sizeof(value));
+}
+
+//write arg:str with its length and a NUL, so it can be used in place when it is read
+static void put_str(struct OutBuf* out, const char* str) {
+    put_u32(out, strlen(str));
+    out_str(out, str);
+    out_char(out, '\0');
+}
+
+//write arg:type by structure, a struct by the types of its fields, as comp_type compares types
+static void put_type(struct OutBuf* out, const struct Type* type) {
+    out_char(out, (char)type->kind);
+    if (type->kind == BASIC)
+        out_char(out, (char)type->basic);
+    else if (type->kind == ARRAY) {
+        put_u32(out, type->array.size);
+        put_type(out, type->array.elem_type);
+    }
+    else if (type->kind == STRUCTURE) {
+        uint32_t field_num = 0;
+        for (const struct FieldList* field = type->structure; field != NULL; field = field->next)
+            ++field_num;
+        put_u32(out, field_num);
+        for (const struct FieldList* field = type->structure; field != NULL; field = field->next)
+            put_type(out, field->type);
+    }
+}
+
+//write the length and bytes of arg:blob to arg:out, then empty arg:blob for the next one
+static void put_blob(struct OutBuf* out, struct OutBuf* blob) {
+    put_u32(out, blob->len);
+    out_mem(out, blob->data, blob->len);
+    blob->len = 0;
+}
+
+static uint32_t get_u32(struct Reader* in) {
+    uint32_t value = 0;
+    if (in->end - in->p < (long)sizeof(value)) {
+        in->ok = false;
+        return 0;
+    }
+    memcpy(&value, in->p, sizeof(value));
+    in->p += sizeof(value);
+    return value;
+}
+
+//read arg:len bytes, return NULL if the file ends before
+static const char* get_bytes(struct Reader* in, uint32_t len) {
+    if (!in->ok || (uint64_t)(in->end - in->p) < len) {
+        in->ok = false;
+        return NULL;
+    }
+    const char* bytes = in->p;
+    in->p += len;
+    return bytes;
+}
+
+static const char* get_str(struct Reader* in) {
+    uint32_t len = get_u32(in);
+    const char* str = get_bytes(in, len + 1);
+    if (str != NULL && str[len] != '\0')
+        in->ok = false;
+    return str;
+}
+
+/* Operations on links */
+
+//grow arg:items of arg:num items of arg:size bytes so one more fits, arg:cap is updated
+static void* grow(void* items, int num, int* cap, size_t size) {
+    if (num < *cap)
+        return items;
+    *cap = *cap ? *cap * 2 : 64;
+    if ((items = realloc(items, *cap * size)) == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return items;
+}
+
+//load the unit file at arg:path as unit arg:index of arg:link, return false if it is no unit file
+static bool load_unit(struct Link* link, int index, const char* path) {
+    struct Unit* unit = &link->units[index];
+    struct stat st;
+    unit->path = path;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+
+    size_t len = 0;
+    ssize_t n;
+    if ((unit->data = malloc(st.st_size + 1)) == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    while (len < (size_t)st.st_size && (n = read(fd, unit->data + len, st.st_size - len)) > 0)
+        len += n;
+    close(fd);
+
+    struct Reader in = { unit->data, unit->data + len, true };
+    const char* magic = get_bytes(&in, strlen(UNIT_MAGIC));
+    if (magic == NULL || memcmp(magic, UNIT_MAGIC, strlen(UNIT_MAGIC)) != 0) {
+        fprintf(stderr, "%s: not a unit file\n", path);
+        return false;
+    }
+    unit->var_num = get_u32(&in);
+    unit->tmp_num = get_u32(&in);
+    unit->label_num = get_u32(&in);
+
+    uint32_t struct_num = get_u32(&in);
+    for (uint32_t i = 0; i < struct_num && in.ok; ++i) {
+        link->structs = grow(link->structs, link->struct_num, &link->struct_cap, sizeof(struct UnitStruct));
+        struct UnitStruct* item = &link->structs[link->struct_num++];
+        item->name = get_str(&in);
+        item->layout_len = get_u32(&in);
+        item->layout = get_bytes(&in, item->layout_len);
+        item->unit = index;
+    }
+    uint32_t func_num = get_u32(&in);
+    for (uint32_t i = 0; i < func_num && in.ok; ++i) {
+        link->funcs = grow(link->funcs, link->func_num, &link->func_cap, sizeof(struct UnitFunc));
+        struct UnitFunc* item = &link->funcs[link->func_num++];
+        const char* defined = get_bytes(&in, 1);
+        item->defined = defined != NULL && *defined != 0;
+        item->name = get_str(&in);
+        item->lineno = get_u32(&in);
+        item->sig_len = get_u32(&in);
+        item->sig = get_bytes(&in, item->sig_len);
+        item->unit = index;
+    }
+    unit->text_len = get_u32(&in);
+    unit->text = get_bytes(&in, unit->text_len);
+    if (!in.ok) {
+        fprintf(stderr, "%s: broken unit file\n", path);
+        return false;
+    }
+    return true;
+}
+
+static bool same_bytes(const char* a, uint32_t a_len, const char* b, uint32_t b_len) {
+    return a_len == b_len && memcmp(a, b, a_len) == 0;
+}
+
+static int compare_struct(const void* a, const void* b) {
+    const struct UnitStruct *x = a, *y = b;
+    int res = strcmp(x->name, y->name);
+    return res != 0 ? res : x->unit - y->unit;
+}
+
+//order the functions by name, then the definitions before the declarations, then by unit
+static int compare_func(const void* a, const void* b) {
+    const struct UnitFunc *x = a, *y = b;
+    int res = strcmp(x->name, y->name);
+    if (res == 0)
+        res = (int)y->defined - (int)x->defined;
+    return res != 0 ? res : x->unit - y->unit;
+}
+
+//check that the structs named alike have one layout, report the others to stderr
+static bool check_structs(struct Link* link) {
+    bool ok = true;
+    qsort(link->structs, link->struct_num, sizeof(struct UnitStruct), compare_struct);
+    for (int i = 1; i < link->struct_num; ++i) {
+        const struct UnitStruct *a = &link->structs[i - 1], *b = &link->structs[i];
+        if (strcmp(a->name, b->name) == 0 && !same_bytes(a->layout, a->layout_len, b->layout, b->layout_len)) {
+            fprintf(stderr, "struct %s has different layouts in %s and %s\n", a->name,
+                link->units[a->unit].path, link->units[b->unit].path);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+//check that each function is defined once, with the signature of the declarations of other units, and that main is defined
+static bool check_funcs(struct Link* link) {
+    bool ok = true, has_main = false;
+    qsort(link->funcs, link->func_num, sizeof(struct UnitFunc), compare_func);
+    for (int i = 0; i < link->func_num; ) {
+        const struct UnitFunc* def = link->funcs[i].defined ? &link->funcs[i] : NULL;
+        int end = i + 1;
+        for (; end < link->func_num && strcmp(link->funcs[end].name, link->funcs[i].name) == 0; ++end) {
+            const struct UnitFunc* func = &link->funcs[end];
+            if (func->defined) {
+                fprintf(stderr, "function %s is defined in both %s and %s\n", func->name,
+                    link->units[def->unit].path, link->units[func->unit].path);
+                ok = false;
+            }
+            else if (def == NULL) {
+                fprintf(stderr, "%s:%u: undefined function %s\n", link->units[func->unit].path, func->lineno, func->name);
+                ok = false;
+            }
+            else if (!same_bytes(func->sig, func->sig_len, def->sig, def->sig_len)) {
+                fprintf(stderr, "%s:%u: declaration of function %s does not match its definition in %s\n",
+                    link->units[func->unit].path, func->lineno, func->name, link->units[def->unit].path);
+                ok = false;
+            }
+        }
+        if (def == NULL) {              // the first declaration was not checked above
+            const struct UnitFunc* func = &link->funcs[i];
+            fprintf(stderr, "%s:%u: undefined function %s\n", link->units[func->unit].path, func->lineno, func->name);
+            ok = false;
+        }
+        has_main = has_main || (def != NULL && strcmp(def->name, "main") == 0);
+        i = end;
+    }
+    if (!has_main) {
+        fprintf(stderr, "no unit defines function main\n");
+        ok = false;
+    }
+    return ok;
+}
+
+/* Interfaces */
+
+//write the summary and the assembly of the translated program to the unit file arg:filename
+//the functions declared but not defined are recorded as imports, which the link step resolves
+//return false if the file cannot be written
+bool write_unit(const char* filename) {
+    struct OutBuf out, text, blob;
+    struct CodeBase base = { 1, 1, 1 };
+    code_base = &base;
+    assemble_unit(&text);
+    code_base = NULL;
+    if (!out_open(&out, filename)) {
+        perror(filename);
+        out_close(&text);
+        return false;
+    }
+    out_open_mem(&blob);
+
+    unsigned int pos = 0;
+    uint32_t struct_num = 0, func_num = 0;
+    struct Symbol* symbol;
+    while ((symbol = next_symbol(&pos)) != NULL) {
+        struct_num += symbol->kind == USER_TYPE && !isdigit((unsigned char)symbol->id[0]);
+        func_num += symbol->kind == PROC && symbol->first_lineno != 0;
+    }
+
+    out_mem(&out, UNIT_MAGIC, strlen(UNIT_MAGIC));
+    put_u32(&out, var_count - 1);
+    put_u32(&out, tmp_count - 1);
+    put_u32(&out, label_count - 1);
+    put_u32(&out, struct_num);
+    for (pos = 0; (symbol = next_symbol(&pos)) != NULL; ) {
+        if (symbol->kind != USER_TYPE || isdigit((unsigned char)symbol->id[0]))
+            continue;                   // anonymous structs are named by numbers
+        put_u32(&blob, 0);
+        uint32_t field_num = 0;
+        for (const struct FieldList* field = symbol->type->structure; field != NULL; field = field->next, ++field_num) {
+            put_str(&blob, field->id);
+            put_u32(&blob, field->offset);
+            put_type(&blob, field->type);
+        }
+        memcpy(blob.data, &field_num, sizeof(field_num));
+        put_str(&out, symbol->id);
+        put_blob(&out, &blob);
+    }
+    put_u32(&out, func_num);
+    for (pos = 0; (symbol = next_symbol(&pos)) != NULL; ) {
+        if (symbol->kind != PROC || symbol->first_lineno == 0)
+            continue;                   // read and write are built into every program
+        put_type(&blob, symbol->proc_type.ret_type);
+        for (int i = 0; i < MAX_ARGS && symbol->proc_type.argtype_list[i] != NULL; ++i)
+            put_type(&blob, symbol->proc_type.argtype_list[i]);
+        out_char(&out, symbol->defined);
+        put_str(&out, symbol->id);
+        put_u32(&out, symbol->first_lineno);
+        put_blob(&out, &blob);
+    }
+    put_u32(&out, text.len);
+    out_mem(&out, text.data, text.len);
+
+    out_close(&out);
+    out_close(&text);
+    out_close(&blob);
+    return true;
+}
+
+//link the unit files at arg:paths, arg:num of them, into the assembly arg:filename, with their operands renumbered in order
+//the imports of each unit are checked against the definitions of the others, errors are reported to stderr
+//return false if the units cannot be linked, then nothing is written
+bool link_units(const char* filename, char** paths, int num) {
+    struct Link link;
+    memset(&link, 0, sizeof(link));
+    if ((link.units = calloc(num, sizeof(struct Unit))) == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    bool ok = true;
+    for (int i = 0; i < num; ++i)
+        ok = load_unit(&link, i, paths[i]) && ok;
+    if (ok) {
+        ok = check_structs(&link) && ok;
+        ok = check_funcs(&link) && ok;
+    }
+
+    if (ok) {
+        struct OutBuf text;
+        struct CodeBase base = { 1, 1, 1 };
+        out_open_mem(&text);
+        assemble_begin((char*)filename);
+        for (int i = 0; i < num; ++i) {
+            text.len = 0;
+            relocate_code(&text, link.units[i].text, link.units[i].text_len, &base);
+            assemble_text(text.data, text.len);
+            base.var += link.units[i].var_num;
+            base.tmp += link.units[i].tmp_num;
+            base.label += link.units[i].label_num;
+        }
+        assemble_end();
+        out_close(&text);
+    }
+
+    for (int i = 0; i < num; ++i)
+        free(link.units[i].data);
+    free(link.units);
+    free(link.funcs);
+    free(link.structs);
+    return ok;
+}
@@ -0,0 +1,15 @@
+#ifndef UNIT_H
+#define UNIT_H
+
+#include <stdbool.h>
+
+/* separately compiled translation units, "parser -unit source unit" and "parser -link output unit..." */
+/* a unit file holds a summary of the unit, the signatures of the functions it defines and declares and its struct layouts, */
+/* followed by its assembly without the data and built-in functions, whose operands are renumbered by the link step */
+
+#define UNIT_MAGIC "CMMUNIT1"           //first bytes of a unit file
+
+bool write_unit(const char* filename);
+bool link_units(const char* filename, char** units, int num);
+
+#endif